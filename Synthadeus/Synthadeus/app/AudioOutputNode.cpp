@@ -1,13 +1,19 @@
 #include "AudioOutputNode.h"
 #include "Synthadeus.h"
 
-AudioOutputNode::AudioOutputNode(Point audioOutputNodeOrigin)
-	: Node(audioOutputNodeOrigin, Point(200.f, 60.f), COLOR_PINK, COLOR_ABLACK, false)
+AudioOutputNode::AudioOutputNode(Point audioOutputNodeOrigin, int midiChannel)
+	: Node(audioOutputNodeOrigin, Point(200.f, 115.f), COLOR_PINK, COLOR_ABLACK, false), channel(midiChannel)
 {
 	// the input connector which will connect the node to the final point in the graph
 	input = new InputConnector(Point(20.f, 20.f), Point(20.f, 20.f), COLOR_PINK, this, onConnected);
 	addChild(input);
 
+	// create and add the volume and panning sliders
+	volumeSlider = new Slider(Point(10.f, 65.f), Point(100.f, 15.f), COLOR_NONE, COLOR_ORANGE, Slider::HORIZONTAL, 0.f, 1.f, 1.f, 0.001f, onVolumeChanged);
+	addChild(volumeSlider);
+	panningSlider = new Slider(Point(10.f, 90.f), Point(100.f, 15.f), COLOR_NONE, COLOR_CYAN, Slider::HORIZONTAL, -1.f, 1.f, 0.f, 0.001f, onPanningChanged);
+	addChild(panningSlider);
+
 	// a default 0 to feed the audio playback mechanism
 	defaultValue = new AudioConstant(0.f);
 	
@@ -32,11 +38,22 @@ Renderable * AudioOutputNode::getRenderList()
 	// get the base renderables
 	Renderable* nodeRenderables = Node::getRenderList();
 
-	// create a snazzy title
-	Text* outputText = new Text("Output Endpoint", Point(70.f, 10.f) + getOrigin(), Point(120.f, 40.f), FONT_ARIAL20, COLOR_WHITE);
+	// create a snazzy title (naming the channel once there are more)
+	char title[32];
+	if (channel == 0)
+		sprintf_s(title, "Output Endpoint");
+	else
+		sprintf_s(title, "Output Channel %d", channel + 1);
+	Text* outputText = new Text(title, Point(70.f, 10.f) + getOrigin(), Point(120.f, 40.f), FONT_ARIAL20, COLOR_WHITE);
 	
-	// append the title, return the list
+	// label the sliders
+	Text* volumeText = new Text("Volume", getOrigin() + Point(120.f, 65.f), Point(65.f, 15.f), FONT_ARIAL11, COLOR_WHITE);
+	Text* panningText = new Text("Panning", getOrigin() + Point(120.f, 90.f), Point(65.f, 15.f), FONT_ARIAL11, COLOR_WHITE);
+
+	// append the title and labels, return the list
 	nodeRenderables->next = outputText;
+	outputText->next = volumeText;
+	volumeText->next = panningText;
 	return nodeRenderables;
 }
 
@@ -64,3 +81,21 @@ void AudioOutputNode::setOutputNode(AudioUINode* node)
 	else
 		outputNode = NULL;
 }
+
+void AudioOutputNode::onVolumeChanged(Synthadeus* app, Component* me)
+{
+	// resolve the idenitity crisis
+	AudioOutputNode* myself = dynamic_cast<AudioOutputNode*>(me->getParent());
+
+	// glide the part to the new volume (no recalculation needed)
+	app->setPartParameter(myself->channel, AudioPart::GAIN, myself->volumeSlider->getValue());
+}
+
+void AudioOutputNode::onPanningChanged(Synthadeus* app, Component* me)
+{
+	// resolve the idenitity crisis
+	AudioOutputNode* myself = dynamic_cast<AudioOutputNode*>(me->getParent());
+
+	// glide the part to the new panning (no recalculation needed)
+	app->setPartParameter(myself->channel, AudioPart::PAN, myself->panningSlider->getValue());
+}
@@ -12,6 +12,7 @@
 
 #include "Component.h"
 #include "Node.h"
+#include "Slider.h"
 #include "Connector.h"
 #include "AudioConstant.h"
 
@@ -26,13 +27,22 @@ class AudioOutputNode : public Node, public AudioUINode
 	// the actual graph node whose data is fed to the audio playback mechanism
 	AudioNode* outputNode;
 
+	// the midi channel playing this output (0 to 15)
+	int channel;
+
+	// the part's volume and panning, which glide while playing rather than recalculating the graph
+	Slider *volumeSlider, *panningSlider;
+
 public:
 
 	// runtime type information macro
 	RTTI_MACRO(AudioOutputNode);
 
-	// a simple contructor creating the node at a target location
-	AudioOutputNode(Point audioOutputNodeOrigin);
+	// a simple contructor creating the node at a target location, played from a midi channel
+	AudioOutputNode(Point audioOutputNodeOrigin, int midiChannel = 0);
+
+	// the midi channel playing this output
+	inline int getChannel() { return channel; }
 
 	// get the audio node related to this UI graph node
 	virtual AudioNode* getAudioNode();
@@ -48,5 +58,11 @@ public:
 
 	// updates the default node when the connection changes
 	void setOutputNode(AudioUINode* node);
+
+	// on volume slider changed callback
+	static void onVolumeChanged(Synthadeus* app, Component* me);
+
+	// on panning slider changed callback
+	static void onPanningChanged(Synthadeus* app, Component* me);
 };
 
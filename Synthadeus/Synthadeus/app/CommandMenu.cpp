@@ -23,8 +23,16 @@ CommandMenu::CommandMenu(Point cmOrigin) :
 	btnMakeSummation(new Button(Point(0.f, 160.f),
 		Point(120.f, 40.f), COLOR_DKGREY, COLOR_LTGREY, "Summation", FONT_ARIAL20, CommandMenu::createSummation)),
 
+	// create the button to make an output
+	btnMakeOutput(new Button(Point(0.f, 200.f),
+		Point(120.f, 40.f), COLOR_DKGREY, COLOR_LTGREY, "Output", FONT_ARIAL20, CommandMenu::createOutput)),
+
+	// create the button to make a sample
+	btnMakeSample(new Button(Point(0.f, 240.f),
+		Point(120.f, 40.f), COLOR_DKGREY, COLOR_LTGREY, "Sample", FONT_ARIAL20, CommandMenu::createSample)),
+
 	// set our size
-	size(Point(120.f, 200.f))
+	size(Point(120.f, 280.f))
 {
 	// update our origin and set the bounding rectangle
 	origin[0] = cmOrigin[0];
@@ -37,6 +45,8 @@ CommandMenu::CommandMenu(Point cmOrigin) :
 	assert(addChild(btnMakeConstant) > -1);
 	assert(addChild(btnMakeMultiplier) > -1);
 	assert(addChild(btnMakeSummation) > -1);
+	assert(addChild(btnMakeOutput) > -1);
+	assert(addChild(btnMakeSample) > -1);
 
 	// we should be open for a little while at least
 	needsClosing = false;
@@ -108,6 +118,34 @@ void CommandMenu::createSummation(Synthadeus* app, Component* other)
 	app->createSummationNode();
 }
 
+void CommandMenu::createOutput(Synthadeus* app, Component* other)
+{
+	DebugPrintf("Creating an Output\n");
+
+	// resolve the identity crisis
+	assert(_strcmpi(other->getClassName(), CommandMenu::nameString()) == 0);
+	CommandMenu* myself = (CommandMenu*)other;
+
+	// remove myself and request the new node from the application
+	myself->signalRemoval();
+	myself->setBoundingRectangle(Point(0.f, 0.f), Point(0.f, 0.f));
+	app->createOutputNode();
+}
+
+void CommandMenu::createSample(Synthadeus* app, Component* other)
+{
+	DebugPrintf("Creating a Sample\n");
+
+	// resolve the identity crisis
+	assert(_strcmpi(other->getClassName(), CommandMenu::nameString()) == 0);
+	CommandMenu* myself = (CommandMenu*)other;
+
+	// remove myself and request the new node from the application
+	myself->signalRemoval();
+	myself->setBoundingRectangle(Point(0.f, 0.f), Point(0.f, 0.f));
+	app->createSampleNode();
+}
+
 Renderable* CommandMenu::getRenderList()
 {
 	// just return a non renderable to append more things to later
@@ -17,7 +17,7 @@ class CommandMenu : public Component
 {
 private:
 	// command buttons to issue commands
-	Button *btnMakeOscillator, *btnMakeEnvelope, *btnMakeConstant, *btnMakeMultiplier, *btnMakeSummation;
+	Button *btnMakeOscillator, *btnMakeEnvelope, *btnMakeConstant, *btnMakeMultiplier, *btnMakeSummation, *btnMakeOutput, *btnMakeSample;
 
 	// menu origin and size
 	Point origin;
@@ -48,6 +48,12 @@ public:
 	// menu command callback for making an summation
 	static void createSummation(Synthadeus* app, Component* other);
 
+	// menu command callback for making an output for the next midi channel
+	static void createOutput(Synthadeus* app, Component* other);
+
+	// menu command callback for making a sample
+	static void createSample(Synthadeus* app, Component* other);
+
 	// generate the menu renderables list
 	virtual Renderable* getRenderList();
 };
@@ -0,0 +1,101 @@
+#include "SampleNode.h"
+#include "Synthadeus.h"
+#include <commdlg.h>
+
+SampleNode::SampleNode(Point position)
+	: Node(position, Point(200.f, 65.f), COLOR_ORANGE, COLOR_ABLACK)
+{
+	// create the underlying sample node (silent until a file is picked)
+	sample = new AudioSample();
+	sprintf_s(title, "Sample");
+
+	// create the output connection point and add it to my component list
+	output = new OutputConnector(Point(170.f, 35.f), Point(20.f, 20.f), COLOR_ORANGE, this);
+	addChild(output);
+
+	// create and add the button which picks the file
+	loadButton = new Button(Point(10.f, 38.f), Point(50.f, 20.f), COLOR_DKGREY, COLOR_LTGREY, "Load", FONT_ARIAL11, onLoadPressed);
+	addChild(loadButton);
+
+	// create and add the slider which adjusts the speed
+	slider = new Slider(Point(70.f, 40.f), Point(90.f, 15.f), COLOR_ABLACK, COLOR_ORANGE, Slider::HORIZONTAL, 0.25f, 4.f, 1.f, 0.25f, onSliderChanged);
+	addChild(slider);
+
+	// update the UI to reflect the actual values
+	updateValue();
+}
+
+Renderable* SampleNode::getRenderList()
+{
+	// aquire the base renderable list
+	Renderable* nodeRenderables = Node::getRenderList();
+
+	// generate a title
+	Renderable* titleText = new Text(title, getOrigin(), Point(200.f, 40.f), FONT_ARIAL20, COLOR_WHITE);
+
+	// append the title to the list, returning the result
+	nodeRenderables->next = titleText;
+	return nodeRenderables;
+}
+
+AudioNode* SampleNode::getAudioNode()
+{
+	// return the idiot proof'd sample
+	assert(sample != NULL);
+	return sample;
+}
+
+bool SampleNode::chooseFile()
+{
+	// set up the open file structure
+	OPENFILENAME filename;
+	char fileNameBuffer[AudioSample::MAX_PATH_LENGTH];
+	ZeroMemory(fileNameBuffer, AudioSample::MAX_PATH_LENGTH);
+	ZeroMemory(&filename, sizeof(OPENFILENAME));
+
+	// fill out some data to help the users find the file
+	filename.lpstrFile = fileNameBuffer;
+	filename.lStructSize = sizeof(OPENFILENAME);
+	filename.nMaxFile = AudioSample::MAX_PATH_LENGTH;
+	filename.lpstrFilter = "Waveform Audio File (.wav)\0*.wav\0All Files\0*.*\0";
+	filename.nFilterIndex = 1;
+	filename.Flags = OFN_EXPLORER | OFN_FILEMUSTEXIST | OFN_PATHMUSTEXIST;
+	if (!GetOpenFileName(&filename))
+		return false;
+
+	// map the file (only its header is read now, the rest as it plays), titling the node with its name
+	if (sample->setFile(filename.lpstrFile))
+		sprintf_s(title, "%.40s", filename.lpstrFile + filename.nFileOffset);
+	else
+		sprintf_s(title, "Sample");
+	return true;
+}
+
+void SampleNode::updateValue()
+{
+	// pass the speed from the slider to the node
+	sample->setSpeed(slider->getValue());
+}
+
+void SampleNode::onLoadPressed(Synthadeus* app, Component* me)
+{
+	// resolve the identity crisis (buttons call back with their parent)
+	SampleNode* myself = dynamic_cast<SampleNode*>(me);
+
+	// pick the file and recalculate the graph (a file that can't be played leaves the node silent)
+	if (!myself->chooseFile())
+		return;
+	if (!myself->sample->isLoaded())
+		MessageBox(NULL, "The file could not be played. Samples are 16, 24 or 32 bit or float wave files in mono or stereo. ", "Whoops!", MB_ICONERROR);
+	app->recalculateAudioGraph();
+}
+
+void SampleNode::onSliderChanged(Synthadeus* app, Component* me)
+{
+	// resolve the identity crisis
+	SampleNode* myself = dynamic_cast<SampleNode*>(me->getParent());
+
+	// update myself and recalculate the graph
+	myself->updateValue();
+	app->recalculateAudioGraph();
+}
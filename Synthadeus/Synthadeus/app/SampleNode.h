@@ -0,0 +1,66 @@
+////////////////////////////////////////////////////////////////////////////////
+//                                                                            //
+//   Sample UI Node                                                           //
+//   Everett Moser                                                            //
+//   10-18-26                                                                 //
+//                                                                            //
+//   A UI for playing recorded wave files into the graph                      //
+//                                                                            //
+////////////////////////////////////////////////////////////////////////////////
+
+#pragma once
+
+#include "Node.h"
+#include "Connector.h"
+#include "Button.h"
+#include "Slider.h"
+#include "AudioSample.h"
+
+class SampleNode : public Node, public AudioUINode
+{
+private:
+
+	// audio graph sample node to maintain
+	AudioSample* sample;
+
+	// a connection to the next node in the sequence
+	OutputConnector* output;
+
+	// a button to pick the wave file played
+	Button* loadButton;
+
+	// a slider to adjust how fast the sample plays
+	Slider* slider;
+
+	// the name of the file played, shown as the title
+	char title[TEXT_MAX_STRING_LENGTH];
+
+public:
+
+	// run time type information
+	RTTI_MACRO(SampleNode);
+
+	// create the node at a specific place
+	SampleNode(Point position);
+
+	// generate the render list for the node
+	virtual Renderable* getRenderList();
+
+	// delete the graph node when it is no longer in use
+	inline virtual void onDestroy() { delete sample; }
+
+	// return the graph node which this UI node refers to
+	virtual AudioNode* getAudioNode();
+
+	// let the user pick a wave file to play (false if none was picked)
+	bool chooseFile();
+
+	// update the speed of the sample to the value of the slider
+	void updateValue();
+
+	// load button callback
+	static void onLoadPressed(Synthadeus* app, Component* me);
+
+	// slider changed callback
+	static void onSliderChanged(Synthadeus* app, Component* me);
+};
@@ -1,6 +1,13 @@
 #include "Synthadeus.h"
 #include "Renderables.h"
 
+// every part is played from a midi channel
+static_assert(AUDIO_PARTS <= InputDevice::CHANNELS, "Error, there are more parts than midi channels. ");
+
+// the blocks of audio F4 steps through rendering ahead of the device (0 renders in the callback, 16 is ~23 ms)
+static const int lookaheadSteps[] = { 0, 4, 8, 16, 32, 64 };
+static const int LOOKAHEAD_STEP_COUNT = sizeof(lookaheadSteps) / sizeof(lookaheadSteps[0]);
+
 void Synthadeus::updateViewport()
 {
 	// update viewport movement amount with keyboard state data (false = 0 by definition)
@@ -69,9 +76,20 @@ Synthadeus::Synthadeus()
 	base = new GridBase(Point(-640.f, -640.f), Point(appWindow->getWidth() + 1280.f, appWindow->getHeight() + 1280.f), COLOR_LTGREY, COLOR_BLACK);
 	audioOutputEndpoint = new AudioOutputNode(Point(appWindow->getWidth() + 340.f, appWindow->getHeight() * 0.5f + 610.f));
 	base->addChild(audioOutputEndpoint);
+	partEndpoints[0] = audioOutputEndpoint;
+	numPartEndpoints = 1;
+
+	// nothing touched to learn yet
+	touchedPart = -1;
+	touchedParameter = -1;
+	learningController = false;
+
+	// nothing exporting yet
+	exporter = NULL;
 
 	// create the audio playback interface
 	audioInterface = new AudioPlayback(audioOutputEndpoint, &inputDevice->vPiano);
+	audioInterface->setControllerChanges(midiInterface->getControllerChanges());
 	assert(audioInterface->initialize());
 	DebugPrintf("audio successfully initialized\n");
 
@@ -84,6 +102,9 @@ Synthadeus::~Synthadeus()
 	// starting shutdown
 	DebugPrintf("Shutting down Synthadeus.\n");
 
+	// stop an export still running
+	delete exporter;
+
 	// free the midi
 	DebugPrintf("Deinitializing Midi Interface\n");
 	midiInterface->deinitialize();
@@ -113,6 +134,9 @@ Synthadeus::~Synthadeus()
 	delete base;
 	DebugPrintf("Freed Base Components.\n");
 
+	// forget the remembered audio buffers
+	AudioNodeCache::clear();
+
 	// success!
 	DebugPrintf("Synthadeus Shutdown Complete.\n");
 }
@@ -147,15 +171,32 @@ void Synthadeus::update()
 	// apply sweep garbage collection, destroying everything that vanishes this frame
 	base->sweepDeletion();
 
-	// apply the wave export function if we press F5
+	// free audio snapshots the callback has finished with
+	audioInterface->reclaimSnapshots();
+
+	// apply the wave export function if we press F5 (or cancel the one running), and free it once it is done
 	if (inputDevice->vController.waveExport.checkReleased())
-	{
-		recalculateAudioGraph();
-		WaveExporter exporter(audioOutputEndpoint->getAudioNode()->getBufferSize(), audioOutputEndpoint->getAudioNode()->getBufferL(), audioOutputEndpoint->getAudioNode()->getBufferR());
-		exporter.prepareExport();
-		exporter.saveWaveFile();
-		exporter.unprepareExport();
-	}
+		exportWaveFile();
+	updateExport();
+
+	// tap the node under the mouse for a stem export if we press F9 (or untap it)
+	if (inputDevice->vController.stemTap.checkReleased())
+		tapStem();
+
+	// render further ahead of the audio device if we press F4
+	if (inputDevice->vController.lookahead.checkReleased())
+		changeLookahead();
+
+	// map midi controllers to parameters
+	updateMidiLearn();
+
+	// play or stop a midi file if we press F7
+	if (inputDevice->vController.midiPlay.checkReleased())
+		playMidiFile();
+
+	// save the patch if we press F8
+	if (inputDevice->vController.patchSave.checkReleased())
+		savePatch();
 
 	// quit the application if we pressed escape
 	if (inputDevice->vController.quit.checkReleased())
@@ -180,6 +221,30 @@ Renderable* Synthadeus::getRenderList()
 	Renderable* renderList = sortRenderList(base->getRenderTree());
 	renderList->next = watermark;
 
+	// how far along an export is, under the watermark
+	Renderable* last = watermark;
+	float lineHeight = 40.f;
+	if (exporter)
+	{
+		char progress[TEXT_MAX_STRING_LENGTH];
+		if (exporter->getNumStems() > 1)
+			sprintf_s(progress, "Exporting %d stems %d%% (F5 cancels)", exporter->getNumStems(), (int)(exporter->getProgress() * 100.f));
+		else
+			sprintf_s(progress, "Exporting %d%% (F5 cancels)", (int)(exporter->getProgress() * 100.f));
+		last->next = new Text(progress, -1.f * appWindow->getViewportInstance() + Point(0.f, lineHeight), Point((float)appWindow->getWidth(), 20.f), FONT_ARIAL20, COLOR_LTGREY);
+		last = last->next;
+		lineHeight += 20.f;
+	}
+
+	// how far ahead of the device the audio is rendered, and how often it still couldn't keep up, under that
+	int lookahead = audioInterface->getLookahead();
+	if (lookahead > 0)
+	{
+		char status[TEXT_MAX_STRING_LENGTH];
+		sprintf_s(status, "Rendering %d blocks (%d ms) ahead, %u underruns (F4 changes)", lookahead, lookahead * AUDIO_FRAME_SIZE * 1000 / AUDIO_SAMPLE_RATE, audioInterface->getUnderruns());
+		last->next = new Text(status, -1.f * appWindow->getViewportInstance() + Point(0.f, lineHeight), Point((float)appWindow->getWidth(), 20.f), FONT_ARIAL20, COLOR_LTGREY);
+	}
+
 	// return the new render list
 	return renderList;
 }
@@ -252,6 +317,277 @@ void Synthadeus::createSummationNode()
 	base->addChild(new SummationNode(place));
 }
 
+void Synthadeus::createOutputNode()
+{
+	// one output per midi channel
+	if (numPartEndpoints == AUDIO_PARTS)
+	{
+		MessageBox(appWindow->getWindowHandle(), "Every midi channel already has an output. ", "Whoops!", MB_ICONERROR);
+		return;
+	}
+
+	// create the output node relative to the base component
+	Point place = inputDevice->vMouse.position - base->getOrigin() - appWindow->getViewportInstance();
+	AudioOutputNode* output = new AudioOutputNode(place, numPartEndpoints);
+
+	// add it to the base and play it from its channel
+	base->addChild(output);
+	assert(audioInterface->addPart(output, inputDevice->getPiano(numPartEndpoints)) == numPartEndpoints);
+	partEndpoints[numPartEndpoints++] = output;
+}
+
+void Synthadeus::createSampleNode()
+{
+	// create the sample node relative to the base component
+	Point place = inputDevice->vMouse.position - base->getOrigin() - appWindow->getViewportInstance();
+
+	// add it to the base
+	base->addChild(new SampleNode(place));
+}
+
+void Synthadeus::updateMidiLearn()
+{
+	// F6 starts learning, forgetting whatever controller moved before
+	if (inputDevice->vController.midiLearn.checkReleased() && touchedPart >= 0)
+	{
+		DebugPrintf("Move a midi controller to map it to parameter %d of part %d\n", touchedParameter, touchedPart);
+		midiInterface->takeLastController();
+		learningController = true;
+	}
+
+	// the first controller moved afterwards is mapped
+	if (!learningController)
+		return;
+	int controller = midiInterface->takeLastController();
+	if (controller < 0)
+		return;
+	learningController = false;
+	if (!midiInterface->mapController(controller / MidiInterface::CONTROLLERS, controller % MidiInterface::CONTROLLERS, touchedPart, touchedParameter,
+		AudioPart::getParameterMinimum(touchedParameter), AudioPart::getParameterMaximum(touchedParameter)))
+		DebugPrintf("  [MIDI] Too many controllers mapped already.\n");
+}
+
+void Synthadeus::playMidiFile()
+{
+	// stop the one playing
+	if (audioInterface->isPlaying())
+	{
+		audioInterface->play(NULL);
+		return;
+	}
+
+	// set up the open file structure
+	OPENFILENAME filename;
+	char fileNameBuffer[1024];
+	ZeroMemory(fileNameBuffer, 1024);
+	ZeroMemory(&filename, sizeof(OPENFILENAME));
+
+	// fill out some data to help the users pick the file
+	filename.lpstrFile = fileNameBuffer;
+	filename.lStructSize = sizeof(OPENFILENAME);
+	filename.nMaxFile = 1024;
+	filename.lpstrFilter = "Standard MIDI File (.mid)\0*.mid;*.midi\0All Files\0*.*\0";
+	filename.nFilterIndex = 1;
+	filename.Flags = OFN_EXPLORER | OFN_FILEMUSTEXIST;
+	if (!GetOpenFileName(&filename))
+		return;
+
+	// load it, and play it from the next frame
+	MidiFile* file = new MidiFile();
+	if (!file->load(filename.lpstrFile))
+	{
+		delete file;
+		return;
+	}
+	DebugPrintf("Playing %s (%d events)\n", filename.lpstrFile, file->getNumEvents());
+	audioInterface->play(new MidiSequencer(file));
+}
+
+void Synthadeus::savePatch()
+{
+	// set up the save file structure
+	OPENFILENAME filename;
+	char fileNameBuffer[1024];
+	ZeroMemory(fileNameBuffer, 1024);
+	ZeroMemory(&filename, sizeof(OPENFILENAME));
+
+	// fill out some data to help the users save the file
+	filename.lpstrFile = fileNameBuffer;
+	filename.lStructSize = sizeof(OPENFILENAME);
+	filename.nMaxFile = 1024;
+	filename.lpstrFilter = "Synthadeus Patch (.syn)\0*.syn\0All Files\0*.*\0";
+	filename.lpstrDefExt = "syn";
+	filename.nFilterIndex = 1;
+	filename.Flags = OFN_EXPLORER | OFN_OVERWRITEPROMPT;
+	if (!GetSaveFileName(&filename))
+		return;
+
+	// the graphs are saved as they are calculated now
+	recalculateAudioGraph();
+	AudioNode* outputs[AUDIO_PARTS];
+	for (int i = 0; i < numPartEndpoints; i++)
+		outputs[i] = partEndpoints[i]->getAudioNode();
+	if (AudioPatch::save(filename.lpstrFile, outputs, numPartEndpoints))
+		DebugPrintf("Saved patch %s\n", filename.lpstrFile);
+	else
+		MessageBox(appWindow->getWindowHandle(), "The patch could not be saved. ", "Whoops!", MB_ICONERROR);
+}
+
+void Synthadeus::exportWaveFile()
+{
+	// one export at a time, so asking again cancels the one running
+	if (exporter)
+	{
+		exporter->cancel();
+		return;
+	}
+
+	// the nodes tapped are exported as stems, or the output when there are none
+	Node* tapped[MAX_STEMS];
+	int count = findStems(base, tapped, 0);
+	AudioNode* nodes[MAX_STEMS];
+	nodes[0] = audioOutputEndpoint->getAudioNode();
+
+	// one evaluation of the graph calculates every stem playing into an output, a node off to the side calculates its own
+	recalculateAudioGraph();
+	AudioNode* outputs[AUDIO_PARTS];
+	for (int i = 0; i < numPartEndpoints; i++)
+		outputs[i] = partEndpoints[i]->getAudioNode();
+	int ids[MAX_STEMS];
+	for (int i = 0; i < count; i++)
+	{
+		nodes[i] = dynamic_cast<AudioUINode*>(tapped[i])->getAudioNode();
+		if (!feedsOutput(tapped[i]))
+			nodes[i]->recalculate();
+
+		// each stem is named with the id its node has in a patch saved now (F8), so the two can be matched up
+		ids[i] = AudioPatch::getSavedId(nodes[i], outputs, numPartEndpoints);
+	}
+
+	// the export takes its own copy of the nodes, so playing and editing carry on while it is written
+	exporter = new WaveExporter(nodes, (count > 0 ? count : 1), (count > 0 ? ids : NULL));
+	if (exporter->getNumStems() < (count > 0 ? count : 1))
+	{
+		// a node that calculated no samples is refused, rather than written as a file of silence
+		MessageBox(appWindow->getWindowHandle(), "A node has no samples to export. ", "Whoops!", MB_ICONERROR);
+		delete exporter;
+		exporter = NULL;
+		return;
+	}
+	if (!exporter->saveWaveFile())
+	{
+		delete exporter;
+		exporter = NULL;
+	}
+}
+
+void Synthadeus::changeLookahead()
+{
+	// the step after the current one, or back to rendering in the callback after the last
+	int current = audioInterface->getLookahead();
+	int next = 0;
+	for (int i = 0; i < LOOKAHEAD_STEP_COUNT; i++)
+	{
+		if (lookaheadSteps[i] > current)
+		{
+			next = lookaheadSteps[i];
+			break;
+		}
+	}
+
+	// swap the renderer (the sound stops for a moment)
+	audioInterface->setLookahead(next);
+	DebugPrintf("  [AUDIO] Rendering %d blocks ahead of the device.\n", next);
+}
+
+void Synthadeus::tapStem()
+{
+	// the node under the mouse, or the one whose connector, slider or button it is
+	Component* component = findComponentAtLocation(inputDevice->vMouse.position);
+	while (component && !(dynamic_cast<Node*>(component) && dynamic_cast<AudioUINode*>(component)))
+		component = component->getParent();
+	if (!component)
+		return;
+
+	// tapped nodes are outlined, and exported as stems by F5
+	Node* node = dynamic_cast<Node*>(component);
+	node->toggleTapped();
+	DebugPrintf("%s %s for stem export\n", (node->isTapped() ? "Tapped" : "Untapped"), node->getClassName());
+}
+
+int Synthadeus::findStems(Component* component, Node** stems, int count)
+{
+	// this one, if it is a tapped audio node
+	Node* node = dynamic_cast<Node*>(component);
+	if (node && node->isTapped() && dynamic_cast<AudioUINode*>(component))
+	{
+		if (count < MAX_STEMS)
+			stems[count++] = node;
+		else
+			DebugPrintf("Only %d stems can be exported at once, leaving out %s\n", MAX_STEMS, node->getClassName());
+	}
+
+	// then everything under it
+	for (int i = 0; i < component->getNumChildren(); i++)
+		count = findStems(component->child(i), stems, count);
+	return count;
+}
+
+bool Synthadeus::feedsOutput(Node* node)
+{
+	// a part's output is the end of its graph
+	for (int i = 0; i < numPartEndpoints; i++)
+	{
+		if (node == partEndpoints[i])
+			return true;
+	}
+
+	// otherwise follow every connection out of it
+	for (int i = 0; i < node->getNumChildren(); i++)
+	{
+		OutputConnector* output = dynamic_cast<OutputConnector*>(node->child(i));
+		if (!output)
+			continue;
+		for (int j = 0; j < output->isConnected(); j++)
+		{
+			Node* other = output->getConnectionParent(j);
+			if (other && feedsOutput(other))
+				return true;
+		}
+	}
+	return false;
+}
+
+void Synthadeus::updateExport()
+{
+	// still going
+	if (!exporter || !exporter->isFinished())
+		return;
+
+	// let the user know how it went
+	if (exporter->wasSuccessful() && exporter->getNumStems() > 1)
+		DebugPrintf("Exported %d stems named after %s\n", exporter->getNumStems(), exporter->getPath());
+	else if (exporter->wasSuccessful())
+		DebugPrintf("Exported %s\n", exporter->getPath());
+	else if (exporter->wasCancelled())
+		DebugPrintf("Cancelled exporting %s\n", exporter->getPath());
+	else
+		MessageBox(appWindow->getWindowHandle(), "The waveform could not be exported. ", "Whoops!", MB_ICONERROR);
+	delete exporter;
+	exporter = NULL;
+}
+
+void Synthadeus::setPartParameter(int part, int parameter, float value)
+{
+	// remember it for midi learn
+	touchedPart = part;
+	touchedParameter = parameter;
+
+	// the change reaches the audio thread on its next frame
+	if (!audioInterface->setParameter(part, parameter, value))
+		DebugPrintf("  [AUDIO] Dropped a parameter change, the queue is full.\n");
+}
+
 void Synthadeus::recalculateAudioGraph()
 {
 	// should figure out how to minimize these calls by looking at the logs afterward
@@ -264,13 +600,18 @@ void Synthadeus::recalculateAudioGraph()
 	Renderable* list = getRenderList();
 	assert(list->next);
 
-	// append the message
+	// append the message after the watermark (and the export progress, if there is one)
+	recalculatingMark->next = list->next->next;
 	list->next->next = recalculatingMark;
 
 	// force render
 	appWindow->setRenderList(list);
 	appWindow->render();
 
-	// start the graph update process (slow)
-	audioOutputEndpoint->getAudioNode()->recalculate();
+	// start the graph update process for every part (slow)
+	for (int i = 0; i < numPartEndpoints; i++)
+		partEndpoints[i]->getAudioNode()->recalculate();
+
+	// hand the new outputs to the audio callback
+	audioInterface->publishSnapshots();
 }
\ No newline at end of file
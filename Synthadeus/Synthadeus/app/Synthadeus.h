@@ -26,6 +26,8 @@
 #include "SummationNode.h"
 #include "ConstantNode.h"
 #include "MultiplierNode.h"
+#include "SampleNode.h"
+#include "AudioPatch.h"
 
 // current Synthadeus version string, once envelopes are put in, Synthadeus gets a 1.0
 #define SYNTHADEUS_VERSION "Synthadeus 1.0"
@@ -48,6 +50,47 @@ private:
 	// the output node to play audio back from
 	AudioOutputNode* audioOutputEndpoint;
 
+	// the output node of every part, one per midi channel (the first is the one above)
+	AudioOutputNode* partEndpoints[AUDIO_PARTS];
+	int numPartEndpoints;
+
+	// the part parameter last moved from the UI (-1 for none), which midi learn maps the next controller moved to
+	int touchedPart, touchedParameter;
+	bool learningController;
+
+	// map the next controller moved to the parameter last touched, once the learn key is released
+	void updateMidiLearn();
+
+	// play a midi file the user picks along with the pianos, or stop the one playing
+	void playMidiFile();
+
+	// save the graph behind every part's output to a patch the user picks (for the offline renderer)
+	void savePatch();
+
+	// the export running in the background (NULL for none)
+	WaveExporter* exporter;
+
+	// start exporting the output (or the nodes tapped, as stems) to a wave file the user picks, or cancel the export running
+	void exportWaveFile();
+
+	// free the export once it is done, letting the user know how it went
+	void updateExport();
+
+	// the most nodes tapped for a stem export
+	const static int MAX_STEMS = 16;
+
+	// tap the node under the mouse for a stem export, or untap it
+	void tapStem();
+
+	// render the audio the next step further ahead of the device (back in the callback after the last step)
+	void changeLookahead();
+
+	// add the nodes tapped in a component and everything under it to a list (returns how long the list is now)
+	int findStems(Component* component, Node** stems, int count);
+
+	// whether a node plays into the output of a part, so recalculating the parts calculates it too
+	bool feedsOutput(Node* node);
+
 	// viewport friction constant
 	const float viewportFriction;
 
@@ -124,6 +167,15 @@ public:
 	// create an summation within the base node
 	void createSummationNode();
 
+	// create an output for the next midi channel within the base node
+	void createOutputNode();
+
+	// create a sample within the base node
+	void createSampleNode();
+
+	// glide a parameter of a part while it plays (see AudioPart::Parameter)
+	void setPartParameter(int part, int parameter, float value);
+
 	// recalculate audio
 	void recalculateAudioGraph();
 };
@@ -16,8 +16,10 @@
 // the tune note is this frequency
 #define AUDIO_TUNE_FREQUENCY 440.f
 
-// sample rate
+// sample rate everything is rendered at (a build may choose another, renders are resampled to whatever rate they are written at)
+#ifndef AUDIO_SAMPLE_RATE
 #define AUDIO_SAMPLE_RATE 44100
+#endif
 
 // default number of channels
 #define AUDIO_CHANNELS 2
@@ -28,5 +30,56 @@ extern bool isUsingAsio;
 // frame size
 #define AUDIO_FRAME_SIZE 64
 
-// small 10s buffer
-#define AUDIO_BUFFER_SIZE (AUDIO_SAMPLE_RATE * 60)
\ No newline at end of file
+// small 10s buffer (the largest a node's buffer may grow)
+#define AUDIO_BUFFER_SIZE (AUDIO_SAMPLE_RATE * 60)
+
+// samples read from an input at a time while a node calculates
+#define AUDIO_SPAN_SIZE 256
+
+// playback positions are 32.32 fixed point, whole samples in the high half and the fraction in the low half
+// (adding a fixed point speed is exact, so a note never drifts however long it is held)
+typedef unsigned long long AudioPosition;
+#define AUDIO_POSITION_ONE (1ULL << 32)
+
+// the whole sample and the fraction (to 24 bits, all a float holds) of a position
+#define AUDIO_POSITION_SAMPLE(position) ((int)((position) >> 32))
+#define AUDIO_POSITION_FRACTION(position) ((float)(int)(((position) >> 8) & 0xFFFFFF) * (1.f / 16777216.f))
+
+// blocks the playback renders ahead of the audio callback on a worker thread, for patches too heavy to render in time
+// (0 renders in the callback, each block adds AUDIO_FRAME_SIZE samples of latency, 16 blocks is ~23 ms)
+#define AUDIO_LOOKAHEAD_BLOCKS 0
+
+// threads mixing a share of the held notes alongside the one rendering each block, for offline renders (0 mixes every note on one thread)
+// (live playback starts one for every core but the callback's and the UI's instead, see AudioPlayback)
+#define AUDIO_VOICE_THREADS 0
+
+// memory the node cache may hold on to for previously calculated buffers
+#define AUDIO_CACHE_MEMORY_BUDGET (256 * 1024 * 1024)
+
+// graphs played at once, each from its own midi channel (multi-timbral parts)
+#define AUDIO_PARTS 16
+
+// time constant of the one-pole smoothing parameters follow while playing, in seconds (settled within ~5 of them)
+#define AUDIO_PARAMETER_SMOOTHING 0.005f
+
+// number of notes that can be played (one per piano key)
+#define AUDIO_NOTE_COUNT 132
+
+// how much of each note is pre-rendered at its pitch, in samples (the rest is interpolated while playing)
+#define AUDIO_NOTE_RENDER_LENGTH (AUDIO_SAMPLE_RATE * 2)
+
+// memory the pre-rendered notes of the playing graph may use
+#define AUDIO_NOTE_CACHE_BUDGET (64 * 1024 * 1024)
+
+// keep long node buffers as 16 bit samples sharing a scale per block (comment out for full floats everywhere)
+#define AUDIO_COMPACT_STORAGE
+
+// buffers shorter than this (in samples) stay full precision
+#define AUDIO_COMPACT_THRESHOLD AUDIO_SAMPLE_RATE
+
+// samples sharing one scale in compact storage (a power of two)
+#define AUDIO_COMPACT_BLOCK_SHIFT 6
+#define AUDIO_COMPACT_BLOCK_SIZE (1 << AUDIO_COMPACT_BLOCK_SHIFT)
+
+// channels needing at least this many bytes are spilled to memory mapped temporary files (comment out to keep them in memory)
+#define AUDIO_SPILL_THRESHOLD (4 * 1024 * 1024)
\ No newline at end of file
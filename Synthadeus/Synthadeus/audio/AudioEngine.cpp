@@ -0,0 +1,443 @@
+#include "AudioEngine.h"
+
+// controllers a sequence may move (general midi numbering)
+#define MIDI_CONTROLLER_VOLUME 7
+#define MIDI_CONTROLLER_PAN 10
+#define MIDI_CONTROLLER_SOUND_OFF 120
+#define MIDI_CONTROLLER_NOTES_OFF 123
+
+AudioEngine::AudioEngine()
+	: numParts(0), clock(0), noteRendererQuit(false), noteRendering(true), snapshotVersion(0), controllerChanges(NULL),
+	  sequencer(NULL), sequencerInUse(NULL), sequencerPlaying(0), sequencerFinished(0), started(false),
+	  numVoices(0), numVoiceThreads(AUDIO_VOICE_THREADS), voiceGeneration(0), voicesPending(0), voiceThreadsQuit(false)
+{
+	// initialize all the speeds of note playback
+	for (int i = 0; i < AUDIO_NOTE_COUNT; i++)
+		speeds[i] = (AudioPosition)(getFrequencyForNote(i) / AUDIO_TUNE_FREQUENCY * (double)AUDIO_POSITION_ONE + 0.5);
+}
+
+AudioEngine::~AudioEngine()
+{
+	// no one may be rendering anymore
+	stop();
+
+	// so every part, its snapshots and the sequence can go
+	for (int i = 0; i < numParts.load(); i++)
+		delete parts[i];
+	numParts.store(0);
+	delete sequencer.exchange(NULL);
+}
+
+int AudioEngine::addPart(AudioNode* output)
+{
+	// a snapshot of the endpoint as it is now, held by the part alone
+	AudioGraphSnapshot* graph = new AudioGraphSnapshot(output);
+	int index = addPart(graph);
+	graph->release();
+	return index;
+}
+
+int AudioEngine::addPart(AudioGraphSnapshot* graph)
+{
+	// idiot test
+	int index = numParts.load();
+	if (index == AUDIO_PARTS)
+		return -1;
+
+	// the part is complete before the rendering thread can see it
+	parts[index] = new AudioPart(graph);
+	numParts.store(index + 1);
+
+	// wake the note renderer up for its first snapshot
+	snapshotVersion++;
+	wakeNoteRenderer();
+	return index;
+}
+
+void AudioEngine::setControllerChanges(AudioParameterQueue* queue)
+{
+	// the rendering thread would already be reading it once started
+	assert(!started);
+	controllerChanges = queue;
+}
+
+void AudioEngine::setVoiceThreads(int threads)
+{
+	// the team is already running once started
+	assert(!started);
+	assert(threads >= 0 && threads <= MAX_VOICE_THREADS);
+	numVoiceThreads = threads;
+}
+
+void AudioEngine::setNoteRendering(bool enabled)
+{
+	// the renderer is already running once started
+	assert(!started);
+	noteRendering = enabled;
+}
+
+void AudioEngine::start()
+{
+	// idiot test
+	if (started)
+		return;
+	noteRendererQuit.store(false);
+	voiceThreadsQuit.store(false);
+	voiceGeneration.store(0);
+
+	// start the team helping to mix notes (they sleep until the first block with more than one)
+	for (int i = 0; i < numVoiceThreads; i++)
+		voiceThreads[i].thread = std::thread(mixVoiceShare, this, i + 1);
+
+	// start rendering notes in the background
+	if (noteRendering)
+		noteRenderer = std::thread(renderNotes, this);
+	started = true;
+}
+
+void AudioEngine::stop()
+{
+	// idiot test
+	if (!started)
+		return;
+
+	// stop the note renderer
+	{
+		std::lock_guard<std::mutex> lock(noteRendererMutex);
+		noteRendererQuit.store(true);
+	}
+	noteRendererWake.notify_one();
+	if (noteRenderer.joinable())
+		noteRenderer.join();
+
+	// stop the team
+	voiceThreadsQuit.store(true);
+	voiceGeneration.fetch_add(1, std::memory_order_release);
+	ThreadPark::wakeAll(voiceGeneration);
+	for (int i = 0; i < numVoiceThreads; i++)
+	{
+		if (voiceThreads[i].thread.joinable())
+			voiceThreads[i].thread.join();
+	}
+	started = false;
+}
+
+void AudioEngine::renderFrame(float* out)
+{
+	// take in the parameter changes made since the last frame
+	int partCount = numParts.load();
+	applyParameterChanges(&parameterChanges, partCount);
+	if (controllerChanges)
+		applyParameterChanges(controllerChanges, partCount);
+
+	// press and release the sequence's keys on their samples
+	playSequence(partCount);
+
+	// gather the sounding keys of every part, for the team to mix whichever part they belong to
+	numVoices = 0;
+	for (int p = 0; p < partCount; p++)
+	{
+		// pin the part's current snapshot so the UI thread leaves it alone
+		AudioPart* part = parts[p];
+		AudioGraphSnapshot* graph = part->pinPlaying();
+
+		// move its parameters along, whether or not anything is playing
+		part->smoothParameters();
+
+		// a silent graph sounds the same however many keys are held
+		int keys[AUDIO_NOTE_COUNT];
+		int keysPressed = part->getSoundingKeys(keys);
+		if (!graph->isSilent())
+		{
+			for (int i = 0; i < keysPressed; i++)
+			{
+				Voice& voice = voices[numVoices++];
+				voice.part = part;
+				voice.graph = graph;
+				voice.key = keys[i];
+				voice.keysPressed = keysPressed;
+			}
+		}
+	}
+
+	// calculate the new output signals (or only move the keys along, when skipping the frame)
+	if (out)
+		calculateSummedSignal();
+	else
+		skipVoices();
+
+	// fill the output buffers
+	for (int i = 0; out && i < AUDIO_FRAME_SIZE; i++)
+	{
+		*out++ = summedSignal[2 * i];
+		*out++ = summedSignal[2 * i + 1];
+	}
+
+	// we are done with the frame and the snapshots
+	for (int p = 0; p < partCount; p++)
+	{
+		parts[p]->endFrame();
+		parts[p]->unpinPlaying();
+	}
+	clock.store(clock.load() + AUDIO_FRAME_SIZE);
+}
+
+void AudioEngine::saveState(State& state)
+{
+	// how far along the sequence is, and whether the keys it pressed are still its own
+	MidiSequencer* sequence = sequencer.load();
+	state.clock = clock.load();
+	state.sequenceNext = 0;
+	state.sequenceStart = -1;
+	if (sequence)
+		sequence->getPosition(state.sequenceNext, state.sequenceStart);
+	state.sequenceHolding = (sequence && sequencerPlaying == sequence->getId());
+
+	// every part
+	state.numParts = numParts.load();
+	for (int p = 0; p < state.numParts; p++)
+		parts[p]->saveState(state.parts[p]);
+}
+
+void AudioEngine::loadState(const State& state)
+{
+	// idiot test
+	assert(state.numParts == numParts.load());
+
+	// our own sequence takes over from wherever the other one was, keys and all
+	MidiSequencer* sequence = sequencer.load();
+	clock.store(state.clock);
+	if (sequence)
+	{
+		sequence->setPosition(state.sequenceNext, state.sequenceStart);
+		sequencerPlaying = (state.sequenceHolding ? sequence->getId() : 0);
+		if (sequence->isFinished())
+			sequencerFinished.store(sequence->getId());
+	}
+	for (int p = 0; p < state.numParts; p++)
+		parts[p]->loadState(state.parts[p]);
+}
+
+void AudioEngine::applyParameterChanges(AudioParameterQueue* queue, int partCount)
+{
+	// changes to parts not added yet are dropped
+	AudioParameterQueue::Change change;
+	while (queue->pop(change))
+	{
+		if (change.part < partCount)
+			parts[change.part]->setParameter(change.parameter, change.value);
+	}
+}
+
+void AudioEngine::play(MidiSequencer* sequence)
+{
+	// swap the new one in
+	MidiSequencer* previous = sequencer.exchange(sequence);
+	if (!previous)
+		return;
+
+	// the rendering thread may still be reading the old one, but only until the end of its frame
+	while (sequencerInUse.load() == previous)
+		std::this_thread::yield();
+	delete previous;
+}
+
+bool AudioEngine::isPlaying()
+{
+	// only we free sequences, so the id is safe to read
+	MidiSequencer* sequence = sequencer.load();
+	return sequence && sequencerFinished.load() != sequence->getId();
+}
+
+void AudioEngine::playSequence(int partCount)
+{
+	// pin the current sequence so the UI thread leaves it alone, checking it wasn't replaced in between
+	MidiSequencer* sequence;
+	do
+	{
+		sequence = sequencer.load();
+		sequencerInUse.store(sequence);
+	} while (sequence != sequencer.load());
+
+	// a different sequence (or none) lets go of every key the last one held
+	unsigned int id = (sequence ? sequence->getId() : 0);
+	if (id != sequencerPlaying)
+	{
+		for (int p = 0; p < partCount; p++)
+			parts[p]->releaseAll(0, AudioPart::SEQUENCE);
+		sequencerPlaying = id;
+	}
+
+	// play the events due this frame, starting the sequence right here if it is new
+	if (sequence)
+	{
+		long long frameStart = clock.load();
+		sequence->begin(frameStart);
+		MidiFile::Event event;
+		int offset;
+		while (sequence->nextEvent(frameStart, event, offset))
+			playEvent(event, offset, partCount);
+		if (sequence->isFinished())
+			sequencerFinished.store(id);
+	}
+
+	// let go of it
+	sequencerInUse.store(NULL);
+}
+
+void AudioEngine::playEvent(const MidiFile::Event& event, int offset, int partCount)
+{
+	// channels without a part of their own play the first, so a single patch plays a whole file
+	int channel = event.status & 0x0F;
+	AudioPart* part = parts[channel < partCount ? channel : 0];
+
+	// a note on without velocity is a note off
+	int command = event.status & 0xF0;
+	if (command == MidiFile::NOTE_ON && event.data2 > 0)
+		part->noteOn(event.data1, event.data2 / 127.f, offset, AudioPart::SEQUENCE);
+	else if (command == MidiFile::NOTE_ON || command == MidiFile::NOTE_OFF)
+		part->noteOff(event.data1, offset, AudioPart::SEQUENCE);
+
+	// the controllers with a part parameter to move, and the panic ones
+	else if (command == MidiFile::CONTROL)
+	{
+		if (event.data1 == MIDI_CONTROLLER_VOLUME)
+			part->setParameter(AudioPart::GAIN, event.data2 / 127.f);
+		else if (event.data1 == MIDI_CONTROLLER_PAN)
+			part->setParameter(AudioPart::PAN, (event.data2 > 64 ? (event.data2 - 64) / 63.f : (event.data2 - 64) / 64.f));
+		else if (event.data1 == MIDI_CONTROLLER_SOUND_OFF || event.data1 == MIDI_CONTROLLER_NOTES_OFF)
+			part->releaseAll(offset, AudioPart::SEQUENCE);
+	}
+}
+
+void AudioEngine::calculateSummedSignal()
+{
+	// a single note (or no team) is mixed right here
+	if (numVoices <= 1 || numVoiceThreads == 0)
+	{
+		mixVoices(0, 1, summedSignal, spanL, spanR);
+		return;
+	}
+
+	// fork, handing every member the block (members without a note of their own just clear their frame)
+	voicesPending.store(numVoiceThreads, std::memory_order_relaxed);
+	voiceGeneration.fetch_add(1, std::memory_order_release);
+	ThreadPark::wakeAll(voiceGeneration);
+
+	// mix our own share meanwhile
+	mixVoices(0, numVoiceThreads + 1, summedSignal, spanL, spanR);
+
+	// join, spinning rather than sleeping since this may well be the callback
+	while (voicesPending.load(std::memory_order_acquire) > 0)
+		ThreadPark::relax();
+
+	// sum the team's frames into ours
+	for (int i = 0; i < numVoiceThreads; i++)
+	{
+		for (int j = 0; j < AUDIO_FRAME_SIZE * 2; j++)
+			summedSignal[j] += voiceThreads[i].summedSignal[j];
+	}
+}
+
+void AudioEngine::skipVoices()
+{
+	// the keys end up wherever mixing them would have left them
+	for (int i = 0; i < numVoices; i++)
+		voices[i].part->skipNote(voices[i].graph, voices[i].key, speeds[voices[i].key]);
+}
+
+void AudioEngine::mixVoiceShare(AudioEngine* myself, int member)
+{
+	// our own frame and spans
+	VoiceThread& thread = myself->voiceThreads[member - 1];
+
+	// the generation of the last block mixed
+	unsigned int mixed = 0;
+	while (true)
+	{
+		// park until the next block is handed out
+		ThreadPark::wait(myself->voiceGeneration, mixed, VOICE_SPINS);
+		mixed = myself->voiceGeneration.load(std::memory_order_acquire);
+		if (myself->voiceThreadsQuit.load())
+			return;
+
+		// mix our share of the notes and report back
+		myself->mixVoices(member, myself->numVoiceThreads + 1, thread.summedSignal, thread.spanL, thread.spanR);
+		myself->voicesPending.fetch_sub(1, std::memory_order_acq_rel);
+	}
+}
+
+void AudioEngine::mixVoices(int member, int stride, float* summed, float* leftSpan, float* rightSpan)
+{
+	// initialize to 0.f
+	for (int j = 0; j < AUDIO_FRAME_SIZE * 2; j++)
+		summed[j] = 0.f;
+
+	// every stride'th voice is ours, so no two members ever touch the same note of the same part
+	for (int i = member; i < numVoices; i += stride)
+	{
+		Voice& voice = voices[i];
+		voice.part->mixNote(voice.graph, voice.key, speeds[voice.key], voice.keysPressed, summed, leftSpan, rightSpan);
+	}
+}
+
+void AudioEngine::publishSnapshot(int part, AudioNode* output)
+{
+	// copy the part's graph as it is now, and swap it in for the rendering thread
+	AudioGraphSnapshot* graph = new AudioGraphSnapshot(output);
+	parts[part]->publishSnapshot(graph);
+	graph->release();
+	snapshotVersion++;
+	wakeNoteRenderer();
+}
+
+void AudioEngine::reclaimSnapshots()
+{
+	// every part frees its own
+	for (int i = 0; i < numParts.load(); i++)
+		parts[i]->reclaimSnapshots();
+}
+
+void AudioEngine::wakeNoteRenderer()
+{
+	// taking the lock makes sure it isn't between checking the version and sleeping
+	{
+		std::lock_guard<std::mutex> lock(noteRendererMutex);
+	}
+	noteRendererWake.notify_one();
+}
+
+void AudioEngine::renderNotes(AudioEngine* myself)
+{
+	// the version of the last snapshots rendered (addresses get reused, versions don't)
+	unsigned int rendered = 0;
+
+	while (true)
+	{
+		// sleep until there is a new snapshot (or we are told to stop)
+		{
+			std::unique_lock<std::mutex> lock(myself->noteRendererMutex);
+			while (!myself->noteRendererQuit.load() && myself->snapshotVersion.load() == rendered)
+				myself->noteRendererWake.wait(lock);
+		}
+		if (myself->noteRendererQuit.load())
+			return;
+
+		// if another one is published while rendering these, we come straight back
+		rendered = myself->snapshotVersion.load();
+
+		// every part with a new snapshot gets its share of the budget
+		int partCount = myself->numParts.load();
+		for (int i = 0; i < partCount && !myself->noteRendererQuit.load(); i++)
+		{
+			if (myself->parts[i]->needsNotes())
+				myself->parts[i]->renderNotes(myself->speeds, AUDIO_NOTE_CACHE_BUDGET / partCount, myself->noteRendererQuit);
+		}
+	}
+}
+
+// macro cleanup
+#undef MIDI_CONTROLLER_VOLUME
+#undef MIDI_CONTROLLER_PAN
+#undef MIDI_CONTROLLER_SOUND_OFF
+#undef MIDI_CONTROLLER_NOTES_OFF
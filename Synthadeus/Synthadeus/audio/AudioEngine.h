@@ -0,0 +1,226 @@
+////////////////////////////////////////////////////////////////////////////////
+//                                                                            //
+//   Audio Engine                                                             //
+//   Everett Moser                                                            //
+//   10-18-26                                                                 //
+//                                                                            //
+//   Mixes every part's held notes frame by frame against a sample clock      //
+//                                                                            //
+////////////////////////////////////////////////////////////////////////////////
+
+#pragma once
+
+#include "Error.h"
+#include "CFMaths.h"
+#include "AudioDefines.h"
+#include "AudioPart.h"
+#include "AudioParameterQueue.h"
+#include "MidiSequencer.h"
+
+#include <atomic>
+#include <thread>
+#include <mutex>
+#include <condition_variable>
+#include "ThreadPark.h"
+
+// the engine knows nothing of the audio device, whoever drives it calls renderFrame once per frame
+// (the playback from its callback or lookahead, an offline render as fast as it can)
+class AudioNode;
+class AudioEngine
+{
+public:
+	// the most threads that may help mix each frame, besides whoever renders it
+	const static int MAX_VOICE_THREADS = 8;
+
+private:
+	// the parts played at once, each its own graph played from its own midi channel (parts are only ever added)
+	AudioPart* parts[AUDIO_PARTS];
+	std::atomic<int> numParts;
+
+	// samples rendered so far, the clock sequences are played against
+	std::atomic<long long> clock;
+
+	// renders the start of every note from each new snapshot in the background, so rendering only has to mix
+	std::thread noteRenderer;
+	std::mutex noteRendererMutex;
+	std::condition_variable noteRendererWake;
+	std::atomic<bool> noteRendererQuit;
+
+	// whether to start the note renderer at all (offline renders mix every note by interpolation instead)
+	bool noteRendering;
+
+	// counts the snapshots published by any part, so the renderer can tell when there is a new one
+	std::atomic<unsigned int> snapshotVersion;
+
+	// the note renderer's thread
+	static void renderNotes(AudioEngine* myself);
+
+	// wake the note renderer for new snapshots
+	void wakeNoteRenderer();
+
+	// parameter changes on their way from the UI thread to whichever thread renders
+	AudioParameterQueue parameterChanges;
+
+	// parameter changes on their way from mapped midi controllers (NULL for none, see MidiInterface)
+	AudioParameterQueue* controllerChanges;
+
+	// take in the parameter changes of a queue (whichever thread renders)
+	void applyParameterChanges(AudioParameterQueue* queue, int partCount);
+
+	// the sequence playing, swapped whole by the UI thread, and the one the rendering thread is reading right now (NULL between frames)
+	std::atomic<MidiSequencer*> sequencer;
+	std::atomic<MidiSequencer*> sequencerInUse;
+
+	// the id of the sequence the parts' sequenced keys belong to (the rendering thread only)
+	unsigned int sequencerPlaying;
+
+	// the id of the last sequence to play its final event
+	std::atomic<unsigned int> sequencerFinished;
+
+	// play the sequence's events due this frame, each on its sample (the rendering thread only)
+	void playSequence(int partCount);
+
+	// play an event from a sequence a number of samples into the frame
+	void playEvent(const MidiFile::Event& event, int offset, int partCount);
+
+	// are the threads running?
+	bool started;
+
+	// tuned for C5 to be 440 Hz (see audio defines)
+	inline float getFrequencyForNote(int note) { return AUDIO_TUNE_FREQUENCY * fpowf(1.0594631f, (note - AUDIO_TUNE_NOTE)); };
+
+	// speeds of playback (fixed point, see AudioPosition), the same for every part
+	AudioPosition speeds[AUDIO_NOTE_COUNT];
+
+	// holds both left and right audio
+	float summedSignal[AUDIO_FRAME_SIZE * 2];
+
+	// the output samples a key's frame is interpolated between, decoded in one go
+	float spanL[AudioPart::SPAN_SIZE];
+	float spanR[AudioPart::SPAN_SIZE];
+
+	// a sounding key of a part, with the snapshot it is played from this frame
+	struct Voice
+	{
+		AudioPart* part;
+		AudioGraphSnapshot* graph;
+		int key;
+		int keysPressed;
+	};
+
+	// every sounding key of every part this frame, in one list so the team splits the notes rather than the parts
+	// (a part is as heavy as the keys held on it, so one busy part would leave a thread per part idle besides it)
+	const static int MAX_VOICES = AUDIO_PARTS * AUDIO_NOTE_COUNT;
+	Voice voices[MAX_VOICES];
+	int numVoices;
+
+	// threads mixing a disjoint share of the held notes each block, which whoever renders sums (fork-join)
+	static_assert(AUDIO_VOICE_THREADS >= 0 && AUDIO_VOICE_THREADS <= MAX_VOICE_THREADS, "Error, too many voice threads. ");
+	struct VoiceThread
+	{
+		std::thread thread;
+		float summedSignal[AUDIO_FRAME_SIZE * 2];
+		float spanL[AudioPart::SPAN_SIZE];
+		float spanR[AudioPart::SPAN_SIZE];
+	};
+	VoiceThread voiceThreads[MAX_VOICE_THREADS];
+	int numVoiceThreads;
+
+	// the block's voices are handed to the team by bumping the generation
+	std::atomic<unsigned int> voiceGeneration;
+
+	// team members still mixing this block, and whether they should stop
+	std::atomic<int> voicesPending;
+	std::atomic<bool> voiceThreadsQuit;
+
+	// spins before a team member sleeps between blocks (a block is ~1.5 ms, so spinning catches quick ones)
+	const static int VOICE_SPINS = 4000;
+
+	// a team member's thread
+	static void mixVoiceShare(AudioEngine* myself, int member);
+
+	// mix a member's share of the voices (every stride'th from its own) into a frame, interpolating within its spans
+	void mixVoices(int member, int stride, float* summed, float* leftSpan, float* rightSpan);
+
+	// calculate the fed signal for every key sounding on every part at once
+	void calculateSummedSignal();
+
+	// move every key sounding on every part along a frame, without mixing any of them
+	void skipVoices();
+
+public:
+
+	// where an engine is between frames: its clock, how far along its sequence is and where every part's keys and parameters are,
+	// so an engine with the same parts playing the same file can carry on from exactly there (see OfflineRender)
+	struct State
+	{
+		long long clock;
+		int sequenceNext;
+		long long sequenceStart;
+		bool sequenceHolding;
+		int numParts;
+		AudioPart::State parts[AUDIO_PARTS];
+	};
+
+	// an engine without any parts
+	AudioEngine();
+
+	// free every part (stopped first)
+	~AudioEngine();
+
+	// add a part playing an endpoint of the graph, returning its index (-1 once there are AUDIO_PARTS, UI thread only)
+	int addPart(AudioNode* output);
+
+	// add a part playing a snapshot shared with other engines (a loaded patch's, say), held for as long as the part plays it
+	int addPart(AudioGraphSnapshot* graph);
+
+	// number of parts played
+	inline int getNumParts() { return numParts.load(); };
+
+	// a part, for its keys to be played (the rendering thread only)
+	inline AudioPart* getPart(int part) { return parts[part]; };
+
+	// glide a parameter of a part to a new value as it plays (see AudioPart::Parameter), false if too many are queued (UI thread only)
+	inline bool setParameter(int part, int parameter, float value) { return parameterChanges.push(part, parameter, value); };
+
+	// take in parameter changes from midi controllers as well (before starting only)
+	void setControllerChanges(AudioParameterQueue* queue);
+
+	// set how many threads help mix the held notes (before starting only, 0 mixes them all on one thread)
+	void setVoiceThreads(int threads);
+
+	// set whether notes are pre-rendered in the background (before starting only, the output is the same either way)
+	void setNoteRendering(bool enabled);
+
+	// start the note renderer and the team
+	void start();
+
+	// stop them again (nothing may be rendering anymore)
+	void stop();
+
+	// render the next frame of every part into an interleaved frame, playing the sequence's events due within it (the rendering thread only, NULL skips it)
+	void renderFrame(float* out);
+
+	// play the next frame's events and move every key and parameter along exactly as rendering it would, without mixing anything
+	// (much faster than rendering, so a render can fast forward to a point partway through a sequence)
+	inline void skipFrame() { renderFrame(NULL); };
+
+	// copy where the engine is, or carry on from a copy of another's (between frames, the rendering thread only)
+	void saveState(State& state);
+	void loadState(const State& state);
+
+	// samples rendered so far
+	inline long long getClock() { return clock.load(); };
+
+	// play a sequence from the next frame rendered, taking it over and freeing the one it replaces (NULL stops, UI thread only)
+	void play(MidiSequencer* sequence);
+
+	// whether a sequence is playing and has events left
+	bool isPlaying();
+
+	// copy an endpoint's current buffers into a new snapshot of a part and hand it to the rendering thread (UI thread only)
+	void publishSnapshot(int part, AudioNode* output);
+
+	// free replaced snapshots no one is reading anymore (UI thread only)
+	void reclaimSnapshots();
+};
@@ -0,0 +1,30 @@
+#include "AudioParameterQueue.h"
+
+bool AudioParameterQueue::push(int part, int parameter, float value)
+{
+	// deliver errors
+	unsigned int count = pushed.load(std::memory_order_relaxed);
+	if (count - popped.load(std::memory_order_acquire) == CAPACITY)
+		return false;
+
+	// fill the slot before the popping thread can see it
+	Change& change = changes[count % CAPACITY];
+	change.part = part;
+	change.parameter = parameter;
+	change.value = value;
+	pushed.store(count + 1, std::memory_order_release);
+	return true;
+}
+
+bool AudioParameterQueue::pop(Change& change)
+{
+	// nothing queued
+	unsigned int count = popped.load(std::memory_order_relaxed);
+	if (count == pushed.load(std::memory_order_acquire))
+		return false;
+
+	// copy the slot out before the pushing thread may reuse it
+	change = changes[count % CAPACITY];
+	popped.store(count + 1, std::memory_order_release);
+	return true;
+}
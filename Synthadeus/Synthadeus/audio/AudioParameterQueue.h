@@ -0,0 +1,50 @@
+////////////////////////////////////////////////////////////////////////////////
+//                                                                            //
+//   Audio Parameter Queue                                                    //
+//   Everett Moser                                                            //
+//   10-18-26                                                                 //
+//                                                                            //
+//   Lock-free parameter changes from the UI thread to the audio thread       //
+//                                                                            //
+////////////////////////////////////////////////////////////////////////////////
+
+#pragma once
+
+#include "Error.h"
+
+#include <atomic>
+
+// one thread pushes and one thread pops, so neither ever waits on the other (a full queue drops the change)
+class AudioParameterQueue
+{
+public:
+
+	// a parameter of a part moving to a new value
+	struct Change
+	{
+		int part;
+		int parameter;
+		float value;
+	};
+
+private:
+
+	// changes in flight (a power of two, far more than the UI makes between two frames)
+	const static int CAPACITY = 256;
+	Change changes[CAPACITY];
+
+	// counts of changes pushed and popped (they only ever grow, wrapping around together)
+	std::atomic<unsigned int> pushed;
+	std::atomic<unsigned int> popped;
+
+public:
+
+	// an empty queue
+	inline AudioParameterQueue() : pushed(0), popped(0) { }
+
+	// queue a change, false if the queue is full (the pushing thread only)
+	bool push(int part, int parameter, float value);
+
+	// take the oldest change, false if there is none (the popping thread only)
+	bool pop(Change& change);
+};
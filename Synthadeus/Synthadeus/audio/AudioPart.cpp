@@ -0,0 +1,352 @@
+#include "AudioPart.h"
+#include <thread>
+#include <math.h>
+#include <string.h>
+
+// how far a parameter moves towards its target each sample
+static const float SMOOTHING_STEP = 1.f - expf(-1.f / (AUDIO_PARAMETER_SMOOTHING * AUDIO_SAMPLE_RATE));
+
+// close enough to the target to stop moving
+#define SMOOTHING_EPSILON 0.00001f
+
+const float AudioPart::parameterRanges[PARAMETERS][2] = { { 0.f, 1.f }, { -1.f, 1.f } };
+
+AudioPart::AudioPart(AudioGraphSnapshot* graph)
+	: snapshot(NULL), snapshotInUse(NULL), snapshotRendering(NULL), numRetired(0), snapshotVersion(0), renderedVersion(0), settled(false)
+{
+	// full volume, centered
+	targets[GAIN] = values[GAIN] = 1.f;
+	targets[PAN] = values[PAN] = 0.f;
+
+	// no key has been played yet
+	for (int i = 0; i < AUDIO_NOTE_COUNT; i++)
+	{
+		positions[i] = 0;
+		played[i] = 0;
+		velocities[i] = 1.f;
+		playCounts[i].store(0);
+		sources[i] = 0;
+		from[i] = 0;
+		to[i] = 0;
+	}
+
+	// something to play before the graph is first recalculated
+	publishSnapshot(graph);
+}
+
+AudioPart::~AudioPart()
+{
+	// no one is reading any of them anymore (here, at least)
+	for (int i = 0; i < numRetired; i++)
+		retired[i]->release();
+	snapshot.exchange(NULL)->release();
+}
+
+AudioGraphSnapshot* AudioPart::pin(std::atomic<AudioGraphSnapshot*>& slot)
+{
+	// pin the current snapshot so the UI thread leaves it alone, checking it wasn't replaced in between
+	AudioGraphSnapshot* graph;
+	do
+	{
+		graph = snapshot.load();
+		slot.store(graph);
+	} while (graph != snapshot.load());
+	return graph;
+}
+
+void AudioPart::publishSnapshot(AudioGraphSnapshot* graph)
+{
+	// swap the graph's output as it is now in for the playback
+	AudioGraphSnapshot* previous = snapshot.exchange(graph->acquire());
+	snapshotVersion++;
+	if (!previous)
+		return;
+
+	// the playback may still be reading the old one, so it waits its turn to be let go of
+	reclaimSnapshots();
+	while (numRetired == MAX_RETIRED)
+	{
+		std::this_thread::yield();
+		reclaimSnapshots();
+	}
+	retired[numRetired++] = previous;
+	reclaimSnapshots();
+}
+
+void AudioPart::reclaimSnapshots()
+{
+	// only the snapshots pinned by the playback or the renderer must stay (neither can pin a replaced one)
+	AudioGraphSnapshot* inUse = snapshotInUse.load();
+	AudioGraphSnapshot* rendering = snapshotRendering.load();
+	int kept = 0;
+	for (int i = 0; i < numRetired; i++)
+	{
+		if (retired[i] == inUse || retired[i] == rendering)
+			retired[kept++] = retired[i];
+		else
+			retired[i]->release();
+	}
+	numRetired = kept;
+}
+
+void AudioPart::setParameter(int parameter, float value)
+{
+	// idiot test
+	assert(parameter >= 0 && parameter < PARAMETERS);
+	targets[parameter] = value;
+}
+
+void AudioPart::smoothParameters()
+{
+	// the gains stay the same once every parameter has settled
+	bool moving = (values[GAIN] != targets[GAIN] || values[PAN] != targets[PAN]);
+	if (!moving && settled)
+		return;
+	settled = !moving;
+
+	for (int j = 0; j < AUDIO_FRAME_SIZE; j++)
+	{
+		// one-pole smoothing, snapping onto the target once close enough
+		for (int p = 0; p < PARAMETERS; p++)
+		{
+			values[p] += (targets[p] - values[p]) * SMOOTHING_STEP;
+			if (fabsf(targets[p] - values[p]) < SMOOTHING_EPSILON)
+				values[p] = targets[p];
+		}
+
+		// panning only ever turns the far channel down, so a centered part plays at full volume
+		gainL[j] = values[GAIN] * (values[PAN] > 0.f ? 1.f - values[PAN] : 1.f);
+		gainR[j] = values[GAIN] * (values[PAN] < 0.f ? 1.f + values[PAN] : 1.f);
+	}
+}
+
+void AudioPart::noteOn(int key, float velocity, int offset, Source source)
+{
+	// idiot test
+	assert(key >= 0 && key < AUDIO_NOTE_COUNT && offset >= 0 && offset < AUDIO_FRAME_SIZE);
+
+	// a key the other source already holds just keeps sounding, the same source pressing it again strikes it again
+	bool held = (sources[key] != 0);
+	bool again = (sources[key] & source) != 0;
+	sources[key] |= source;
+	if (held && !again)
+		return;
+
+	// the note starts on its sample (whatever it played earlier in the frame is cut), counted once as it goes down
+	positions[key] = 0;
+	played[key] = 0;
+	velocities[key] = velocity;
+	playCounts[key]++;
+	from[key] = offset;
+	to[key] = AUDIO_FRAME_SIZE;
+}
+
+void AudioPart::noteOff(int key, int offset, Source source)
+{
+	// idiot test
+	assert(key >= 0 && key < AUDIO_NOTE_COUNT && offset >= 0 && offset < AUDIO_FRAME_SIZE);
+
+	// the key only goes up once no source holds it
+	if (!(sources[key] & source))
+		return;
+	sources[key] &= ~source;
+	if (sources[key])
+		return;
+
+	// the note stops on its sample (if it started later in the frame than that, it never sounds)
+	if (offset < to[key])
+		to[key] = (offset > from[key] ? offset : from[key]);
+}
+
+void AudioPart::releaseAll(int offset, Source source)
+{
+	for (int i = 0; i < AUDIO_NOTE_COUNT; i++)
+		noteOff(i, offset, source);
+}
+
+int AudioPart::getSoundingKeys(int* keys)
+{
+	int count = 0;
+	for (int i = 0; i < AUDIO_NOTE_COUNT; i++)
+	{
+		if (to[i] > from[i])
+			keys[count++] = i;
+	}
+	return count;
+}
+
+void AudioPart::endFrame()
+{
+	for (int i = 0; i < AUDIO_NOTE_COUNT; i++)
+	{
+		// held keys sound for the whole of the next frame
+		if (sources[i])
+		{
+			from[i] = 0;
+			to[i] = AUDIO_FRAME_SIZE;
+			continue;
+		}
+
+		// reset the positions of the rest
+		positions[i] = 0;
+		played[i] = 0;
+		from[i] = 0;
+		to[i] = 0;
+	}
+}
+
+void AudioPart::saveState(State& state)
+{
+	memcpy(state.positions, positions, sizeof(positions));
+	memcpy(state.played, played, sizeof(played));
+	memcpy(state.velocities, velocities, sizeof(velocities));
+	memcpy(state.sources, sources, sizeof(sources));
+	memcpy(state.from, from, sizeof(from));
+	memcpy(state.to, to, sizeof(to));
+	memcpy(state.targets, targets, sizeof(targets));
+	memcpy(state.values, values, sizeof(values));
+}
+
+void AudioPart::loadState(const State& state)
+{
+	memcpy(positions, state.positions, sizeof(positions));
+	memcpy(played, state.played, sizeof(played));
+	memcpy(velocities, state.velocities, sizeof(velocities));
+	memcpy(sources, state.sources, sizeof(sources));
+	memcpy(from, state.from, sizeof(from));
+	memcpy(to, state.to, sizeof(to));
+	memcpy(targets, state.targets, sizeof(targets));
+	memcpy(values, state.values, sizeof(values));
+
+	// the gains left over belong to wherever the part was before
+	settled = false;
+}
+
+void AudioPart::mixNote(AudioGraphSnapshot* graph, int key, AudioPosition speed, int keysPressed, float* summed, float* leftSpan, float* rightSpan)
+{
+	// a mono graph only needs one channel interpolated, it is expanded to stereo here
+	bool mono = graph->isMono();
+
+	// positions are kept within the buffer by taking off whole loops of it, which doesn't move them at all
+	AudioPosition loop = (AudioPosition)graph->getBufferSize() << 32;
+	AudioPosition position = positions[key];
+
+	// each key is as loud as it was hit, sharing the output with the other keys held
+	float level = velocities[key] / (float)keysPressed;
+
+	// the samples of the frame the key sounds for (the whole frame, unless it went down or up partway through)
+	int first = from[key];
+	int last = to[key];
+	int length = last - first;
+
+	// a note rendered in the background only has to be mixed in
+	AudioGraphSnapshot::Note* note = graph->getNote(key);
+	if (note && played[key] + length <= note->length)
+	{
+		float* left = note->left + played[key];
+		float* right = (mono ? left : note->right + played[key]);
+		for (int j = 0; j < length; j++)
+		{
+			summed[2 * (first + j)] += right[j] * level * gainR[first + j];
+			summed[2 * (first + j) + 1] += left[j] * level * gainL[first + j];
+		}
+
+		// keep the position in step, in case the note outlasts what was rendered
+		played[key] += length;
+		positions[key] = played[key] * speed;
+		if (loop)
+			positions[key] %= loop;
+		return;
+	}
+
+	// decode every sample the key interpolates between at once, rather than one lookup per sample
+	int start = AUDIO_POSITION_SAMPLE(position);
+	int count = AUDIO_POSITION_SAMPLE(position + speed * (length - 1)) + 2 - start;
+	assert(count <= SPAN_SIZE);
+	graph->readL(start, count, leftSpan);
+	if (!mono)
+		graph->readR(start, count, rightSpan);
+
+	// signal summation algorithm
+	for (int j = 0; j < length; j++)
+	{
+		// interpolate within the span (each position is worked out on its own, so the loop vectorizes)
+		AudioPosition t = position + j * speed;
+		int lower = AUDIO_POSITION_SAMPLE(t) - start;
+		float deltaT = AUDIO_POSITION_FRACTION(t);
+		float sampleL = (leftSpan[lower] + (leftSpan[lower + 1] - leftSpan[lower]) * deltaT) * level;
+		float sampleR = (mono ? sampleL : (rightSpan[lower] + (rightSpan[lower + 1] - rightSpan[lower]) * deltaT) * level);
+		summed[2 * (first + j)] += sampleR * gainR[first + j];
+		summed[2 * (first + j) + 1] += sampleL * gainL[first + j];
+	}
+
+	// advance the positions
+	positions[key] = position + length * speed;
+	if (loop)
+		positions[key] %= loop;
+	played[key] += length;
+}
+
+void AudioPart::skipNote(AudioGraphSnapshot* graph, int key, AudioPosition speed)
+{
+	// the same steps mixing takes (whether the note was pre-rendered or not, the position ends up at played * speed within the loop)
+	AudioPosition loop = (AudioPosition)graph->getBufferSize() << 32;
+	int length = to[key] - from[key];
+	positions[key] += length * speed;
+	if (loop)
+		positions[key] %= loop;
+	played[key] += length;
+}
+
+void AudioPart::renderNotes(const AudioPosition* speeds, size_t budget, std::atomic<bool>& quit)
+{
+	// if another one is published while rendering this one, we come straight back
+	renderedVersion = snapshotVersion.load();
+
+	// pin the snapshot, the same way the playback does
+	AudioGraphSnapshot* graph = pin(snapshotRendering);
+
+	// order the keys by how often they were played (insertion sort, it's only a few keys)
+	int order[AUDIO_NOTE_COUNT];
+	unsigned int counts[AUDIO_NOTE_COUNT];
+	for (int i = 0; i < AUDIO_NOTE_COUNT; i++)
+	{
+		unsigned int count = playCounts[i].load();
+		int j = i;
+		for (; j > 0 && counts[j - 1] < count; j--)
+		{
+			order[j] = order[j - 1];
+			counts[j] = counts[j - 1];
+		}
+		order[j] = i;
+		counts[j] = count;
+	}
+
+	// a silent graph has nothing worth rendering
+	if (graph->isSilent())
+	{
+		snapshotRendering.store(NULL);
+		return;
+	}
+
+	// render the notes in that order until the budget runs out
+	size_t bytes = graph->bytesForNote(AUDIO_NOTE_RENDER_LENGTH);
+	size_t used = 0;
+	for (int i = 0; i < AUDIO_NOTE_COUNT && used + bytes <= budget; i++)
+	{
+		// give up on this snapshot if it was already replaced
+		if (quit.load() || graph != snapshot.load())
+			break;
+
+		// keys rendered on an earlier pass over this snapshot are kept
+		if (!graph->getNote(order[i]))
+			graph->setNote(order[i], graph->renderNote(speeds[order[i]], AUDIO_NOTE_RENDER_LENGTH));
+		used += bytes;
+	}
+
+	// let go of it
+	snapshotRendering.store(NULL);
+}
+
+// macro cleanup
+#undef SMOOTHING_EPSILON
@@ -0,0 +1,170 @@
+////////////////////////////////////////////////////////////////////////////////
+//                                                                            //
+//   Audio Part                                                               //
+//   Everett Moser                                                            //
+//   10-18-26                                                                 //
+//                                                                            //
+//   One multi-timbral part, an output's graph played from one midi channel   //
+//                                                                            //
+////////////////////////////////////////////////////////////////////////////////
+
+#pragma once
+
+#include "Error.h"
+#include "AudioDefines.h"
+#include "AudioGraphSnapshot.h"
+
+#include <atomic>
+#include <stddef.h>
+
+// the UI thread publishes snapshots of the part's graph, the engine plays them as its keys go down and up,
+// and the note renderer pre-renders notes from them (each on their own thread, see AudioEngine)
+class AudioNode;
+class AudioPart
+{
+public:
+
+	// parameters of the part that glide to new values while playing, without recalculating the graph
+	enum Parameter { GAIN, PAN, PARAMETERS };
+
+	// what holds a key down (a key sounds while either does, so a sequence plays along with the piano)
+	enum Source { LIVE = 1, SEQUENCE = 2 };
+
+	// where every key and parameter of a part is between frames, so another part playing the same snapshot can carry on
+	// from there (see AudioEngine::State)
+	struct State
+	{
+		AudioPosition positions[AUDIO_NOTE_COUNT];
+		int played[AUDIO_NOTE_COUNT];
+		float velocities[AUDIO_NOTE_COUNT];
+		unsigned char sources[AUDIO_NOTE_COUNT];
+		int from[AUDIO_NOTE_COUNT];
+		int to[AUDIO_NOTE_COUNT];
+		float targets[PARAMETERS];
+		float values[PARAMETERS];
+	};
+
+private:
+	// the graph the playback plays, swapped whole whenever the graph changes
+	std::atomic<AudioGraphSnapshot*> snapshot;
+
+	// the snapshot the playback is reading right now (NULL between frames)
+	std::atomic<AudioGraphSnapshot*> snapshotInUse;
+
+	// the snapshot the note renderer is reading right now (NULL while it sleeps)
+	std::atomic<AudioGraphSnapshot*> snapshotRendering;
+
+	// replaced snapshots waiting to be let go of once the playback is done with them
+	const static int MAX_RETIRED = 8;
+	AudioGraphSnapshot* retired[MAX_RETIRED];
+	int numRetired;
+
+	// counts the snapshots published, so the renderer can tell when there is a new one
+	std::atomic<unsigned int> snapshotVersion;
+
+	// the version the note renderer last rendered (only it touches this)
+	unsigned int renderedVersion;
+
+	// how often each key was played, so the most played notes are rendered first
+	std::atomic<unsigned int> playCounts[AUDIO_NOTE_COUNT];
+
+	// samples each key has played since it went down
+	int played[AUDIO_NOTE_COUNT];
+
+	// the velocity each key went down with (0 to 1)
+	float velocities[AUDIO_NOTE_COUNT];
+
+	// positions of playback (fixed point, see AudioPosition)
+	AudioPosition positions[AUDIO_NOTE_COUNT];
+
+	// the sources holding each key down
+	unsigned char sources[AUDIO_NOTE_COUNT];
+
+	// the samples of the frame being mixed each key sounds for, from the first up to the last (the same when it is silent)
+	// (keys go down and up partway through a frame, so notes start and stop on the very sample they are due)
+	int from[AUDIO_NOTE_COUNT];
+	int to[AUDIO_NOTE_COUNT];
+
+	// where each parameter is heading, and where it is now (the rendering thread only)
+	float targets[PARAMETERS];
+	float values[PARAMETERS];
+
+	// the gain of each channel for every sample of the frame being mixed
+	float gainL[AUDIO_FRAME_SIZE];
+	float gainR[AUDIO_FRAME_SIZE];
+
+	// whether the gains were last worked out with every parameter on its target (so they are constant)
+	bool settled;
+
+	// the lowest and highest value of each parameter (gain from silent to full, pan from left to right)
+	static const float parameterRanges[PARAMETERS][2];
+
+	// pin the current snapshot into a slot, checking it wasn't replaced in between
+	AudioGraphSnapshot* pin(std::atomic<AudioGraphSnapshot*>& slot);
+
+public:
+
+	// enough samples for the highest key to interpolate a whole frame from (it plays ~60x faster than the tune note)
+	const static int SPAN_SIZE = AUDIO_FRAME_SIZE * 64;
+
+	// create a part playing a snapshot of an endpoint in the graph, held alongside whoever else holds it
+	AudioPart(AudioGraphSnapshot* graph);
+
+	// let go of every snapshot (nothing may be playing or rendering the part anymore)
+	~AudioPart();
+
+	// hand a new snapshot of the endpoint to the playback, holding it alongside whoever else holds it (UI thread only)
+	void publishSnapshot(AudioGraphSnapshot* graph);
+
+	// let go of replaced snapshots no one is reading anymore (UI thread only)
+	void reclaimSnapshots();
+
+	// pin the current snapshot while playing a frame from it, then let go (playback only)
+	inline AudioGraphSnapshot* pinPlaying() { return pin(snapshotInUse); };
+	inline void unpinPlaying() { snapshotInUse.store(NULL); };
+
+	// the range a parameter may be set across (for mapping controllers)
+	inline static float getParameterMinimum(int parameter) { assert(parameter >= 0 && parameter < PARAMETERS); return parameterRanges[parameter][0]; };
+	inline static float getParameterMaximum(int parameter) { assert(parameter >= 0 && parameter < PARAMETERS); return parameterRanges[parameter][1]; };
+
+	// send a parameter gliding towards a new value (the rendering thread only, see AudioEngine::setParameter)
+	void setParameter(int parameter, float value);
+
+	// work out the gains of the next frame, taking every parameter a step closer to its target each sample (before mixing it)
+	void smoothParameters();
+
+	// a source presses a key a number of samples into the frame about to be mixed, with a velocity (0 to 1, the rendering thread only)
+	void noteOn(int key, float velocity, int offset, Source source);
+
+	// a source lets go of a key a number of samples into the frame about to be mixed (the rendering thread only)
+	void noteOff(int key, int offset, Source source);
+
+	// a source lets go of every key it holds
+	void releaseAll(int offset, Source source);
+
+	// whether a source holds a key down
+	inline bool isHeld(int key, Source source) { return (sources[key] & source) != 0; };
+
+	// fill in the keys sounding for any of the frame about to be mixed, returning how many there are
+	int getSoundingKeys(int* keys);
+
+	// mix a sounding key's share of the frame into an interleaved frame, interpolating within the spans (keys are independent, so threads may mix different keys at once)
+	void mixNote(AudioGraphSnapshot* graph, int key, AudioPosition speed, int keysPressed, float* summed, float* leftSpan, float* rightSpan);
+
+	// move a sounding key along its share of the frame to where mixing it would have, without mixing it
+	void skipNote(AudioGraphSnapshot* graph, int key, AudioPosition speed);
+
+	// done mixing the frame, reset the keys let go of (held keys sound for the whole of the next)
+	void endFrame();
+
+	// copy where the keys and parameters are, or carry on from a copy (between frames, the rendering thread only)
+	// (the gains are worked out again from the parameters on the next frame, which comes out the same)
+	void saveState(State& state);
+	void loadState(const State& state);
+
+	// whether a snapshot was published since the notes were last rendered
+	inline bool needsNotes() { return snapshotVersion.load() != renderedVersion; };
+
+	// render the most played notes from the current snapshot within a budget, giving up once it is replaced or quit is set (note renderer only)
+	void renderNotes(const AudioPosition* speeds, size_t budget, std::atomic<bool>& quit);
+};
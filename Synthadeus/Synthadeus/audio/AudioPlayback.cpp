@@ -1,25 +1,102 @@
 #include "AudioPlayback.h"
 #include "AudioOutputNode.h"
 #include "MidiInterface.h"
+#include <string.h>
+#include <chrono>
 
 AudioPlayback::AudioPlayback(AudioOutputNode* outputNode, InputDevice::Piano* virtualPiano)
-	: initialized(false)
+	: initialized(false), lookaheadWritten(0), lookaheadRead(0), lookahead(AUDIO_LOOKAHEAD_BLOCKS), lookaheadQuit(false), underruns(0)
 {
-	// initialize piano, output node and stream
-	vPiano = virtualPiano;
-	node = outputNode;
+	// initialize the stream
 	stream = NULL;
 
-	// initialize all the positions and speeds of note playback
-	for (int i = 0; i < InputDevice::Piano::TOTAL_KEYS; i++)
+	// the team helps on every core but the ones the callback and the UI run on (at least one on a machine with two)
+	int cores = (int)std::thread::hardware_concurrency();
+	int threads = cores - 2;
+	threads = (cores < 2 ? 0 : (threads < 1 ? 1 : (threads > AudioEngine::MAX_VOICE_THREADS ? AudioEngine::MAX_VOICE_THREADS : threads)));
+	engine.setVoiceThreads(threads);
+
+	// the first part plays the output node from the virtual piano
+	addPart(outputNode, virtualPiano);
+}
+
+int AudioPlayback::addPart(AudioOutputNode* outputNode, InputDevice::Piano* partPiano)
+{
+	// the piano is in place before the engine has the part
+	int index = engine.getNumParts();
+	if (index == AUDIO_PARTS)
+		return -1;
+	endpoints[index] = outputNode;
+	pianos[index] = partPiano;
+	return engine.addPart(outputNode->getAudioNode());
+}
+
+void AudioPlayback::setLookahead(int blocks)
+{
+	// idiot test
+	assert(blocks >= 0 && blocks <= MAX_LOOKAHEAD_BLOCKS);
+	if (!initialized)
 	{
-		positions[i] = 0.f;
-		speeds[i] = getFrequencyForNote(i) / AUDIO_TUNE_FREQUENCY;
+		// the renderer starts with it
+		lookahead = blocks;
+		return;
 	}
+
+	// stop the stream while the renderer is swapped, so no frame is rendered by two threads (a moment of silence)
+	Pa_StopStream(stream);
+	stopLookahead();
+	lookahead = blocks;
+	startLookahead();
+	Pa_StartStream(stream);
+}
+
+void AudioPlayback::startLookahead()
+{
+	// the ring starts empty, and the underruns are counted for this depth alone
+	lookaheadWritten.store(0);
+	lookaheadRead.store(0);
+	underruns.store(0);
+	lookaheadQuit.store(false);
+
+	// the renderer fills the ring before the stream starts asking for it
+	if (lookahead > 0)
+		lookaheadRenderer = std::thread(renderLookahead, this);
+}
+
+void AudioPlayback::stopLookahead()
+{
+	// wake the renderer to quit, and wait for it
+	{
+		std::lock_guard<std::mutex> lock(lookaheadMutex);
+		lookaheadQuit.store(true);
+	}
+	lookaheadWake.notify_one();
+	if (lookaheadRenderer.joinable())
+		lookaheadRenderer.join();
+}
+
+void AudioPlayback::setControllerChanges(AudioParameterQueue* queue)
+{
+	// the callback would already be reading it once initialized
+	assert(!initialized);
+	engine.setControllerChanges(queue);
+}
+
+void AudioPlayback::setVoiceThreads(int threads)
+{
+	// the team is already running once initialized
+	assert(!initialized);
+	engine.setVoiceThreads(threads);
 }
 
 bool AudioPlayback::initialize()
 {
+	// start rendering notes in the background, and the team helping to mix them
+	engine.start();
+
+	// start rendering ahead of the callback, which fills the ring before the stream starts asking for it
+	startLookahead();
+
 	// initialize port audio
 	Pa_Initialize();
 
@@ -40,14 +117,14 @@ bool AudioPlayback::initialize()
 
 	// fill out the stream parameters
 	PaStreamParameters params;
-	params.channelCount = 2;
+	params.channelCount = AUDIO_CHANNELS;
 	params.device = AUDIO_DEVICE;
 	params.sampleFormat = paFloat32;
 	params.suggestedLatency = Pa_GetDeviceInfo(params.device)->defaultLowOutputLatency;
 	params.hostApiSpecificStreamInfo = &asioInfo;
 
 	// can we open the stream?
-	err = Pa_OpenStream(&stream, NULL, &params, 44100, 64, paClipOff, AudioPlayback::AudioCallback, this);
+	err = Pa_OpenStream(&stream, NULL, &params, AUDIO_SAMPLE_RATE, AUDIO_FRAME_SIZE, paClipOff, AudioPlayback::AudioCallback, this);
 	
 	// if not, get the default one
 	if (err != paNoError) {
@@ -87,6 +164,16 @@ bool AudioPlayback::deinitialize()
 	// terminate port audio 
 	Pa_Terminate();
 
+	// stop the lookahead renderer
+	stopLookahead();
+
+	// stop the note renderer and the team
+	engine.stop();
+
+	// let the user know if it couldn't keep up
+	if (underruns.load() > 0)
+		DebugPrintf("  [AUDIO] The lookahead ran dry %u times.\n", underruns.load());
+
 	// success!
 	return true;
 }
@@ -102,66 +189,85 @@ int AudioPlayback::AudioCallback(const void* inputBuffer, void* outputBuffer, un
 	// resolve the identity crisis
 	AudioPlayback* myself = (AudioPlayback*)userdata;
 
-	// we are using the piano within a thread, so make us threadsafe
-	EnterCriticalSection(&myself->vPiano->pianoCriticalSection);
-
-	// calculate the new output signals
-	myself->updatePositions();
-	myself->calculateSummedSignal();
+	// render the frame right here
+	if (myself->lookahead == 0)
+	{
+		myself->renderFrame(out);
+		return 0;
+	}
 
-	// fill the output buffers
-	for (unsigned int i = 0; i < framesPerBuffer; i++)
+	// otherwise copy out the oldest frame rendered ahead, or play silence if the renderer fell behind
+	unsigned int read = myself->lookaheadRead.load(std::memory_order_relaxed);
+	if (read == myself->lookaheadWritten.load(std::memory_order_acquire))
+	{
+		myself->underruns.fetch_add(1, std::memory_order_relaxed);
+		memset(out, 0, sizeof(float) * AUDIO_FRAME_SIZE * 2);
+	}
+	else
 	{
-		*out++ = myself->summedSignal[2 * i];
-		*out++ = myself->summedSignal[2 * i + 1];
+		memcpy(out, myself->lookaheadRing[read % MAX_LOOKAHEAD_BLOCKS], sizeof(float) * AUDIO_FRAME_SIZE * 2);
+		myself->lookaheadRead.store(read + 1, std::memory_order_release);
 	}
 
-	// we are done with the piano
-	LeaveCriticalSection(&myself->vPiano->pianoCriticalSection);
+	// wake the renderer to replace it (without the lock, a missed wake only costs it until its timeout)
+	myself->lookaheadWake.notify_one();
 
 	// exit success!
 	return 0;
 }
 
-void AudioPlayback::updatePositions()
+void AudioPlayback::renderFrame(float* out)
 {
-	// iterate through keys
-	for (int i = 0; i < InputDevice::Piano::TOTAL_KEYS; i++)
+	// press and release the parts' keys as the pianos last published them (never waiting on the input thread's lock)
+	int partCount = engine.getNumParts();
+	for (int p = 0; p < partCount; p++)
 	{
-		// check the piano's keystate
-		if (vPiano->keys[MidiInterface::getOctaveValue(i)][MidiInterface::getNoteValue(i)].check())
+		AudioPart* part = engine.getPart(p);
+		InputDevice::Piano* piano = pianos[p];
+		for (int w = 0; w < InputDevice::Piano::HELD_WORDS; w++)
 		{
-			// advance the positions
-			positions[i] += speeds[i];
-		}
-		else
-		{
-			// reset the positions
-			positions[i] = 0.f;
+			unsigned long long held = piano->getHeldKeys(w);
+			for (int i = w * 64; i < (w + 1) * 64 && i < InputDevice::Piano::TOTAL_KEYS; i++)
+			{
+				// keys only go down once, however long they are held
+				bool down = ((held >> (i % 64)) & 1ULL) != 0;
+				if (down && !part->isHeld(i, AudioPart::LIVE))
+					part->noteOn(i, piano->getHeldVelocity(i), 0, AudioPart::LIVE);
+				else if (!down)
+					part->noteOff(i, 0, AudioPart::LIVE);
+			}
 		}
 	}
-}
 
+	// mix them, along with the sequence
+	engine.renderFrame(out);
+}
 
-void AudioPlayback::calculateSummedSignal()
+void AudioPlayback::renderLookahead(AudioPlayback* myself)
 {
-	// calculate each sample
-	for (int j = 0; j < AUDIO_FRAME_SIZE; j++)
-	{
-		// initialize to 0.f
-		summedSignal[2 * j] = 0.f;
-		summedSignal[2 * j + 1] = 0.f;
+	// a frame's worth of time, the longest the renderer sleeps when no wake comes
+	const std::chrono::microseconds frameTime(1000000LL * AUDIO_FRAME_SIZE / AUDIO_SAMPLE_RATE);
 
-		// determine all of the keys pressed
-		for (int i = 0; i < vPiano->getNumKeysPressed(); i++)
+	while (!myself->lookaheadQuit.load())
+	{
+		// render until we are the full lookahead ahead of the callback (only we write, so our count is exact)
+		unsigned int written = myself->lookaheadWritten.load(std::memory_order_relaxed);
+		while (written - myself->lookaheadRead.load(std::memory_order_acquire) < (unsigned int)myself->lookahead)
 		{
-			// signal summation algorithm
-			int currentNote = vPiano->getKey(i);
-			summedSignal[2 * j] += node->getAudioNode()->lerpValueR(positions[currentNote]) / (float)vPiano->getNumKeysPressed();
-			summedSignal[2 * j + 1] += node->getAudioNode()->lerpValueL(positions[currentNote]) / (float)vPiano->getNumKeysPressed();
-			
-			// advance the positions
-			positions[currentNote] += speeds[currentNote];
+			myself->renderFrame(myself->lookaheadRing[written % MAX_LOOKAHEAD_BLOCKS]);
+			myself->lookaheadWritten.store(++written, std::memory_order_release);
 		}
+
+		// sleep until the callback takes a frame
+		std::unique_lock<std::mutex> lock(myself->lookaheadMutex);
+		if (!myself->lookaheadQuit.load() && written - myself->lookaheadRead.load() >= (unsigned int)myself->lookahead)
+			myself->lookaheadWake.wait_for(lock, frameTime);
 	}
-}
\ No newline at end of file
+}
+
+void AudioPlayback::publishSnapshots()
+{
+	// copy every part's graph as it is now, and swap it in for the callback
+	for (int i = 0; i < engine.getNumParts(); i++)
+		engine.publishSnapshot(i, endpoints[i]->getAudioNode());
+}
@@ -15,8 +15,13 @@
 
 #include "Error.h"
 #include "InputDevice.h"
-#include "CFMaths.h"
 #include "AudioDefines.h"
+#include "AudioEngine.h"
+
+#include <atomic>
+#include <thread>
+#include <mutex>
+#include <condition_variable>
 
 // we need portaudio
 #pragma comment(lib, "portaudio_x86.lib")
@@ -28,11 +33,42 @@ class AudioOutputNode;
 class AudioPlayback
 {
 private:
-	// the audio endpoint in the graph
-	AudioOutputNode* node;
+	// mixes the parts (the playback only feeds it the pianos and drives it from the stream)
+	AudioEngine engine;
+
+	// each part's endpoint in the graph, and the piano playing it
+	AudioOutputNode* endpoints[AUDIO_PARTS];
+	InputDevice::Piano* pianos[AUDIO_PARTS];
+	static_assert(InputDevice::Piano::TOTAL_KEYS == AUDIO_NOTE_COUNT, "Error, every piano key needs a note slot. ");
+
+	// frames rendered ahead of the callback, which only copies them out when looking ahead (single producer, single consumer)
+	const static int MAX_LOOKAHEAD_BLOCKS = 64;
+	static_assert(AUDIO_LOOKAHEAD_BLOCKS >= 0 && AUDIO_LOOKAHEAD_BLOCKS <= MAX_LOOKAHEAD_BLOCKS, "Error, the lookahead doesn't fit the ring. ");
+	float lookaheadRing[MAX_LOOKAHEAD_BLOCKS][AUDIO_FRAME_SIZE * 2];
+	std::atomic<unsigned int> lookaheadWritten;
+	std::atomic<unsigned int> lookaheadRead;
+
+	// blocks to stay ahead by (0 renders in the callback instead)
+	int lookahead;
+
+	// renders the ring full again whenever the callback takes a frame
+	std::thread lookaheadRenderer;
+	std::mutex lookaheadMutex;
+	std::condition_variable lookaheadWake;
+	std::atomic<bool> lookaheadQuit;
+
+	// callbacks which found the ring empty and played silence
+	std::atomic<unsigned int> underruns;
 
-	// reference to the virtual piano
-	InputDevice::Piano* vPiano;
+	// the lookahead renderer's thread
+	static void renderLookahead(AudioPlayback* myself);
+
+	// start the renderer for the lookahead set (none for 0) on an empty ring, or stop it (the stream must not be running)
+	void startLookahead();
+	void stopLookahead();
+
+	// render the next frame of every part into an interleaved frame, from the pianos as they are now (called by whichever thread renders)
+	void renderFrame(float* out);
 
 	// the audio stream to play data from
 	PaStream* stream;
@@ -40,36 +76,57 @@ private:
 	// are we ready to play audio?
 	bool initialized;
 
-	// tuned for C5 to be 440 Hz (see audio defines)
-	inline float getFrequencyForNote(int note) { return AUDIO_TUNE_FREQUENCY * fpowf(1.0594631f, (note - AUDIO_TUNE_NOTE)); };
-
-	// positions and speeds of playback
-	float positions[InputDevice::Piano::TOTAL_KEYS];
-	float speeds[InputDevice::Piano::TOTAL_KEYS];
-
-	// holds both left and right audio
-	float summedSignal[AUDIO_FRAME_SIZE * 2];
-
 public:
 	
-	// create us with a link to the endpoint and a virtual piano
+	// create us with a link to the endpoint and a virtual piano (the first part)
 	AudioPlayback(AudioOutputNode* outputNode, InputDevice::Piano* virtualPiano);
 
+	// add a part playing another endpoint from another piano, returning its index (-1 once there are AUDIO_PARTS, UI thread only)
+	int addPart(AudioOutputNode* outputNode, InputDevice::Piano* partPiano);
+
+	// number of parts played
+	inline int getNumParts() { return engine.getNumParts(); };
+
+	// glide a parameter of a part to a new value as it plays (see AudioPart::Parameter), false if too many are queued (UI thread only)
+	inline bool setParameter(int part, int parameter, float value) { return engine.setParameter(part, parameter, value); };
+
+	// play a sequence along with the pianos, taking it over (NULL stops, UI thread only)
+	inline void play(MidiSequencer* sequence) { engine.play(sequence); };
+
+	// whether a sequence is playing and has events left
+	inline bool isPlaying() { return engine.isPlaying(); };
+
 	// initialize the audio playback mechanism
 	bool initialize();
 
 	// deinitialize the audio playback mechanism
 	bool deinitialize();
 
+	// set how many blocks to render ahead of the callback (0 renders in the callback, UI thread only)
+	// (while playing, the stream stops for a moment as the renderer is swapped)
+	void setLookahead(int blocks);
+
+	// blocks rendered ahead of the callback
+	inline int getLookahead() { return lookahead; };
+
+	// take in parameter changes from midi controllers as well (before initializing only)
+	void setControllerChanges(AudioParameterQueue* queue);
+
+	// set how many threads help mix the held notes (before initializing only, 0 mixes them all on one thread, one for every core but two by default)
+	void setVoiceThreads(int threads);
+
+	// number of callbacks the lookahead couldn't keep up with since it was last set
+	inline unsigned int getUnderruns() { return underruns.load(); };
+
 	// check wether we have been initialized or not
 	inline bool isInitialized() { return initialized; };
 
 	// callback so we can feed the driver more audio data
 	static int AudioCallback(const void* inputBuffer, void* outputBuffer, unsigned long framesPerBuffer, const PaStreamCallbackTimeInfo* timeInfo, PaStreamCallbackFlags statusFlags, void* userdata);
-	
-	// update the positions relative to the speeds
-	void updatePositions();
 
-	// calculate the fed signal for multiple keys pressed at once
-	void calculateSummedSignal();
-};
\ No newline at end of file
+	// copy every part's output node's current buffers into new snapshots and hand them to the callback (UI thread only)
+	void publishSnapshots();
+
+	// free replaced snapshots no callback is reading anymore (UI thread only)
+	inline void reclaimSnapshots() { engine.reclaimSnapshots(); };
+};
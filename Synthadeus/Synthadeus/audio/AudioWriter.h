@@ -0,0 +1,43 @@
+////////////////////////////////////////////////////////////////////////////////
+//                                                                            //
+//   Audio Writer                                                             //
+//   Everett Moser                                                            //
+//   10-18-26                                                                 //
+//                                                                            //
+//   The files rendered frames can be streamed to, whatever their kind        //
+//                                                                            //
+////////////////////////////////////////////////////////////////////////////////
+
+#pragma once
+
+#include "Error.h"
+#include "AudioDefines.h"
+
+// a writer takes interleaved float frames as they are rendered and streams them to a file of its kind, so whatever
+// exports or renders doesn't care whether the samples end up in a wave file or compressed
+class AudioWriter
+{
+public:
+
+	// the sample formats written (not every kind of file takes every one)
+	enum Format { PCM16, PCM24, PCM32, FLOAT32, FORMATS };
+
+	// bytes each sample of a format takes
+	inline static int bytesFor(Format sampleFormat) { return (sampleFormat == PCM16 ? 2 : (sampleFormat == PCM24 ? 3 : 4)); }
+
+	// close the file if it is still open
+	virtual ~AudioWriter() {}
+
+	// create a file of frames at a sample rate and write its header (false if it can't be created, or can't hold the format)
+	virtual bool open(const char* path, int channelCount = AUDIO_CHANNELS, Format sampleFormat = PCM16, bool dithered = false,
+		int sampleRate = AUDIO_SAMPLE_RATE) = 0;
+
+	// append interleaved frames, clipped to the format (false if the file couldn't take them)
+	virtual bool write(const float* samples, int frames) = 0;
+
+	// finish the file and close it (false if it couldn't be finished)
+	virtual bool close() = 0;
+
+	// frames written so far
+	virtual long long getFramesWritten() = 0;
+};
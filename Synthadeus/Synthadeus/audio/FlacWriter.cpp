@@ -0,0 +1,970 @@
+#include "FlacWriter.h"
+#include <math.h>
+#include <string.h>
+#include <ctype.h>
+
+// the most coefficients a fixed polynomial or an LPC fit may have, and the most partitions a residual is split into (as a power of 2)
+#define FLAC_MAX_FIXED_ORDER 4
+#define FLAC_MAX_LPC_ORDER 8
+#define FLAC_MAX_PARTITION_ORDER 8
+
+// the largest Rice parameter (5 bit parameters go to 30, 31 would mean the partition is stored raw)
+#define FLAC_MAX_RICE_PARAMETER 30
+
+// how a subframe codes its channel
+enum { SUBFRAME_CONSTANT, SUBFRAME_VERBATIM, SUBFRAME_FIXED, SUBFRAME_LPC };
+
+// the way a channel of a block was chosen to be coded, and the bits it takes
+struct FlacSubframe
+{
+	int type;
+	int order;
+
+	// quantized LPC coefficients, their precision in bits and the shift the prediction is scaled down by
+	int coefficients[FLAC_MAX_LPC_ORDER];
+	int precision;
+	int shift;
+
+	// the residual's partitions and the Rice parameter of each (wide when any needs 5 bits)
+	int partitionOrder;
+	int parameters[1 << FLAC_MAX_PARTITION_ORDER];
+	bool wide;
+
+	long long bits;
+};
+
+struct FlacWorkspace
+{
+	// the channels of a block as they may be coded (left, right, side, mid), the residual of each and how it was coded
+	int signals[4][FLAC_BLOCK_SIZE];
+	int residuals[4][FLAC_BLOCK_SIZE];
+	FlacSubframe subframes[4];
+
+	// a prediction being tried, and how it is coded
+	int trial[FLAC_BLOCK_SIZE];
+	FlacSubframe candidate;
+
+	// the samples windowed for fitting LPC coefficients, and the window (for the block size it was made for)
+	double windowed[FLAC_BLOCK_SIZE];
+	double window[FLAC_BLOCK_SIZE];
+	int windowSize;
+
+	// zigzagged residual sums of each partition
+	unsigned long long sums[1 << FLAC_MAX_PARTITION_ORDER];
+};
+
+// the CRCs every frame carries, 8 bits over its header and 16 over all of it (polynomials 0x07 and 0x8005)
+struct FlacCrcTables
+{
+	unsigned char crc8[256];
+	unsigned short crc16[256];
+	FlacCrcTables()
+	{
+		for (int i = 0; i < 256; i++)
+		{
+			unsigned int c8 = i;
+			unsigned int c16 = i << 8;
+			for (int j = 0; j < 8; j++)
+			{
+				c8 = (c8 & 0x80 ? (c8 << 1) ^ 0x07 : c8 << 1);
+				c16 = (c16 & 0x8000 ? (c16 << 1) ^ 0x8005 : c16 << 1);
+			}
+			crc8[i] = (unsigned char)c8;
+			crc16[i] = (unsigned short)c16;
+		}
+	}
+};
+static const FlacCrcTables crcTables;
+
+// the sample rates a frame header has a code for (anything else is read from the stream info)
+static const int rateCodes[][2] = { { 88200, 1 }, { 176400, 2 }, { 192000, 3 }, { 8000, 4 }, { 16000, 5 }, { 22050, 6 },
+	{ 24000, 7 }, { 32000, 8 }, { 44100, 9 }, { 48000, 10 }, { 96000, 11 } };
+
+// the per round constants and shifts of MD5
+static const unsigned int md5Constants[64] = {
+	0xd76aa478, 0xe8c7b756, 0x242070db, 0xc1bdceee, 0xf57c0faf, 0x4787c62a, 0xa8304613, 0xfd469501,
+	0x698098d8, 0x8b44f7af, 0xffff5bb1, 0x895cd7be, 0x6b901122, 0xfd987193, 0xa679438e, 0x49b40821,
+	0xf61e2562, 0xc040b340, 0x265e5a51, 0xe9b6c7aa, 0xd62f105d, 0x02441453, 0xd8a1e681, 0xe7d3fbc8,
+	0x21e1cde6, 0xc33707d6, 0xf4d50d87, 0x455a14ed, 0xa9e3e905, 0xfcefa3f8, 0x676f02d9, 0x8d2a4c8a,
+	0xfffa3942, 0x8771f681, 0x6d9d6122, 0xfde5380c, 0xa4beea44, 0x4bdecfa9, 0xf6bb4b60, 0xbebfbc70,
+	0x289b7ec6, 0xeaa127fa, 0xd4ef3085, 0x04881d05, 0xd9d4d039, 0xe6db99e5, 0x1fa27cf8, 0xc4ac5665,
+	0xf4292244, 0x432aff97, 0xab9423a7, 0xfc93a039, 0x655b59c3, 0x8f0ccc92, 0xffeff47d, 0x85845dd1,
+	0x6fa87e4f, 0xfe2ce6e0, 0xa3014314, 0x4e0811a1, 0xf7537e82, 0xbd3af235, 0x2ad7d2bb, 0xeb86d391 };
+static const int md5Shifts[16] = { 7, 12, 17, 22, 5, 9, 14, 20, 4, 11, 16, 23, 6, 10, 15, 21 };
+
+// packs bits most significant first, as everything in a FLAC stream is
+struct FlacBitWriter
+{
+	unsigned char* out;
+	int bytes;
+	unsigned long long accumulator;
+	int pending;
+
+	inline FlacBitWriter(unsigned char* buffer) : out(buffer), bytes(0), accumulator(0), pending(0) {}
+
+	// the low bits of a value (up to 32)
+	inline void put(unsigned int value, int count)
+	{
+		accumulator = (accumulator << count) | ((unsigned long long)value & ((1ULL << count) - 1));
+		pending += count;
+		while (pending >= 8)
+		{
+			pending -= 8;
+			out[bytes++] = (unsigned char)(accumulator >> pending);
+		}
+	}
+
+	// a zigzagged value Rice coded with a parameter: the high part in unary (zeros ended by a one), then the low bits
+	inline void putRice(unsigned int value, int parameter)
+	{
+		unsigned int high = value >> parameter;
+		if (high + 1 + parameter <= 32)
+		{
+			put((1u << parameter) | (value & ((1u << parameter) - 1)), high + 1 + parameter);
+			return;
+		}
+		for (; high >= 16; high -= 16)
+			put(0, 16);
+		put(1, high + 1);
+		put(value, parameter);
+	}
+
+	// zeros up to the next byte
+	inline void align()
+	{
+		if (pending > 0)
+			put(0, 8 - pending);
+	}
+};
+
+// residuals are zigzagged so small values either side of zero code small
+static inline unsigned int zigzag(int value)
+{
+	return ((unsigned int)value << 1) ^ (unsigned int)(value >> 31);
+}
+
+// the Rice parameter a partition of zigzagged values is cheapest with, and about how many bits that takes
+static inline int chooseParameter(unsigned long long sum, int count, long long& bits)
+{
+	if (count <= 0)
+	{
+		bits = 0;
+		return 0;
+	}
+
+	// near the log of the mean, so only its neighbours are worth trying
+	int guess = 0;
+	while (guess < FLAC_MAX_RICE_PARAMETER && ((unsigned long long)count << (guess + 1)) <= sum)
+		guess++;
+	int best = guess;
+	bits = -1;
+	for (int k = (guess > 0 ? guess - 1 : 0); k <= guess + 1 && k <= FLAC_MAX_RICE_PARAMETER; k++)
+	{
+		long long cost = (long long)count * (k + 1) + (long long)(sum >> k);
+		if (bits < 0 || cost < bits)
+		{
+			bits = cost;
+			best = k;
+		}
+	}
+	return best;
+}
+
+// split a residual into the partitions and parameters that code it smallest, returning about how many bits that takes
+static long long chooseRice(const int* residual, int count, int order, FlacSubframe& sub, unsigned long long* sums)
+{
+	// the finest split of the block into equal partitions, the first of which still holds more than the warm up
+	int finest = 0;
+	while (finest < FLAC_MAX_PARTITION_ORDER && count % (2 << finest) == 0 && (count >> (finest + 1)) > order)
+		finest++;
+	int size = count >> finest;
+	for (int j = 0; j < (1 << finest); j++)
+	{
+		unsigned long long sum = 0;
+		for (int i = (j == 0 ? order : j * size); i < (j + 1) * size; i++)
+			sum += zigzag(residual[i]);
+		sums[j] = sum;
+	}
+
+	// each coarser split sums pairs of the finer one's partitions
+	long long best = -1;
+	for (int partitionOrder = finest; partitionOrder >= 0; partitionOrder--)
+	{
+		int partitions = 1 << partitionOrder;
+		int partitionSize = count >> partitionOrder;
+		int parameters[1 << FLAC_MAX_PARTITION_ORDER];
+		bool wide = false;
+		long long bits = 6;
+		for (int j = 0; j < partitions; j++)
+		{
+			long long partitionBits;
+			parameters[j] = chooseParameter(sums[j], partitionSize - (j == 0 ? order : 0), partitionBits);
+			wide = wide || parameters[j] > 14;
+			bits += partitionBits;
+		}
+		bits += partitions * (wide ? 5 : 4);
+		if (best < 0 || bits < best)
+		{
+			best = bits;
+			sub.partitionOrder = partitionOrder;
+			sub.wide = wide;
+			memcpy(sub.parameters, parameters, partitions * sizeof(int));
+		}
+		for (int j = 0; j < partitions / 2; j++)
+			sums[j] = sums[2 * j] + sums[2 * j + 1];
+	}
+	return best;
+}
+
+// exactly how many bits a residual takes with the partitions and parameters chosen
+static long long countRice(const int* residual, int count, int order, const FlacSubframe& sub)
+{
+	int partitions = 1 << sub.partitionOrder;
+	int size = count >> sub.partitionOrder;
+	long long bits = 6 + partitions * (sub.wide ? 5 : 4);
+	for (int j = 0; j < partitions; j++)
+	{
+		int k = sub.parameters[j];
+		int first = (j == 0 ? order : j * size);
+		bits += (long long)((j + 1) * size - first) * (k + 1);
+		for (int i = first; i < (j + 1) * size; i++)
+			bits += zigzag(residual[i]) >> k;
+	}
+	return bits;
+}
+
+// the residual of a fixed polynomial predictor of an order (the warm up is left alone)
+static void fixedResidual(const int* x, int count, int order, int* residual)
+{
+	for (int i = order; i < count; i++)
+	{
+		switch (order)
+		{
+		case 0: residual[i] = x[i]; break;
+		case 1: residual[i] = x[i] - x[i - 1]; break;
+		case 2: residual[i] = x[i] - 2 * x[i - 1] + x[i - 2]; break;
+		case 3: residual[i] = x[i] - 3 * x[i - 1] + 3 * x[i - 2] - x[i - 3]; break;
+		default: residual[i] = x[i] - 4 * x[i - 1] + 6 * x[i - 2] - 4 * x[i - 3] + x[i - 4]; break;
+		}
+	}
+}
+
+// fit LPC coefficients of every order up to the most to a channel's autocorrelation (Levinson-Durbin), with the error each leaves
+static int fitLpc(const double* autocorrelation, int maxOrder, double coefficients[][FLAC_MAX_LPC_ORDER], double* errors)
+{
+	double lpc[FLAC_MAX_LPC_ORDER];
+	double error = autocorrelation[0];
+	for (int i = 0; i < maxOrder; i++)
+	{
+		// the reflection coefficient of this order
+		double reflection = -autocorrelation[i + 1];
+		for (int j = 0; j < i; j++)
+			reflection -= lpc[j] * autocorrelation[i - j];
+		reflection /= error;
+
+		// update the lower orders' coefficients with it
+		lpc[i] = reflection;
+		int j = 0;
+		for (; j < (i >> 1); j++)
+		{
+			double swap = lpc[j];
+			lpc[j] += reflection * lpc[i - 1 - j];
+			lpc[i - 1 - j] += reflection * swap;
+		}
+		if (i & 1)
+			lpc[j] += lpc[j] * reflection;
+		error *= (1.0 - reflection * reflection);
+		for (j = 0; j <= i; j++)
+			coefficients[i][j] = -lpc[j];
+		errors[i] = error;
+
+		// a perfect fit needs no higher order
+		if (error <= 0.0)
+			return i + 1;
+	}
+	return maxOrder;
+}
+
+// quantize coefficients to a number of bits with a shift, carrying each one's rounding error into the next (false if they can't be)
+static bool quantizeLpc(const double* lpc, int order, int precision, int* quantized, int& shift)
+{
+	double largest = 0.0;
+	for (int i = 0; i < order; i++)
+		largest = (fabs(lpc[i]) > largest ? fabs(lpc[i]) : largest);
+	if (largest <= 0.0)
+		return false;
+
+	// as much of the precision as the largest leaves room for (a shift is 4 bits of 5 signed ones, never negative)
+	int exponent;
+	frexp(largest, &exponent);
+	shift = (precision - 1) - exponent;
+	if (shift > 15)
+		shift = 15;
+	if (shift < 0)
+		return false;
+	int highest = (1 << (precision - 1)) - 1;
+	int lowest = -(1 << (precision - 1));
+	double carried = 0.0;
+	for (int i = 0; i < order; i++)
+	{
+		carried += lpc[i] * (1 << shift);
+		long q = lround(carried);
+		q = (q > highest ? highest : (q < lowest ? lowest : q));
+		carried -= q;
+		quantized[i] = (int)q;
+	}
+	return true;
+}
+
+// the residual of quantized LPC coefficients (the warm up is left alone)
+// (a prediction fits 32 bits when the sample and coefficient bits and the order's log do, as with 16 bit samples)
+static void lpcResidual(const int* x, int count, const int* coefficients, int order, int shift, int sampleBits, int precision, int* residual)
+{
+	int orderBits = 0;
+	while ((1 << orderBits) < order)
+		orderBits++;
+	if (sampleBits + precision + orderBits <= 32)
+	{
+		for (int i = order; i < count; i++)
+		{
+			int prediction = 0;
+			for (int j = 0; j < order; j++)
+				prediction += coefficients[j] * x[i - 1 - j];
+			residual[i] = x[i] - (prediction >> shift);
+		}
+		return;
+	}
+	for (int i = order; i < count; i++)
+	{
+		long long prediction = 0;
+		for (int j = 0; j < order; j++)
+			prediction += (long long)coefficients[j] * x[i - 1 - j];
+		residual[i] = x[i] - (int)(prediction >> shift);
+	}
+}
+
+// choose how to code a channel of a block (the bits a sample of it takes), leaving its residual behind
+static void analyzeSubframe(const int* x, int count, int sampleBits, int* residual, FlacSubframe& sub, FlacWorkspace& work)
+{
+	// stored as it is, unless something beats it
+	sub.type = SUBFRAME_VERBATIM;
+	sub.order = 0;
+	sub.bits = 8 + (long long)count * sampleBits;
+
+	// silence (or anything else that holds still) is a single sample
+	bool constant = true;
+	for (int i = 1; i < count && constant; i++)
+		constant = (x[i] == x[0]);
+	if (constant)
+	{
+		sub.type = SUBFRAME_CONSTANT;
+		sub.bits = 8 + sampleBits;
+		return;
+	}
+
+	// the fixed polynomial leaving the smallest residual (judged by its sum, as any order codes about as well as that)
+	int fixedOrder = 0;
+	if (count > FLAC_MAX_FIXED_ORDER * 2)
+	{
+		long long totals[FLAC_MAX_FIXED_ORDER + 1] = { 0, 0, 0, 0, 0 };
+		for (int i = FLAC_MAX_FIXED_ORDER; i < count; i++)
+		{
+			long long e0 = x[i];
+			long long e1 = e0 - x[i - 1];
+			long long e2 = e1 - ((long long)x[i - 1] - x[i - 2]);
+			long long e3 = e2 - ((long long)x[i - 1] - 2LL * x[i - 2] + x[i - 3]);
+			long long e4 = e3 - ((long long)x[i - 1] - 3LL * x[i - 2] + 3LL * x[i - 3] - x[i - 4]);
+			totals[0] += (e0 < 0 ? -e0 : e0);
+			totals[1] += (e1 < 0 ? -e1 : e1);
+			totals[2] += (e2 < 0 ? -e2 : e2);
+			totals[3] += (e3 < 0 ? -e3 : e3);
+			totals[4] += (e4 < 0 ? -e4 : e4);
+		}
+		for (int order = 1; order <= FLAC_MAX_FIXED_ORDER; order++)
+			fixedOrder = (totals[order] < totals[fixedOrder] ? order : fixedOrder);
+	}
+	FlacSubframe& candidate = work.candidate;
+	fixedResidual(x, count, fixedOrder, work.trial);
+	candidate.type = SUBFRAME_FIXED;
+	candidate.order = fixedOrder;
+	candidate.bits = 8 + (long long)fixedOrder * sampleBits + chooseRice(work.trial, count, fixedOrder, candidate, work.sums);
+	if (candidate.bits < sub.bits)
+	{
+		sub = candidate;
+		memcpy(residual, work.trial, count * sizeof(int));
+	}
+
+	// an LPC fit, once there are samples enough for one to pay for its coefficients
+	if (count > FLAC_MAX_LPC_ORDER * 8)
+	{
+		// a Tukey window (half cosine tapered), so the block's edges don't smear the fit
+		if (work.windowSize != count)
+		{
+			int taper = count / 4;
+			for (int i = 0; i < count; i++)
+			{
+				int edge = (i < count - 1 - i ? i : count - 1 - i);
+				work.window[i] = (edge < taper ? 0.5 - 0.5 * cos(3.14159265358979323846 * edge / taper) : 1.0);
+			}
+			work.windowSize = count;
+		}
+		for (int i = 0; i < count; i++)
+			work.windowed[i] = x[i] * work.window[i];
+		// every lag in one pass, each summed on its own so none waits on another
+		double autocorrelation[FLAC_MAX_LPC_ORDER + 1];
+		for (int lag = 0; lag <= FLAC_MAX_LPC_ORDER; lag++)
+		{
+			double sum = 0.0;
+			for (int i = lag; i < FLAC_MAX_LPC_ORDER; i++)
+				sum += work.windowed[i] * work.windowed[i - lag];
+			autocorrelation[lag] = sum;
+		}
+		for (int i = FLAC_MAX_LPC_ORDER; i < count; i++)
+		{
+			double sample = work.windowed[i];
+			for (int lag = 0; lag <= FLAC_MAX_LPC_ORDER; lag++)
+				autocorrelation[lag] += sample * work.windowed[i - lag];
+		}
+
+		if (autocorrelation[0] > 0.0)
+		{
+			// the order whose error, spread over the residual and paying for its coefficients, comes out smallest
+			double lpc[FLAC_MAX_LPC_ORDER][FLAC_MAX_LPC_ORDER];
+			double errors[FLAC_MAX_LPC_ORDER];
+			int orders = fitLpc(autocorrelation, FLAC_MAX_LPC_ORDER, lpc, errors);
+			int precision = (sampleBits <= 17 ? 12 : 15);
+			int order = 1;
+			double fewest = 0.0;
+			for (int i = 1; i <= orders; i++)
+			{
+				double perSample = (errors[i - 1] > 0.0 ? 0.5 * log(errors[i - 1] * 0.5 / count) / log(2.0) : 0.0);
+				double estimate = (perSample > 0.0 ? perSample : 0.0) * (count - i) + (double)i * (sampleBits + precision);
+				if (i == 1 || estimate < fewest)
+				{
+					fewest = estimate;
+					order = i;
+				}
+			}
+
+			// try it against the best so far
+			if (quantizeLpc(lpc[order - 1], order, precision, candidate.coefficients, candidate.shift))
+			{
+				lpcResidual(x, count, candidate.coefficients, order, candidate.shift, sampleBits, precision, work.trial);
+				candidate.type = SUBFRAME_LPC;
+				candidate.order = order;
+				candidate.precision = precision;
+				candidate.bits = 8 + (long long)order * (sampleBits + precision) + 9 + chooseRice(work.trial, count, order, candidate, work.sums);
+				if (candidate.bits < sub.bits)
+				{
+					sub = candidate;
+					memcpy(residual, work.trial, count * sizeof(int));
+				}
+			}
+		}
+	}
+
+	// the residual's size was only estimated, so make sure it really does beat storing the samples as they are
+	if (sub.type != SUBFRAME_VERBATIM)
+	{
+		long long warmUp = (long long)sub.order * (sampleBits + (sub.type == SUBFRAME_LPC ? sub.precision : 0));
+		sub.bits = 8 + warmUp + (sub.type == SUBFRAME_LPC ? 9 : 0) + countRice(residual, count, sub.order, sub);
+		if (sub.bits >= 8 + (long long)count * sampleBits)
+		{
+			sub.type = SUBFRAME_VERBATIM;
+			sub.order = 0;
+			sub.bits = 8 + (long long)count * sampleBits;
+		}
+	}
+}
+
+// write a channel of a block the way it was chosen to be coded
+static void writeSubframe(FlacBitWriter& out, const int* x, const int* residual, int count, int sampleBits, const FlacSubframe& sub)
+{
+	// a zero bit, the type (with the order folded in), and no wasted bits
+	int type = 0;
+	switch (sub.type)
+	{
+	case SUBFRAME_CONSTANT: type = 0; break;
+	case SUBFRAME_VERBATIM: type = 1; break;
+	case SUBFRAME_FIXED: type = 8 | sub.order; break;
+	case SUBFRAME_LPC: type = 32 | (sub.order - 1); break;
+	}
+	out.put(type << 1, 8);
+	if (sub.type == SUBFRAME_CONSTANT)
+	{
+		out.put((unsigned int)x[0], sampleBits);
+		return;
+	}
+	if (sub.type == SUBFRAME_VERBATIM)
+	{
+		for (int i = 0; i < count; i++)
+			out.put((unsigned int)x[i], sampleBits);
+		return;
+	}
+
+	// the warm up samples, then the coefficients of an LPC subframe
+	for (int i = 0; i < sub.order; i++)
+		out.put((unsigned int)x[i], sampleBits);
+	if (sub.type == SUBFRAME_LPC)
+	{
+		out.put(sub.precision - 1, 4);
+		out.put(sub.shift, 5);
+		for (int i = 0; i < sub.order; i++)
+			out.put((unsigned int)sub.coefficients[i], sub.precision);
+	}
+
+	// the residual, partition by partition
+	out.put(sub.wide ? 1 : 0, 2);
+	out.put(sub.partitionOrder, 4);
+	int partitions = 1 << sub.partitionOrder;
+	int size = count >> sub.partitionOrder;
+	for (int j = 0; j < partitions; j++)
+	{
+		int k = sub.parameters[j];
+		out.put(k, (sub.wide ? 5 : 4));
+		for (int i = (j == 0 ? sub.order : j * size); i < (j + 1) * size; i++)
+			out.putRice(zigzag(residual[i]), k);
+	}
+}
+
+void FlacWriter::Md5::start()
+{
+	state[0] = 0x67452301;
+	state[1] = 0xefcdab89;
+	state[2] = 0x98badcfe;
+	state[3] = 0x10325476;
+	length = 0;
+}
+
+void FlacWriter::Md5::transform(const unsigned char* block)
+{
+	// sixteen little endian words, mixed in four rounds of sixteen steps
+	unsigned int words[16];
+	for (int i = 0; i < 16; i++)
+		words[i] = block[i * 4] | (block[i * 4 + 1] << 8) | (block[i * 4 + 2] << 16) | ((unsigned int)block[i * 4 + 3] << 24);
+	unsigned int a = state[0], b = state[1], c = state[2], d = state[3];
+	for (int i = 0; i < 64; i++)
+	{
+		unsigned int f;
+		int word;
+		switch (i >> 4)
+		{
+		case 0: f = (b & c) | (~b & d); word = i; break;
+		case 1: f = (d & b) | (~d & c); word = (5 * i + 1) & 15; break;
+		case 2: f = b ^ c ^ d; word = (3 * i + 5) & 15; break;
+		default: f = c ^ (b | ~d); word = (7 * i) & 15; break;
+		}
+		unsigned int rotated = a + f + md5Constants[i] + words[word];
+		int shift = md5Shifts[((i >> 4) << 2) | (i & 3)];
+		a = d;
+		d = c;
+		c = b;
+		b += (rotated << shift) | (rotated >> (32 - shift));
+	}
+	state[0] += a;
+	state[1] += b;
+	state[2] += c;
+	state[3] += d;
+}
+
+void FlacWriter::Md5::add(const unsigned char* data, int count)
+{
+	// top up a partial block first, then whole blocks straight from the data
+	int held = (int)(length & 63);
+	length += count;
+	if (held > 0)
+	{
+		int take = (64 - held < count ? 64 - held : count);
+		memcpy(buffer + held, data, take);
+		data += take;
+		count -= take;
+		if (held + take < 64)
+			return;
+		transform(buffer);
+	}
+	for (; count >= 64; data += 64, count -= 64)
+		transform(data);
+	memcpy(buffer, data, count);
+}
+
+void FlacWriter::Md5::finish(unsigned char* digest)
+{
+	// a one bit, zeros up to the last 8 bytes of a block, and the length in bits
+	unsigned long long bitLength = length * 8;
+	unsigned char padding[72] = { 0x80 };
+	int held = (int)(length & 63);
+	int count = (held < 56 ? 56 - held : 120 - held);
+	for (int i = 0; i < 8; i++)
+		padding[count + i] = (unsigned char)(bitLength >> (8 * i));
+	add(padding, count + 8);
+	for (int i = 0; i < 16; i++)
+		digest[i] = (unsigned char)(state[i >> 2] >> (8 * (i & 3)));
+}
+
+FlacWriter::FlacWriter(int threads)
+	: file(NULL), channels(AUDIO_CHANNELS), format(PCM16), bits(16), rate(AUDIO_SAMPLE_RATE), framesWritten(0), filling(0),
+	  encodedWaiting(false), numEncoders(threads), generation(0), encoding(0), nextBlock(0), encodersBusy(0), encodersQuit(false),
+	  minFrameBytes(0), maxFrameBytes(0)
+{
+	// as many as there are cores, unless told otherwise
+	if (numEncoders <= 0)
+		numEncoders = (int)std::thread::hardware_concurrency();
+	numEncoders = (numEncoders < 1 ? 1 : (numEncoders > MAX_ENCODERS ? MAX_ENCODERS : numEncoders));
+
+	// the batches are only allocated once a file is opened
+	for (int i = 0; i < 2; i++)
+	{
+		batches[i].samples = NULL;
+		batches[i].encoded = NULL;
+		batches[i].frames = 0;
+		batches[i].firstBlock = 0;
+	}
+}
+
+FlacWriter::~FlacWriter()
+{
+	// finish up, then free the batches
+	close();
+	for (int i = 0; i < 2; i++)
+	{
+		delete[] batches[i].samples;
+		delete[] batches[i].encoded;
+	}
+}
+
+bool FlacWriter::isFlacPath(const char* path)
+{
+	int length = (int)strlen(path);
+	const char* extension = ".flac";
+	if (length < 5)
+		return false;
+	for (int i = 0; i < 5; i++)
+	{
+		if (tolower((unsigned char)path[length - 5 + i]) != extension[i])
+			return false;
+	}
+	return true;
+}
+
+bool FlacWriter::open(const char* path, int channelCount, Format sampleFormat, bool dithered, int sampleRate)
+{
+	// idiot test
+	assert(channelCount > 0 && channelCount <= AUDIO_CHANNELS && sampleRate > 0);
+	close();
+	if (sampleFormat != PCM16 && sampleFormat != PCM24)
+	{
+		DebugPrintf("  [AUDIO] FLAC files are written with 16 or 24 bit samples only\n");
+		return false;
+	}
+	channels = channelCount;
+	format = sampleFormat;
+	bits = bytesFor(format) * 8;
+	rate = sampleRate;
+	converter.setFormat(format, dithered);
+	framesWritten = 0;
+	minFrameBytes = 0;
+	maxFrameBytes = 0;
+
+	// create the file
+#ifdef _WIN32
+	fopen_s(&file, path, "wb");
+#else
+	file = fopen(path, "wb");
+#endif
+	if (!file)
+	{
+		DebugPrintf("  [AUDIO] Could not create %s\n", path);
+		return false;
+	}
+
+	// the marker, then the stream info as the only (so last) metadata block, with its sizes and signature filled in on close
+	unsigned char header[STREAM_INFO_OFFSET + STREAM_INFO_SIZE] = { 'f', 'L', 'a', 'C', 0x80, 0, 0, 34 };
+	if (fwrite(header, 1, sizeof(header), file) != sizeof(header))
+	{
+		fclose(file);
+		file = NULL;
+		return false;
+	}
+	signature.start();
+
+	// the batches, and the team encoding them
+	for (int i = 0; i < 2; i++)
+	{
+		if (!batches[i].samples)
+		{
+			batches[i].samples = new int[BATCH_BLOCKS * FLAC_BLOCK_SIZE * AUDIO_CHANNELS];
+			batches[i].encoded = new unsigned char[BATCH_BLOCKS * MAX_BLOCK_BYTES];
+		}
+		batches[i].frames = 0;
+		batches[i].firstBlock = 0;
+	}
+	filling = 0;
+	encodedWaiting = false;
+	generation = 0;
+	encodersBusy = 0;
+	encodersQuit = false;
+	for (int i = 0; i < numEncoders; i++)
+		encoders[i] = std::thread(encodeBatches, this);
+	return true;
+}
+
+void FlacWriter::encodeBatches(FlacWriter* myself)
+{
+	// scratch space of our own
+	FlacWorkspace* work = new FlacWorkspace();
+	work->windowSize = 0;
+	unsigned int seen = 0;
+	std::unique_lock<std::mutex> lock(myself->encoderMutex);
+	while (true)
+	{
+		// sleep until there is a new batch (or we are told to stop)
+		while (myself->generation == seen && !myself->encodersQuit)
+			myself->encoderWake.wait(lock);
+		if (myself->generation == seen)
+			break;
+		seen = myself->generation;
+		Batch& batch = myself->batches[myself->encoding];
+		lock.unlock();
+
+		// take blocks until there are none left
+		int blocks = (batch.frames + FLAC_BLOCK_SIZE - 1) / FLAC_BLOCK_SIZE;
+		for (int i = myself->nextBlock++; i < blocks; i = myself->nextBlock++)
+		{
+			int first = i * FLAC_BLOCK_SIZE;
+			int frames = (batch.frames - first < FLAC_BLOCK_SIZE ? batch.frames - first : FLAC_BLOCK_SIZE);
+			batch.encodedBytes[i] = myself->encodeBlock(batch.samples + first * myself->channels, frames, batch.firstBlock + i,
+				batch.encoded + i * MAX_BLOCK_BYTES, *work);
+		}
+
+		// the last one done lets the writer know
+		lock.lock();
+		if (--myself->encodersBusy == 0)
+			myself->encoderDone.notify_all();
+	}
+	delete work;
+}
+
+int FlacWriter::encodeBlock(const int* samples, int frames, long long number, unsigned char* out, FlacWorkspace& work)
+{
+	// the channels apart, and for stereo their difference and average as well
+	for (int c = 0; c < channels; c++)
+	{
+		for (int i = 0; i < frames; i++)
+			work.signals[c][i] = samples[i * channels + c];
+	}
+	int assignment = channels - 1;
+	int coded[2] = { 0, 1 };
+	if (channels == 2)
+	{
+		for (int i = 0; i < frames; i++)
+		{
+			work.signals[2][i] = work.signals[0][i] - work.signals[1][i];
+			work.signals[3][i] = (work.signals[0][i] + work.signals[1][i]) >> 1;
+		}
+	}
+
+	// how each channel codes smallest (the side channel needs a bit more than the rest)
+	int candidates = (channels == 2 ? 4 : channels);
+	for (int c = 0; c < candidates; c++)
+		analyzeSubframe(work.signals[c], frames, bits + (c == 2 ? 1 : 0), work.residuals[c], work.subframes[c], work);
+
+	// then whichever pair of them codes stereo smallest: left/right, left/side, side/right or mid/side
+	if (channels == 2)
+	{
+		long long pairs[4] = { work.subframes[0].bits + work.subframes[1].bits, work.subframes[0].bits + work.subframes[2].bits,
+			work.subframes[2].bits + work.subframes[1].bits, work.subframes[3].bits + work.subframes[2].bits };
+		static const int assignments[4] = { 1, 8, 9, 10 };
+		static const int pairChannels[4][2] = { { 0, 1 }, { 0, 2 }, { 2, 1 }, { 3, 2 } };
+		int best = 0;
+		for (int i = 1; i < 4; i++)
+			best = (pairs[i] < pairs[best] ? i : best);
+		assignment = assignments[best];
+		coded[0] = pairChannels[best][0];
+		coded[1] = pairChannels[best][1];
+	}
+
+	// the header: sync code, block size, sample rate, channels, sample size, then the frame's number (coded like UTF-8)
+	FlacBitWriter writer(out);
+	writer.put(0xFFF8, 16);
+	int sizeCode = (frames == FLAC_BLOCK_SIZE ? 12 : (frames <= 256 ? 6 : 7));
+	int rateCode = 0;
+	for (int i = 0; i < (int)(sizeof(rateCodes) / sizeof(rateCodes[0])); i++)
+		rateCode = (rateCodes[i][0] == rate ? rateCodes[i][1] : rateCode);
+	writer.put(sizeCode, 4);
+	writer.put(rateCode, 4);
+	writer.put(assignment, 4);
+	writer.put(bits == 16 ? 4 : 6, 3);
+	writer.put(0, 1);
+	unsigned int value = (unsigned int)number;
+	if (value < 0x80)
+		writer.put(value, 8);
+	else
+	{
+		int following = 1;
+		while (following < 5 && value >= (1u << (5 * following + 6)))
+			following++;
+		writer.put((0xFF00 >> (following + 1)) | (value >> (6 * following)), 8);
+		for (int i = following - 1; i >= 0; i--)
+			writer.put(0x80 | ((value >> (6 * i)) & 0x3F), 8);
+	}
+	if (sizeCode != 12)
+		writer.put(frames - 1, (sizeCode == 6 ? 8 : 16));
+	unsigned char crc8 = 0;
+	for (int i = 0; i < writer.bytes; i++)
+		crc8 = crcTables.crc8[crc8 ^ out[i]];
+	writer.put(crc8, 8);
+
+	// the subframes, then zeros up to a byte and the CRC of the whole frame
+	for (int c = 0; c < channels; c++)
+	{
+		int signal = coded[c];
+		writeSubframe(writer, work.signals[signal], work.residuals[signal], frames, bits + (signal == 2 ? 1 : 0), work.subframes[signal]);
+	}
+	writer.align();
+	unsigned int crc16 = 0;
+	for (int i = 0; i < writer.bytes; i++)
+		crc16 = ((crc16 << 8) ^ crcTables.crc16[(crc16 >> 8) ^ out[i]]) & 0xFFFF;
+	writer.put(crc16, 16);
+	return writer.bytes;
+}
+
+bool FlacWriter::writeEncoded()
+{
+	// wait for the team to be done
+	{
+		std::unique_lock<std::mutex> lock(encoderMutex);
+		while (encodersBusy > 0)
+			encoderDone.wait(lock);
+	}
+	if (!encodedWaiting)
+		return true;
+	encodedWaiting = false;
+
+	// its frames, in order
+	Batch& batch = batches[1 - filling];
+	int blocks = (batch.frames + FLAC_BLOCK_SIZE - 1) / FLAC_BLOCK_SIZE;
+	for (int i = 0; i < blocks; i++)
+	{
+		int size = batch.encodedBytes[i];
+		if (fwrite(batch.encoded + i * MAX_BLOCK_BYTES, 1, size, file) != (size_t)size)
+			return false;
+		minFrameBytes = (minFrameBytes == 0 || size < minFrameBytes ? size : minFrameBytes);
+		maxFrameBytes = (size > maxFrameBytes ? size : maxFrameBytes);
+	}
+	return true;
+}
+
+bool FlacWriter::submit()
+{
+	// the batch before has to be out of the way first
+	if (!writeEncoded())
+		return false;
+	Batch& batch = batches[filling];
+	if (batch.frames == 0)
+		return true;
+
+	// hand it to the team
+	{
+		std::lock_guard<std::mutex> lock(encoderMutex);
+		encoding = filling;
+		nextBlock.store(0);
+		encodersBusy = numEncoders;
+		generation++;
+	}
+	encoderWake.notify_all();
+	encodedWaiting = true;
+
+	// sign its samples as the team encodes them, little endian as they would be in a wave file
+	int bytes = bits / 8;
+	unsigned char packed[FLAC_BLOCK_SIZE * 3];
+	int total = batch.frames * channels;
+	for (int first = 0; first < total; first += FLAC_BLOCK_SIZE)
+	{
+		int count = (total - first < FLAC_BLOCK_SIZE ? total - first : FLAC_BLOCK_SIZE);
+		for (int i = 0; i < count; i++)
+		{
+			for (int j = 0; j < bytes; j++)
+				packed[i * bytes + j] = (unsigned char)((unsigned int)batch.samples[first + i] >> (8 * j));
+		}
+		signature.add(packed, count * bytes);
+	}
+
+	// and fill the other
+	filling = 1 - filling;
+	batches[filling].frames = 0;
+	batches[filling].firstBlock = batch.firstBlock + (batch.frames + FLAC_BLOCK_SIZE - 1) / FLAC_BLOCK_SIZE;
+	return true;
+}
+
+bool FlacWriter::write(const float* samples, int frames)
+{
+	// idiot test
+	if (!file)
+		return false;
+
+	// convert straight into the batch being filled, handing it over whenever it is full
+	int capacity = BATCH_BLOCKS * FLAC_BLOCK_SIZE;
+	while (frames > 0)
+	{
+		Batch& batch = batches[filling];
+		int count = (capacity - batch.frames < frames ? capacity - batch.frames : frames);
+		converter.quantize(samples, count * channels, bits, batch.samples + batch.frames * channels);
+		batch.frames += count;
+		framesWritten += count;
+		samples += count * channels;
+		frames -= count;
+		if (batch.frames == capacity && !submit())
+			return false;
+	}
+	return true;
+}
+
+bool FlacWriter::close()
+{
+	// nothing open
+	if (!file)
+		return false;
+
+	// encode and write whatever is left, then let the team go
+	bool valid = submit();
+	valid = writeEncoded() && valid;
+	{
+		std::lock_guard<std::mutex> lock(encoderMutex);
+		encodersQuit = true;
+	}
+	encoderWake.notify_all();
+	for (int i = 0; i < numEncoders; i++)
+		encoders[i].join();
+
+	// the stream info now that everything is known: block sizes, frame sizes, rate, channels, bits, frames and signature
+	int blockSize = (framesWritten < FLAC_BLOCK_SIZE ? (framesWritten > 16 ? (int)framesWritten : 16) : FLAC_BLOCK_SIZE);
+	unsigned char info[STREAM_INFO_SIZE - 4];
+	info[0] = (unsigned char)(blockSize >> 8);
+	info[1] = (unsigned char)blockSize;
+	info[2] = info[0];
+	info[3] = info[1];
+	for (int i = 0; i < 3; i++)
+	{
+		info[4 + i] = (unsigned char)(minFrameBytes >> (16 - 8 * i));
+		info[7 + i] = (unsigned char)(maxFrameBytes >> (16 - 8 * i));
+	}
+	info[10] = (unsigned char)(rate >> 12);
+	info[11] = (unsigned char)(rate >> 4);
+	info[12] = (unsigned char)(((rate & 0xF) << 4) | ((channels - 1) << 1) | ((bits - 1) >> 4));
+	info[13] = (unsigned char)((((bits - 1) & 0xF) << 4) | (int)((framesWritten >> 32) & 0xF));
+	for (int i = 0; i < 4; i++)
+		info[14 + i] = (unsigned char)(framesWritten >> (24 - 8 * i));
+	signature.finish(info + 18);
+	valid = valid && fseek(file, STREAM_INFO_OFFSET + 4, SEEK_SET) == 0 && fwrite(info, 1, sizeof(info), file) == sizeof(info);
+
+	// done
+	valid = (fclose(file) == 0 && valid);
+	file = NULL;
+	return valid;
+}
+
+// macro cleanup
+#undef FLAC_MAX_FIXED_ORDER
+#undef FLAC_MAX_LPC_ORDER
+#undef FLAC_MAX_PARTITION_ORDER
+#undef FLAC_MAX_RICE_PARAMETER
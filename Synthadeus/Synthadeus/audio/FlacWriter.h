@@ -0,0 +1,148 @@
+////////////////////////////////////////////////////////////////////////////////
+//                                                                            //
+//   FLAC Writer                                                              //
+//   Everett Moser                                                            //
+//   10-18-26                                                                 //
+//                                                                            //
+//   Streams rendered frames to a losslessly compressed FLAC file             //
+//                                                                            //
+////////////////////////////////////////////////////////////////////////////////
+
+#pragma once
+
+#include "Error.h"
+#include "AudioDefines.h"
+#include "AudioWriter.h"
+#include "WaveWriter.h"
+#include <stdio.h>
+
+#include <atomic>
+#include <thread>
+#include <mutex>
+#include <condition_variable>
+
+// frames in each FLAC frame (the last may be shorter)
+#define FLAC_BLOCK_SIZE 4096
+
+// scratch space for encoding a block, one for each thread encoding
+struct FlacWorkspace;
+
+// a FLAC stream of 16 or 24 bit samples, encoded without any library: every block of frames is a FLAC frame of its own,
+// each channel predicted from its past samples (a fixed polynomial, or LPC coefficients fitted to the block) and the
+// residual Rice coded, with stereo as left/right, left/side, right/side or mid/side, whichever is smallest
+// since frames are independent, a batch of blocks is encoded by a team of threads while the next batch fills,
+// and the encoded frames are written in order (the stream info is filled in on close, MD5 signature and all)
+class FlacWriter : public AudioWriter
+{
+private:
+
+	// the file being written (NULL when closed)
+	FILE* file;
+
+	// interleaved channels per frame, bits per sample and the rate they play at
+	int channels;
+	Format format;
+	int bits;
+	int rate;
+
+	// frames written so far
+	long long framesWritten;
+
+	// converts the floats to integers, dithered if asked to (its own file is never opened)
+	WaveWriter converter;
+
+	// blocks encoded at once (~3 s)
+	const static int BATCH_BLOCKS = 32;
+
+	// bytes a block can take at worst, stored verbatim (the side channel has a bit more than the rest, plus header and footer)
+	const static int MAX_BLOCK_BYTES = 32 + AUDIO_CHANNELS * (2 + FLAC_BLOCK_SIZE * 33 / 8);
+
+	// the stream info after the marker, and where its sizes are filled in on close
+	const static int STREAM_INFO_OFFSET = 4;
+	const static int STREAM_INFO_SIZE = 38;
+
+	// blocks of integer samples, and the FLAC frames they were encoded into
+	struct Batch
+	{
+		int* samples;
+		int frames;
+		long long firstBlock;
+		unsigned char* encoded;
+		int encodedBytes[BATCH_BLOCKS];
+	};
+
+	// the batch being filled, and the other (being encoded, or encoded and waiting to be written)
+	Batch batches[2];
+	int filling;
+	bool encodedWaiting;
+
+	// the team encoding the blocks of a batch, handed each one by bumping the generation
+	const static int MAX_ENCODERS = 8;
+	std::thread encoders[MAX_ENCODERS];
+	int numEncoders;
+	std::mutex encoderMutex;
+	std::condition_variable encoderWake;
+	std::condition_variable encoderDone;
+	unsigned int generation;
+	int encoding;
+	std::atomic<int> nextBlock;
+	int encodersBusy;
+	bool encodersQuit;
+
+	// a team member's thread
+	static void encodeBatches(FlacWriter* myself);
+
+	// wait for the team to finish the batch it has, then write its frames out in order (false if the file couldn't take them)
+	bool writeEncoded();
+
+	// hand the batch being filled to the team and start filling the other (false if writing the one before failed)
+	bool submit();
+
+	// the smallest and largest frames written, for the stream info
+	int minFrameBytes;
+	int maxFrameBytes;
+
+	// the MD5 of the samples as they would be in a wave file, so a decoder can check it got back exactly what went in
+	struct Md5
+	{
+		unsigned int state[4];
+		unsigned long long length;
+		unsigned char buffer[64];
+		void start();
+		void add(const unsigned char* data, int count);
+		void finish(unsigned char* digest);
+		void transform(const unsigned char* block);
+	};
+	Md5 signature;
+
+	// encode a block of interleaved samples into a FLAC frame, returning its size in bytes (any thread, each with its own workspace)
+	int encodeBlock(const int* samples, int frames, long long number, unsigned char* out, FlacWorkspace& work);
+
+	// writers own their file and their team, so they are never copied
+	FlacWriter(const FlacWriter&);
+	FlacWriter& operator=(const FlacWriter&);
+
+public:
+
+	// nothing open yet, encoded by a number of threads (0 for as many as there are cores, up to 8)
+	FlacWriter(int threads = 0);
+
+	// close the file if it is still open, and free the batches
+	virtual ~FlacWriter();
+
+	// create a FLAC file of 16 or 24 bit frames (PCM16 or PCM24) at a sample rate, and write its stream info
+	virtual bool open(const char* path, int channelCount = AUDIO_CHANNELS, Format sampleFormat = PCM16, bool dithered = false,
+		int sampleRate = AUDIO_SAMPLE_RATE);
+
+	// append interleaved frames, clipped to the format (false if the file couldn't take them)
+	virtual bool write(const float* samples, int frames);
+
+	// encode and write whatever is left, fill in the stream info and close the file (false if it couldn't be finished)
+	virtual bool close();
+
+	// frames written so far
+	inline virtual long long getFramesWritten() { return framesWritten; }
+
+	// whether a path names a FLAC file (ends in .flac, whatever its case)
+	static bool isFlacPath(const char* path);
+};
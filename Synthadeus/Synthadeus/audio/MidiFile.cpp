@@ -0,0 +1,337 @@
+#include "MidiFile.h"
+#include <stdio.h>
+#include <string.h>
+
+// meta events and system exclusive messages (skipped, other than the tempo)
+#define MIDI_META 0xFF
+#define MIDI_META_TEMPO 0x51
+#define MIDI_META_END_OF_TRACK 0x2F
+#define MIDI_SYSEX 0xF0
+#define MIDI_SYSEX_ESCAPE 0xF7
+
+// big endian numbers of the headers
+static inline unsigned int readBig32(const unsigned char* data) { return ((unsigned int)data[0] << 24) | ((unsigned int)data[1] << 16) | ((unsigned int)data[2] << 8) | data[3]; }
+static inline unsigned int readBig16(const unsigned char* data) { return ((unsigned int)data[0] << 8) | data[1]; }
+
+// a variable length number (seven bits a byte, most significant first), false if it runs off the end
+static bool readVariable(const unsigned char* data, size_t length, size_t& position, unsigned int& value)
+{
+	value = 0;
+	for (int i = 0; i < 4; i++)
+	{
+		if (position >= length)
+			return false;
+		unsigned char byte = data[position++];
+		value = (value << 7) | (byte & 0x7F);
+		if (!(byte & 0x80))
+			return true;
+	}
+
+	// no more than four bytes are allowed
+	return false;
+}
+
+bool MidiFile::load(const char* path)
+{
+	// start from nothing
+	clear();
+
+	// read the whole file in (they are small)
+	FILE* f = NULL;
+#ifdef _WIN32
+	fopen_s(&f, path, "rb");
+#else
+	f = fopen(path, "rb");
+#endif
+	if (!f)
+	{
+		DebugPrintf("  [MIDI] Could not open %s\n", path);
+		return false;
+	}
+	fseek(f, 0, SEEK_END);
+	long length = ftell(f);
+	fseek(f, 0, SEEK_SET);
+	unsigned char* data = new unsigned char[length > 0 ? length : 1];
+	bool read = (length > 0 && fread(data, 1, length, f) == (size_t)length);
+	fclose(f);
+
+	// deliver errors
+	if (!read)
+	{
+		DebugPrintf("  [MIDI] Could not read %s\n", path);
+		delete[] data;
+		return false;
+	}
+
+	// parse it
+	bool parsed = parse(data, (size_t)length);
+	delete[] data;
+	return parsed;
+}
+
+void MidiFile::clear()
+{
+	delete[] events;
+	events = NULL;
+	numEvents = 0;
+}
+
+void MidiFile::append(TrackEvent*& list, int& count, int& capacity, const TrackEvent& event)
+{
+	// double the list whenever it fills up
+	if (count == capacity)
+	{
+		capacity = (capacity ? capacity * 2 : 1024);
+		TrackEvent* grown = new TrackEvent[capacity];
+		if (count > 0)
+			memcpy(grown, list, sizeof(TrackEvent) * count);
+		delete[] list;
+		list = grown;
+	}
+	list[count++] = event;
+}
+
+bool MidiFile::readTrack(const unsigned char* data, size_t length,
+	TrackEvent*& list, int& count, int& capacity, Tempo*& tempos, int& numTempos, int& maxTempos)
+{
+	size_t position = 0;
+	long long tick = 0;
+
+	// channel messages may leave out the status byte when it repeats
+	unsigned char running = 0;
+
+	while (position < length)
+	{
+		// ticks since the last event
+		unsigned int delta;
+		if (!readVariable(data, length, position, delta) || position >= length)
+			return false;
+		tick += delta;
+
+		// the status, or the running one if this is only data
+		unsigned char status = data[position];
+		if (status & 0x80)
+			position++;
+		else if (running)
+			status = running;
+		else
+			return false;
+
+		// meta events, only the tempo and the end of the track matter
+		if (status == MIDI_META)
+		{
+			if (position >= length)
+				return false;
+			unsigned char type = data[position++];
+			unsigned int size;
+			if (!readVariable(data, length, position, size) || position + size > length)
+				return false;
+
+			// the end of the track ends it, whatever follows
+			if (type == MIDI_META_END_OF_TRACK)
+				return true;
+
+			// microseconds per quarter note from here on
+			if (type == MIDI_META_TEMPO && size == 3)
+			{
+				if (numTempos == maxTempos)
+				{
+					maxTempos = (maxTempos ? maxTempos * 2 : 16);
+					Tempo* grown = new Tempo[maxTempos];
+					if (numTempos > 0)
+						memcpy(grown, tempos, sizeof(Tempo) * numTempos);
+					delete[] tempos;
+					tempos = grown;
+				}
+				tempos[numTempos].tick = tick;
+				tempos[numTempos].tempo = (data[position] << 16) | (data[position + 1] << 8) | data[position + 2];
+				numTempos++;
+			}
+			position += size;
+			running = 0;
+			continue;
+		}
+
+		// system exclusive messages are skipped whole
+		if (status == MIDI_SYSEX || status == MIDI_SYSEX_ESCAPE)
+		{
+			unsigned int size;
+			if (!readVariable(data, length, position, size) || position + size > length)
+				return false;
+			position += size;
+			running = 0;
+			continue;
+		}
+
+		// no other system message belongs in a file
+		if (status > MIDI_SYSEX)
+			return false;
+
+		// channel messages, program changes and channel pressure only have the one data byte
+		running = status;
+		int dataBytes = ((status & 0xE0) == 0xC0 ? 1 : 2);
+		if (position + dataBytes > length)
+			return false;
+		TrackEvent event;
+		event.tick = tick;
+		event.status = status;
+		event.data1 = data[position] & 0x7F;
+		event.data2 = (dataBytes == 2 ? data[position + 1] & 0x7F : 0);
+		position += dataBytes;
+
+		// keep the notes and controllers
+		int command = status & 0xF0;
+		if (command == NOTE_OFF || command == NOTE_ON || command == CONTROL)
+			append(list, count, capacity, event);
+	}
+
+	// a track which just stops without an end is forgiven
+	return true;
+}
+
+bool MidiFile::parse(const unsigned char* data, size_t length)
+{
+	// start from nothing
+	clear();
+
+	// the header chunk
+	if (length < 14 || memcmp(data, "MThd", 4) != 0 || readBig32(data + 4) < 6 || 8 + (size_t)readBig32(data + 4) > length)
+	{
+		DebugPrintf("  [MIDI] Not a standard midi file.\n");
+		return false;
+	}
+	int format = readBig16(data + 8);
+	int tracks = readBig16(data + 10);
+	int division = readBig16(data + 12);
+	if (format > 1)
+	{
+		DebugPrintf("  [MIDI] Format %d files aren't supported.\n", format);
+		return false;
+	}
+
+	// ticks are either a fraction of a quarter note (and follow the tempo), or of a timecode frame
+	bool timecode = (division & 0x8000) != 0;
+	double secondsPerTick;
+	if (timecode)
+	{
+		// 29 frames a second is really drop frame 29.97
+		int framesPerSecond = -(signed char)(division >> 8);
+		int ticksPerFrame = division & 0xFF;
+		double rate = (framesPerSecond == 29 ? 29.97 : (double)framesPerSecond);
+		if (framesPerSecond <= 0 || ticksPerFrame == 0)
+		{
+			DebugPrintf("  [MIDI] Bad timecode division.\n");
+			return false;
+		}
+		secondsPerTick = 1.0 / (rate * ticksPerFrame);
+	}
+	else
+	{
+		if (division == 0)
+		{
+			DebugPrintf("  [MIDI] Bad division.\n");
+			return false;
+		}
+		secondsPerTick = DEFAULT_TEMPO / 1000000.0 / division;
+	}
+
+	// read every track (unknown chunks are skipped, as the standard says)
+	TrackEvent* list = NULL;
+	int count = 0, capacity = 0;
+	Tempo* tempos = NULL;
+	int numTempos = 0, maxTempos = 0;
+	size_t position = 8 + readBig32(data + 4);
+	bool valid = true;
+	for (int track = 0; track < tracks && position + 8 <= length; )
+	{
+		size_t chunkLength = readBig32(data + position + 4);
+		if (position + 8 + chunkLength > length)
+		{
+			DebugPrintf("  [MIDI] Track %d is cut short.\n", track);
+			valid = false;
+			break;
+		}
+		if (memcmp(data + position, "MTrk", 4) == 0)
+		{
+			if (!readTrack(data + position + 8, chunkLength, list, count, capacity, tempos, numTempos, maxTempos))
+			{
+				DebugPrintf("  [MIDI] Track %d is malformed.\n", track);
+				valid = false;
+				break;
+			}
+			track++;
+		}
+		position += 8 + chunkLength;
+	}
+
+	if (valid)
+	{
+		// each track is in order already, so a stable merge sort by tick keeps the tracks' order at the same tick
+		TrackEvent* scratch = new TrackEvent[count > 0 ? count : 1];
+		for (int width = 1; width < count; width *= 2)
+		{
+			for (int left = 0; left < count; left += 2 * width)
+			{
+				int middle = (left + width < count ? left + width : count);
+				int right = (left + 2 * width < count ? left + 2 * width : count);
+				int i = left, j = middle, k = left;
+				while (i < middle && j < right)
+					scratch[k++] = (list[j].tick < list[i].tick ? list[j++] : list[i++]);
+				while (i < middle)
+					scratch[k++] = list[i++];
+				while (j < right)
+					scratch[k++] = list[j++];
+			}
+			TrackEvent* swap = list;
+			list = scratch;
+			scratch = swap;
+		}
+		delete[] scratch;
+
+		// the tempo changes are in order too (insertion sort, there are only a few)
+		for (int i = 1; i < numTempos; i++)
+		{
+			Tempo tempo = tempos[i];
+			int j = i;
+			for (; j > 0 && tempos[j - 1].tick > tempo.tick; j--)
+				tempos[j] = tempos[j - 1];
+			tempos[j] = tempo;
+		}
+
+		// time every event in samples, walking the tempo map alongside (in seconds, so rounding never accumulates)
+		events = new Event[count > 0 ? count : 1];
+		double seconds = 0.0;
+		long long tempoTick = 0;
+		int nextTempo = 0;
+		for (int i = 0; i < count; i++)
+		{
+			// take in the tempo changes up to the event (a timecode file ignores them)
+			while (nextTempo < numTempos && tempos[nextTempo].tick <= list[i].tick)
+			{
+				seconds += (tempos[nextTempo].tick - tempoTick) * secondsPerTick;
+				tempoTick = tempos[nextTempo].tick;
+				if (!timecode)
+					secondsPerTick = tempos[nextTempo].tempo / 1000000.0 / division;
+				nextTempo++;
+			}
+
+			Event& event = events[numEvents++];
+			event.time = (long long)((seconds + (list[i].tick - tempoTick) * secondsPerTick) * AUDIO_SAMPLE_RATE + 0.5);
+			event.status = list[i].status;
+			event.data1 = list[i].data1;
+			event.data2 = list[i].data2;
+		}
+	}
+
+	// done with the lists
+	delete[] list;
+	delete[] tempos;
+	return valid;
+}
+
+// macro cleanup
+#undef MIDI_META
+#undef MIDI_META_TEMPO
+#undef MIDI_META_END_OF_TRACK
+#undef MIDI_SYSEX
+#undef MIDI_SYSEX_ESCAPE
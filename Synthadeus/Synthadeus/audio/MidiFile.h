@@ -0,0 +1,93 @@
+////////////////////////////////////////////////////////////////////////////////
+//                                                                            //
+//   Midi File                                                                //
+//   Everett Moser                                                            //
+//   10-18-26                                                                 //
+//                                                                            //
+//   Reads a Standard Midi File (format 0 or 1) into one timeline of events   //
+//                                                                            //
+////////////////////////////////////////////////////////////////////////////////
+
+#pragma once
+
+#include "Error.h"
+#include "AudioDefines.h"
+
+// every track is merged into one list of channel events, timed in samples from the start of the file
+// (the tempo map is applied while loading, so playing it back is only a matter of counting samples)
+class MidiFile
+{
+public:
+
+	// the channel messages kept (the rest are skipped while reading)
+	enum Command { NOTE_OFF = 0x80, NOTE_ON = 0x90, CONTROL = 0xB0 };
+
+	// a channel message, and the sample it is due at
+	struct Event
+	{
+		long long time;
+		unsigned char status;
+		unsigned char data1;
+		unsigned char data2;
+	};
+
+private:
+
+	// the events, in the order they are due
+	Event* events;
+	int numEvents;
+
+	// the standard tempo until the file sets one (120 beats per minute)
+	const static int DEFAULT_TEMPO = 500000;
+
+	// a tempo change while reading (microseconds per quarter note from a tick onwards)
+	struct Tempo
+	{
+		long long tick;
+		int tempo;
+	};
+
+	// an event while reading, timed in ticks
+	struct TrackEvent
+	{
+		long long tick;
+		unsigned char status;
+		unsigned char data1;
+		unsigned char data2;
+	};
+
+	// append an event while reading, growing the list as needed
+	static void append(TrackEvent*& list, int& count, int& capacity, const TrackEvent& event);
+
+	// read one track's events and tempo changes (false if the track is malformed)
+	static bool readTrack(const unsigned char* data, size_t length,
+		TrackEvent*& list, int& count, int& capacity, Tempo*& tempos, int& numTempos, int& maxTempos);
+
+	// files own their events, so they are never copied
+	MidiFile(const MidiFile&);
+	MidiFile& operator=(const MidiFile&);
+
+public:
+
+	// an empty file
+	inline MidiFile() : events(NULL), numEvents(0) { }
+
+	// free the events
+	inline ~MidiFile() { clear(); }
+
+	// read a file from disk (false, leaving the file empty, if it can't be read)
+	bool load(const char* path);
+
+	// read a file already in memory
+	bool parse(const unsigned char* data, size_t length);
+
+	// free the events, leaving an empty file
+	void clear();
+
+	// the events, in the order they are due
+	inline int getNumEvents() { return numEvents; };
+	inline const Event& getEvent(int i) { return events[i]; };
+
+	// the sample the last event is due at (0 for an empty file)
+	inline long long getLength() { return (numEvents > 0 ? events[numEvents - 1].time : 0); };
+};
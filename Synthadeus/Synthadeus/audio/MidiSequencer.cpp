@@ -0,0 +1,30 @@
+#include "MidiSequencer.h"
+
+std::atomic<unsigned int> MidiSequencer::sequencersCreated(0);
+
+MidiSequencer::MidiSequencer(MidiFile* sequenceFile, bool takeOver)
+	: file(sequenceFile), ownsFile(takeOver), next(0), start(-1)
+{
+	// idiot test
+	assert(file != NULL);
+
+	// 0 is left for no sequencer at all
+	id = ++sequencersCreated;
+}
+
+bool MidiSequencer::nextEvent(long long frameStart, MidiFile::Event& event, int& offset)
+{
+	// nothing left, or not begun
+	if (next == file->getNumEvents() || start < 0)
+		return false;
+
+	// due within this frame? (late events, from starting partway through a frame, play at its start)
+	const MidiFile::Event& due = file->getEvent(next);
+	long long time = start + due.time - frameStart;
+	if (time >= AUDIO_FRAME_SIZE)
+		return false;
+	event = due;
+	offset = (time > 0 ? (int)time : 0);
+	next++;
+	return true;
+}
@@ -0,0 +1,73 @@
+////////////////////////////////////////////////////////////////////////////////
+//                                                                            //
+//   Midi Sequencer                                                           //
+//   Everett Moser                                                            //
+//   10-18-26                                                                 //
+//                                                                            //
+//   Plays a midi file's events against the engine's sample clock             //
+//                                                                            //
+////////////////////////////////////////////////////////////////////////////////
+
+#pragma once
+
+#include "Error.h"
+#include "AudioDefines.h"
+#include "MidiFile.h"
+
+#include <atomic>
+
+// the sequencer starts the file on the first frame it is played in, and from then on hands out each frame's
+// events with the sample within the frame they are due at (only the rendering thread plays it, see AudioEngine)
+class MidiSequencer
+{
+private:
+
+	// the file played, and whether the sequencer owns it
+	MidiFile* file;
+	bool ownsFile;
+
+	// the next event due
+	int next;
+
+	// the engine clock the file started at (-1 until it is first played)
+	long long start;
+
+	// tells sequencers apart, since a new one may well land where an old one was freed
+	unsigned int id;
+
+	// counts the sequencers created (by any thread, offline renders create them side by side)
+	static std::atomic<unsigned int> sequencersCreated;
+
+	// sequencers own their file, so they are never copied
+	MidiSequencer(const MidiSequencer&);
+	MidiSequencer& operator=(const MidiSequencer&);
+
+public:
+
+	// play a loaded file, taking it over (or only reading it, so several sequencers can play one file side by side)
+	MidiSequencer(MidiFile* sequenceFile, bool takeOver = true);
+
+	// free the file, if it was taken over
+	inline ~MidiSequencer() { if (ownsFile) delete file; };
+
+	// start the file at a sample of the engine clock, unless it has already started
+	inline void begin(long long clock) { if (start < 0) start = clock; };
+
+	// take the next event due within the frame starting at a sample of the engine clock, and the sample within the frame it is due at
+	// (false once the rest are due in later frames)
+	bool nextEvent(long long frameStart, MidiFile::Event& event, int& offset);
+
+	// whether every event has been played
+	inline bool isFinished() { return next == file->getNumEvents(); };
+
+	// where the sequencer is in its file (the next event due, and the clock it started at), or carry on from where another
+	// sequencer playing the same file is
+	inline void getPosition(int& nextEvent, long long& startClock) { nextEvent = next; startClock = start; };
+	inline void setPosition(int nextEvent, long long startClock) { next = nextEvent; start = startClock; };
+
+	// the sequencer's id, unique to it
+	inline unsigned int getId() { return id; };
+
+	// the file played
+	inline MidiFile* getFile() { return file; };
+};
@@ -0,0 +1,293 @@
+#include "OfflineRender.h"
+#include "MidiSequencer.h"
+
+#include <chrono>
+#include <thread>
+
+OfflineRender::OfflineRender(AudioGraphSnapshot** partGraphs, int partCount, int voiceThreads)
+	: numParts(partCount), format(WaveWriter::PCM16), dither(false), outputRate(AUDIO_SAMPLE_RATE), resampler(NULL), resampled(NULL),
+	  framesRendered(0), secondsTaken(0.0)
+{
+	// pre-rendering notes in the background would only compete with the render for the CPU
+	engine.setVoiceThreads(voiceThreads);
+	engine.setNoteRendering(false);
+
+	// a part per snapshot, played from the channel of the same number
+	for (int i = 0; i < partCount; i++)
+	{
+		graphs[i] = partGraphs[i]->acquire();
+		engine.addPart(graphs[i]);
+	}
+}
+
+OfflineRender::~OfflineRender()
+{
+	// the engine's parts hold their own
+	for (int i = 0; i < numParts; i++)
+		graphs[i]->release();
+}
+
+AudioWriter* OfflineRender::createWriter(const char* path)
+{
+	// compressed when asked for by name, a wave file otherwise
+	if (FlacWriter::isFlacPath(path))
+		return new FlacWriter();
+	return new WaveWriter();
+}
+
+bool OfflineRender::startResampling(int maxFrames)
+{
+	// nothing to do at the rate rendered
+	if (outputRate == AUDIO_SAMPLE_RATE)
+		return true;
+
+	// room for the most a block of frames or the end of the stream could make
+	resampler = new Resampler();
+	if (!resampler->setRates(AUDIO_SAMPLE_RATE, outputRate, AUDIO_CHANNELS))
+	{
+		delete resampler;
+		resampler = NULL;
+		return false;
+	}
+	int maxOutput = resampler->getMaxOutput(maxFrames);
+	if (maxOutput < resampler->getMaxOutput(resampler->getTaps()))
+		maxOutput = resampler->getMaxOutput(resampler->getTaps());
+	resampled = new float[maxOutput * AUDIO_CHANNELS];
+	return true;
+}
+
+bool OfflineRender::writeFrames(AudioWriter& writer, const float* frames, int count)
+{
+	// straight through at the rate rendered
+	if (!resampler)
+		return writer.write(frames, count);
+	int made = resampler->process(frames, count, resampled);
+	return writer.write(resampled, made);
+}
+
+bool OfflineRender::finishResampling(AudioWriter& writer)
+{
+	// the outputs still waiting on the filter's later taps
+	bool written = true;
+	if (resampler)
+		written = writer.write(resampled, resampler->finish(resampled));
+	stopResampling();
+	return written;
+}
+
+void OfflineRender::stopResampling()
+{
+	// free the converter without writing anything
+	delete resampler;
+	delete[] resampled;
+	resampler = NULL;
+	resampled = NULL;
+}
+
+bool OfflineRender::render(MidiFile* file, const char* path, float tail)
+{
+	// where it goes
+	framesRendered = 0;
+	secondsTaken = 0.0;
+	AudioWriter* writer = createWriter(path);
+	if (!startResampling(AUDIO_FRAME_SIZE) || !writer->open(path, AUDIO_CHANNELS, format, dither, outputRate))
+	{
+		stopResampling();
+		delete writer;
+		delete file;
+		return false;
+	}
+
+	// play it from the first frame
+	engine.start();
+	engine.play(new MidiSequencer(file));
+
+	// render frame after frame as fast as we can, until the file and then its tail are done
+	long long tailFrames = (long long)(tail * AUDIO_SAMPLE_RATE) / AUDIO_FRAME_SIZE;
+	float frame[AUDIO_FRAME_SIZE * 2];
+	bool written = true;
+	std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+	while (written && (engine.isPlaying() || tailFrames-- > 0))
+	{
+		engine.renderFrame(frame);
+		written = writeFrames(*writer, frame, AUDIO_FRAME_SIZE);
+	}
+	written = finishResampling(*writer) && written;
+	written = writer->close() && written;
+	secondsTaken = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+
+	// let go of the file, so the engine is ready for another one
+	engine.stop();
+	engine.play(NULL);
+	framesRendered = writer->getFramesWritten();
+	delete writer;
+	return written;
+}
+
+long long OfflineRender::countFrames(MidiFile* file)
+{
+	// the frame the last event is due in is the last one played (a file without events still plays one)
+	return file->getLength() / AUDIO_FRAME_SIZE + 1;
+}
+
+AudioEngine* OfflineRender::createChunkEngine(OfflineRender* myself, MidiFile* file)
+{
+	// one thread mixes everything, and notes are interpolated rather than pre-rendered
+	AudioEngine* engine = new AudioEngine();
+	engine->setVoiceThreads(0);
+	engine->setNoteRendering(false);
+	for (int i = 0; i < myself->numParts; i++)
+		engine->addPart(myself->graphs[i]);
+	engine->start();
+	engine->play(new MidiSequencer(file, false));
+	return engine;
+}
+
+void OfflineRender::scoutChunks(OfflineRender* myself, Chunks* chunks)
+{
+	// an engine of our own, only ever skipping (much faster than rendering, so we stay ahead of the threads)
+	AudioEngine* engine = createChunkEngine(myself, chunks->file);
+	for (int chunk = 0; chunk < chunks->numChunks; chunk++)
+	{
+		// wait for the chunk to be in flight (the slot's last chunk is written, so its start was picked up)
+		{
+			std::unique_lock<std::mutex> lock(chunks->mutex);
+			while (chunk >= chunks->written + chunks->numSlots)
+				chunks->wake.wait(lock);
+		}
+
+		// note where the chunk starts, then skip to the next one
+		engine->saveState(chunks->starts[chunk % chunks->numSlots]);
+		{
+			std::lock_guard<std::mutex> lock(chunks->mutex);
+			chunks->scouted = chunk + 1;
+		}
+		chunks->wake.notify_all();
+		for (int i = 0; i < CHUNK_FRAMES && chunk + 1 < chunks->numChunks; i++)
+			engine->skipFrame();
+	}
+
+	// done
+	engine->stop();
+	delete engine;
+}
+
+void OfflineRender::renderChunks(OfflineRender* myself, Chunks* chunks)
+{
+	// an engine of our own, taken to wherever each chunk starts
+	AudioEngine* engine = createChunkEngine(myself, chunks->file);
+	for (int chunk = chunks->next++; chunk < chunks->numChunks; chunk = chunks->next++)
+	{
+		// wait for a slot to render into, once the chunks before ours are written, and for where the chunk starts
+		int slot = chunk % chunks->numSlots;
+		{
+			std::unique_lock<std::mutex> lock(chunks->mutex);
+			while (chunk >= chunks->written + chunks->numSlots || chunk >= chunks->scouted)
+				chunks->wake.wait(lock);
+		}
+
+		// pick up from the chunk's start, then render it
+		long long first = (long long)chunk * CHUNK_FRAMES;
+		long long last = first + CHUNK_FRAMES;
+		if (last > chunks->totalFrames)
+			last = chunks->totalFrames;
+		engine->loadState(chunks->starts[slot]);
+		float* out = chunks->slots + (size_t)slot * CHUNK_FRAMES * AUDIO_FRAME_SIZE * 2;
+		for (long long frame = first; frame < last; frame++, out += AUDIO_FRAME_SIZE * 2)
+			engine->renderFrame(out);
+
+		// hand it to the writer
+		{
+			std::lock_guard<std::mutex> lock(chunks->mutex);
+			chunks->ready[slot] = chunk;
+		}
+		chunks->wake.notify_all();
+	}
+
+	// done
+	engine->stop();
+	delete engine;
+}
+
+bool OfflineRender::renderChunked(MidiFile* file, const char* path, float tail, int threads)
+{
+	// where it goes
+	framesRendered = 0;
+	secondsTaken = 0.0;
+	AudioWriter* writer = createWriter(path);
+	if (!startResampling(CHUNK_FRAMES * AUDIO_FRAME_SIZE) || !writer->open(path, AUDIO_CHANNELS, format, dither, outputRate))
+	{
+		stopResampling();
+		delete writer;
+		delete file;
+		return false;
+	}
+
+	// the whole timeline is known up front, so it can be split
+	Chunks* chunks = new Chunks();
+	chunks->file = file;
+	chunks->totalFrames = countFrames(file) + (long long)(tail * AUDIO_SAMPLE_RATE) / AUDIO_FRAME_SIZE;
+	chunks->numChunks = (int)((chunks->totalFrames + CHUNK_FRAMES - 1) / CHUNK_FRAMES);
+	chunks->next.store(0);
+	chunks->written = 0;
+	if (threads < 1)
+		threads = 1;
+	chunks->numSlots = threads * CHUNKS_PER_THREAD;
+	chunks->slots = new float[(size_t)chunks->numSlots * CHUNK_FRAMES * AUDIO_FRAME_SIZE * 2];
+	chunks->ready = new int[chunks->numSlots];
+	for (int i = 0; i < chunks->numSlots; i++)
+		chunks->ready[i] = -1;
+	chunks->starts = new AudioEngine::State[chunks->numSlots];
+	chunks->scouted = 0;
+
+	// the scout finds where each chunk starts and the threads render ahead from there, while we write the chunks out in order
+	std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+	std::thread scout(scoutChunks, this, chunks);
+	std::thread* workers = new std::thread[threads];
+	for (int i = 0; i < threads; i++)
+		workers[i] = std::thread(renderChunks, this, chunks);
+	bool written = true;
+	for (int chunk = 0; chunk < chunks->numChunks; chunk++)
+	{
+		// wait for it to be rendered
+		int slot = chunk % chunks->numSlots;
+		{
+			std::unique_lock<std::mutex> lock(chunks->mutex);
+			while (chunks->ready[slot] != chunk)
+				chunks->wake.wait(lock);
+		}
+
+		// write it, resampled in order as it would have been in one go (once the file fails, the rest are only waited for)
+		long long first = (long long)chunk * CHUNK_FRAMES;
+		long long frames = chunks->totalFrames - first;
+		if (frames > CHUNK_FRAMES)
+			frames = CHUNK_FRAMES;
+		float* in = chunks->slots + (size_t)slot * CHUNK_FRAMES * AUDIO_FRAME_SIZE * 2;
+		written = written && writeFrames(*writer, in, (int)frames * AUDIO_FRAME_SIZE);
+
+		// free up its slot
+		{
+			std::lock_guard<std::mutex> lock(chunks->mutex);
+			chunks->ready[slot] = -1;
+			chunks->written = chunk + 1;
+		}
+		chunks->wake.notify_all();
+	}
+	scout.join();
+	for (int i = 0; i < threads; i++)
+		workers[i].join();
+	delete[] workers;
+	written = finishResampling(*writer) && written;
+	written = writer->close() && written;
+	secondsTaken = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+
+	// done with the file as well
+	delete[] chunks->slots;
+	delete[] chunks->ready;
+	delete[] chunks->starts;
+	delete chunks;
+	delete file;
+	framesRendered = writer->getFramesWritten();
+	delete writer;
+	return written;
+}
@@ -0,0 +1,144 @@
+////////////////////////////////////////////////////////////////////////////////
+//                                                                            //
+//   Offline Render                                                           //
+//   Everett Moser                                                            //
+//   10-18-26                                                                 //
+//                                                                            //
+//   Renders parts playing a midi file to a wave file as fast as it can       //
+//                                                                            //
+////////////////////////////////////////////////////////////////////////////////
+
+#pragma once
+
+#include "Error.h"
+#include "AudioDefines.h"
+#include "AudioEngine.h"
+#include "MidiFile.h"
+#include "WaveWriter.h"
+#include "FlacWriter.h"
+#include "Resampler.h"
+
+#include <atomic>
+#include <mutex>
+#include <condition_variable>
+
+// a render has an engine of its own, playing snapshots of the graphs rather than the graphs themselves: a snapshot is never
+// changed once it is copied (bar the notes rendered from it, each set once), so renders on any number of threads, and the
+// engines of a chunked render, all hold the same ones (a loaded patch's) instead of copying the patch's buffers for each engine
+class OfflineRender
+{
+private:
+
+	// the engine mixing the parts (never shared with another render)
+	AudioEngine engine;
+
+	// the snapshot each part plays, held for the engines of a chunked render
+	AudioGraphSnapshot* graphs[AUDIO_PARTS];
+	int numParts;
+
+	// the samples written (16 bit undithered unless told otherwise, and only 16 or 24 bit into a FLAC file)
+	WaveWriter::Format format;
+	bool dither;
+
+	// the rate the files are written at, and the converter taking the rendered frames there (NULL when it is the rate rendered at)
+	int outputRate;
+	Resampler* resampler;
+	float* resampled;
+
+	// start converting to the output rate for a file, at most a number of frames at a time (false if the rates can't be converted)
+	bool startResampling(int maxFrames);
+
+	// write interleaved frames at the rate rendered, converted to the output rate on the way (false if the file couldn't take them)
+	bool writeFrames(AudioWriter& writer, const float* frames, int count);
+
+	// write whatever the converter still holds and free it (false if the file couldn't take it)
+	bool finishResampling(AudioWriter& writer);
+
+	// a writer for the kind of file a path names (.flac is compressed, anything else is a wave file)
+	static AudioWriter* createWriter(const char* path);
+
+	// free the converter, writing nothing (for a file that never opened)
+	void stopResampling();
+
+	// frames of the timeline in a chunk (~1.5 s), and chunks rendered ahead of the one being written
+	const static int CHUNK_FRAMES = 1024;
+	const static int CHUNKS_PER_THREAD = 2;
+
+	// a chunked render in progress, shared by its threads
+	struct Chunks
+	{
+		// the file every thread plays, the chunks of the timeline and how many frames they cover
+		MidiFile* file;
+		int numChunks;
+		long long totalFrames;
+
+		// the next chunk a thread takes on, and the next to be written
+		std::atomic<int> next;
+		int written;
+
+		// rendered chunks waiting to be written, a slot per chunk in flight (ready holds the chunk in each slot, -1 for none)
+		float* slots;
+		int* ready;
+		int numSlots;
+		std::mutex mutex;
+		std::condition_variable wake;
+
+		// where the engine is as each chunk in flight starts, a state per slot, and how many chunks' starts are known so far
+		AudioEngine::State* starts;
+		int scouted;
+	};
+
+	// an engine for a thread of a chunked render, playing the file (without taking it over) through the render's snapshots
+	static AudioEngine* createChunkEngine(OfflineRender* myself, MidiFile* file);
+
+	// the thread of a chunked render skipping through the file once, ahead of the others, noting where the engine is as each chunk starts
+	static void scoutChunks(OfflineRender* myself, Chunks* chunks);
+
+	// a thread of a chunked render, picking its own engine up from where each of its chunks starts
+	static void renderChunks(OfflineRender* myself, Chunks* chunks);
+
+	// frames a file plays for, until its last event
+	static long long countFrames(MidiFile* file);
+
+	// frames written, and how long rendering them took
+	long long framesRendered;
+	double secondsTaken;
+
+	// renders own their engine, so they are never copied
+	OfflineRender(const OfflineRender&);
+	OfflineRender& operator=(const OfflineRender&);
+
+public:
+
+	// a render of a number of parts, each playing a snapshot shared with whoever else holds it (none may be NULL)
+	OfflineRender(AudioGraphSnapshot** partGraphs, int partCount, int voiceThreads = AUDIO_VOICE_THREADS);
+
+	// let go of the snapshots
+	~OfflineRender();
+
+	// choose the format of the files written, and whether integer samples are dithered
+	inline void setFormat(WaveWriter::Format sampleFormat, bool dithered) { format = sampleFormat; dither = dithered; }
+
+	// choose the sample rate of the files written (rendering is always at the audio sample rate, anything else is resampled)
+	inline void setOutputRate(int sampleRate) { outputRate = sampleRate; }
+
+	// play a file through the parts into a wave file, and then a tail of seconds for whatever is still ringing (takes the file over)
+	bool render(MidiFile* file, const char* path, float tail);
+
+	// the same, with the timeline split into chunks rendered on a number of threads and written in order (one more thread
+	// only skips through the file, noting where every key and parameter is as each chunk starts, and each thread's engine
+	// picks up from there, so the chunks come out exactly as they would have in one go)
+	bool renderChunked(MidiFile* file, const char* path, float tail, int threads);
+
+	// frames written by the last render (at the output rate)
+	inline long long getFramesRendered() { return framesRendered; }
+
+	// seconds of audio written by the last render
+	inline double getSecondsRendered() { return (double)framesRendered / outputRate; }
+
+	// wall clock seconds the last render took
+	inline double getSecondsTaken() { return secondsTaken; }
+
+	// how many times faster than real time the last render went
+	inline double getRealTimeFactor() { return (secondsTaken > 0.0 ? getSecondsRendered() / secondsTaken : 0.0); }
+};
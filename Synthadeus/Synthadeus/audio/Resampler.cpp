@@ -0,0 +1,290 @@
+#include "Resampler.h"
+#include <math.h>
+#include <string.h>
+#include <limits.h>
+
+// SSE2 sums four taps at a time (always there on x64, and the default for 32 bit builds)
+#if defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+#define RESAMPLER_SSE2
+#include <emmintrin.h>
+#endif
+
+// stopband attenuation in dB, and the band kept as a fraction of the lower rate (20 kHz of 44.1k)
+#define RESAMPLER_ATTENUATION 100.0
+#define RESAMPLER_PASSBAND 0.4535
+
+// the filter is designed in double precision, so pi needs more digits than the float one
+#define RESAMPLER_PI 3.14159265358979323846
+
+// a dot product of a number of taps (a multiple of four)
+static inline float dotProduct(const float* a, const float* b, int count)
+{
+#ifdef RESAMPLER_SSE2
+	// four sums side by side, so each add needn't wait on the one before it
+	__m128 sum0 = _mm_setzero_ps();
+	__m128 sum1 = _mm_setzero_ps();
+	__m128 sum2 = _mm_setzero_ps();
+	__m128 sum3 = _mm_setzero_ps();
+	int i = 0;
+	for (; i + 16 <= count; i += 16)
+	{
+		sum0 = _mm_add_ps(sum0, _mm_mul_ps(_mm_loadu_ps(a + i), _mm_loadu_ps(b + i)));
+		sum1 = _mm_add_ps(sum1, _mm_mul_ps(_mm_loadu_ps(a + i + 4), _mm_loadu_ps(b + i + 4)));
+		sum2 = _mm_add_ps(sum2, _mm_mul_ps(_mm_loadu_ps(a + i + 8), _mm_loadu_ps(b + i + 8)));
+		sum3 = _mm_add_ps(sum3, _mm_mul_ps(_mm_loadu_ps(a + i + 12), _mm_loadu_ps(b + i + 12)));
+	}
+	for (; i < count; i += 4)
+		sum0 = _mm_add_ps(sum0, _mm_mul_ps(_mm_loadu_ps(a + i), _mm_loadu_ps(b + i)));
+	sum0 = _mm_add_ps(_mm_add_ps(sum0, sum1), _mm_add_ps(sum2, sum3));
+	sum0 = _mm_add_ps(sum0, _mm_movehl_ps(sum0, sum0));
+	sum0 = _mm_add_ss(sum0, _mm_shuffle_ps(sum0, sum0, 1));
+	return _mm_cvtss_f32(sum0);
+#else
+	float sum = 0.f;
+	for (int i = 0; i < count; i++)
+		sum += a[i] * b[i];
+	return sum;
+#endif
+}
+
+// two dot products sharing one set of taps, so stereo loads each coefficient once (a multiple of four)
+static inline void dotProducts(const float* a, const float* b, const float* taps, int count, float* out)
+{
+#ifdef RESAMPLER_SSE2
+	// two sums side by side for each, so each add needn't wait on the one before it
+	__m128 sumA0 = _mm_setzero_ps();
+	__m128 sumA1 = _mm_setzero_ps();
+	__m128 sumB0 = _mm_setzero_ps();
+	__m128 sumB1 = _mm_setzero_ps();
+	int i = 0;
+	for (; i + 8 <= count; i += 8)
+	{
+		__m128 tap0 = _mm_loadu_ps(taps + i);
+		__m128 tap1 = _mm_loadu_ps(taps + i + 4);
+		sumA0 = _mm_add_ps(sumA0, _mm_mul_ps(_mm_loadu_ps(a + i), tap0));
+		sumB0 = _mm_add_ps(sumB0, _mm_mul_ps(_mm_loadu_ps(b + i), tap0));
+		sumA1 = _mm_add_ps(sumA1, _mm_mul_ps(_mm_loadu_ps(a + i + 4), tap1));
+		sumB1 = _mm_add_ps(sumB1, _mm_mul_ps(_mm_loadu_ps(b + i + 4), tap1));
+	}
+	if (i < count)
+	{
+		__m128 tap0 = _mm_loadu_ps(taps + i);
+		sumA0 = _mm_add_ps(sumA0, _mm_mul_ps(_mm_loadu_ps(a + i), tap0));
+		sumB0 = _mm_add_ps(sumB0, _mm_mul_ps(_mm_loadu_ps(b + i), tap0));
+	}
+
+	// both horizontal sums at once, a in the low half and b in the high
+	sumA0 = _mm_add_ps(sumA0, sumA1);
+	sumB0 = _mm_add_ps(sumB0, sumB1);
+	__m128 pairs = _mm_add_ps(_mm_unpacklo_ps(sumA0, sumB0), _mm_unpackhi_ps(sumA0, sumB0));
+	pairs = _mm_add_ps(pairs, _mm_movehl_ps(pairs, pairs));
+	_mm_storel_pi((__m64*)out, pairs);
+#else
+	out[0] = dotProduct(a, taps, count);
+	out[1] = dotProduct(b, taps, count);
+#endif
+}
+
+// the zeroth order modified bessel function of the first kind, for the Kaiser window
+static double besselI0(double x)
+{
+	double sum = 1.0;
+	double term = 1.0;
+	for (int k = 1; k < 64 && term > sum * 1e-12; k++)
+	{
+		term *= (x / (2.0 * k)) * (x / (2.0 * k));
+		sum += term;
+	}
+	return sum;
+}
+
+static int greatestCommonDivisor(int a, int b)
+{
+	while (b != 0)
+	{
+		int r = a % b;
+		a = b;
+		b = r;
+	}
+	return a;
+}
+
+Resampler::Resampler()
+	: up(1), down(1), taps(0), delay(0), coefficients(NULL), channels(0), historyStart(0), inputs(0), fed(0), outputs(0)
+{
+	for (int i = 0; i < AUDIO_CHANNELS; i++)
+		histories[i] = NULL;
+}
+
+Resampler::~Resampler()
+{
+	delete[] coefficients;
+	for (int i = 0; i < AUDIO_CHANNELS; i++)
+		delete[] histories[i];
+}
+
+bool Resampler::setRates(int inputRate, int outputRate, int channelCount)
+{
+	// idiot test
+	assert(channelCount > 0 && channelCount <= AUDIO_CHANNELS);
+	if (inputRate <= 0 || outputRate <= 0)
+		return false;
+
+	// the ratio in its lowest terms
+	int divisor = greatestCommonDivisor(inputRate, outputRate);
+	if (outputRate / divisor > MAX_RATIO || inputRate / divisor > MAX_RATIO)
+	{
+		DebugPrintf("  [AUDIO] Can't resample %d Hz to %d Hz, their ratio is too fine\n", inputRate, outputRate);
+		return false;
+	}
+	up = outputRate / divisor;
+	down = inputRate / divisor;
+	channels = channelCount;
+
+	// the band kept and where it must be stopped by, in cycles per input, and taps enough to get from one to the other (Kaiser's estimate)
+	double lower = (double)(inputRate < outputRate ? inputRate : outputRate);
+	double pass = RESAMPLER_PASSBAND * lower / inputRate;
+	double stop = 0.5 * lower / inputRate;
+	taps = (int)ceil((RESAMPLER_ATTENUATION - 7.95) / (14.36 * (stop - pass)));
+	taps = (taps + 3) & ~3;
+	if (taps > MAX_TAPS)
+		taps = MAX_TAPS;
+
+	// a windowed sinc at the common rate, an odd length so its center lands on a sample (the last tap of the last phase is left zero)
+	int length = up * taps - 1;
+	delay = (length - 1) / 2;
+	double cutoff = 0.5 * (pass + stop) / up;
+	double beta = 0.1102 * (RESAMPLER_ATTENUATION - 8.7);
+	double windowScale = 1.0 / besselI0(beta);
+	double* prototype = new double[up * taps];
+	double sum = 0.0;
+	for (int n = 0; n < length; n++)
+	{
+		double x = (double)(n - delay);
+		double sinc = (n == delay ? 2.0 * cutoff : sin(2.0 * RESAMPLER_PI * cutoff * x) / (RESAMPLER_PI * x));
+		double edge = x / delay;
+		prototype[n] = sinc * besselI0(beta * sqrt(1.0 - edge * edge)) * windowScale;
+		sum += prototype[n];
+	}
+	prototype[length] = 0.0;
+
+	// split into phases, each scaled so the stuffed zeros don't take the gain with them
+	delete[] coefficients;
+	coefficients = new float[up * taps];
+	double scale = up / sum;
+	for (int phase = 0; phase < up; phase++)
+	{
+		for (int i = 0; i < taps; i++)
+			coefficients[phase * taps + i] = (float)(prototype[phase + (taps - 1 - i) * up] * scale);
+	}
+	delete[] prototype;
+
+	// a new stream, silent before its first input
+	for (int i = 0; i < AUDIO_CHANNELS; i++)
+	{
+		delete[] histories[i];
+		histories[i] = NULL;
+	}
+	for (int i = 0; i < channels; i++)
+	{
+		histories[i] = new float[taps - 1 + BLOCK_SIZE];
+		memset(histories[i], 0, (taps - 1) * sizeof(float));
+	}
+	historyStart = -(taps - 1);
+	inputs = 0;
+	fed = 0;
+	outputs = 0;
+	return true;
+}
+
+int Resampler::produce(float* out, long long limit)
+{
+	// each output sits somewhere between inputs at the common rate, the newest input it needs and its phase say where
+	int made = 0;
+	while (outputs < limit)
+	{
+		long long position = outputs * down + delay;
+		long long newest = position / up;
+		if (newest >= fed)
+			break;
+		const float* phase = coefficients + (position - newest * up) * taps;
+		int oldest = (int)(newest - (taps - 1) - historyStart);
+		if (channels == 2)
+			dotProducts(histories[0] + oldest, histories[1] + oldest, phase, taps, out + made * 2);
+		else
+		{
+			for (int c = 0; c < channels; c++)
+				out[made * channels + c] = dotProduct(histories[c] + oldest, phase, taps);
+		}
+		outputs++;
+		made++;
+	}
+	return made;
+}
+
+int Resampler::feed(const float* in, int frames, float* out, long long limit)
+{
+	// idiot test
+	assert(frames <= BLOCK_SIZE);
+
+	// after whatever is kept from before, a row per channel
+	int at = (int)(fed - historyStart);
+	for (int c = 0; c < channels; c++)
+	{
+		float* row = histories[c] + at;
+		if (in)
+		{
+			for (int i = 0; i < frames; i++)
+				row[i] = in[i * channels + c];
+		}
+		else
+			memset(row, 0, frames * sizeof(float));
+	}
+	fed += frames;
+	int made = produce(out, limit);
+
+	// the next output's newest input is at least the next one fed, so it needs no more than the last taps - 1
+	int keep = taps - 1;
+	int drop = (int)(fed - keep - historyStart);
+	for (int c = 0; c < channels; c++)
+		memmove(histories[c], histories[c] + drop, keep * sizeof(float));
+	historyStart = fed - keep;
+	return made;
+}
+
+int Resampler::process(const float* in, int frames, float* out)
+{
+	// idiot test
+	assert(coefficients && fed == inputs);
+
+	// a block at a time, through the same rows
+	int made = 0;
+	while (frames > 0)
+	{
+		int block = (frames < BLOCK_SIZE ? frames : BLOCK_SIZE);
+		inputs += block;
+		made += feed(in, block, out + made * channels, LLONG_MAX);
+		in += block * channels;
+		frames -= block;
+	}
+	return made;
+}
+
+int Resampler::finish(float* out)
+{
+	// idiot test
+	assert(coefficients);
+
+	// zeros past the end, until there is an output for every stretch of the inputs
+	long long total = (inputs * up + down - 1) / down;
+	int made = 0;
+	while (outputs < total)
+		made += feed(NULL, BLOCK_SIZE, out + made * channels, total);
+	return made;
+}
+
+// macro cleanup
+#undef RESAMPLER_SSE2
+#undef RESAMPLER_ATTENUATION
+#undef RESAMPLER_PASSBAND
+#undef RESAMPLER_PI
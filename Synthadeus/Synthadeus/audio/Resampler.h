@@ -0,0 +1,84 @@
+////////////////////////////////////////////////////////////////////////////////
+//                                                                            //
+//   Resampler                                                                //
+//   Everett Moser                                                            //
+//   10-18-26                                                                 //
+//                                                                            //
+//   Converts a stream of frames from one sample rate to another              //
+//                                                                            //
+////////////////////////////////////////////////////////////////////////////////
+
+#pragma once
+
+#include "Error.h"
+#include "AudioDefines.h"
+
+// a polyphase filter for a ratio of whole numbers (outputs per inputs, 147/320 from 96k to 44.1k): the input is
+// thought of as stuffed with zeros up to the common rate, low passed below the lower of the two nyquists and picked
+// every so often, but only the taps landing on real samples are ever multiplied, the same handful of phases over and over
+// (a Kaiser windowed sinc with ~100 dB of stopband, flat to 20 kHz of 44.1k, scaled to the lower of the two rates)
+class Resampler
+{
+private:
+
+	// the reduced ratio, the taps of each phase, and the delay of the filter at the common rate
+	int up;
+	int down;
+	int taps;
+	long long delay;
+
+	// the coefficients, a row of taps per phase ordered oldest input first, so each output is one dot product
+	float* coefficients;
+
+	// interleaved channels per frame
+	int channels;
+
+	// the inputs an output may still need (the last taps - 1) followed by the block being fed, a row per channel
+	// (histories[c][0] is input number historyStart, so the inputs before the first are zeros)
+	const static int BLOCK_SIZE = 1024;
+	float* histories[AUDIO_CHANNELS];
+	long long historyStart;
+
+	// inputs taken in, everything fed (the zeros flushing the end out as well), and the next output to make
+	long long inputs;
+	long long fed;
+	long long outputs;
+
+	// the biggest reduced ratio taken (the coefficients grow with it), and the most taps a phase may have
+	const static int MAX_RATIO = 1024;
+	const static int MAX_TAPS = 1024;
+
+	// make the outputs whose inputs are all in, but no more than a number of them (returns how many)
+	int produce(float* out, long long limit);
+
+	// feed a block of interleaved frames (NULL for zeros), making whatever outputs it can (returns how many)
+	int feed(const float* in, int frames, float* out, long long limit);
+
+	// resamplers own their filter, so they are never copied
+	Resampler(const Resampler&);
+	Resampler& operator=(const Resampler&);
+
+public:
+
+	// no rates yet
+	Resampler();
+
+	// free the filter
+	~Resampler();
+
+	// design the filter for a pair of rates and start a new stream (false if their ratio is too awkward to be exact)
+	bool setRates(int inputRate, int outputRate, int channelCount = AUDIO_CHANNELS);
+
+	// the most output frames a number of input frames can make
+	inline int getMaxOutput(int frames) { return (int)((long long)frames * up / down) + 2; }
+
+	// taps each output frame takes
+	inline int getTaps() { return taps; }
+
+	// convert interleaved frames, writing as many output frames as are ready (returns how many, see getMaxOutput)
+	// (outputs lag the inputs by half the filter, and line up with them exactly once the stream is finished)
+	int process(const float* in, int frames, float* out);
+
+	// flush the rest of the stream out, so the outputs cover every input (returns how many, at most getMaxOutput(getTaps()))
+	int finish(float* out);
+};
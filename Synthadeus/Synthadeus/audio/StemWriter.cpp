@@ -0,0 +1,147 @@
+#include "StemWriter.h"
+#include "WaveWriter.h"
+#include "FlacWriter.h"
+#include <stdio.h>
+#include <string.h>
+
+#include <thread>
+
+// print into a string, cut short if it doesn't fit
+#ifdef _WIN32
+#define STEM_PRINTF(out, size, ...) sprintf_s(out, size, __VA_ARGS__)
+#else
+#define STEM_PRINTF(out, size, ...) snprintf(out, size, __VA_ARGS__)
+#endif
+
+StemWriter::StemWriter()
+	: numStems(0), length(0)
+{
+}
+
+StemWriter::~StemWriter()
+{
+	// free the snapshots
+	for (int i = 0; i < numStems; i++)
+		stems[i].snapshot->release();
+}
+
+bool StemWriter::addStem(AudioNode* node, int id, const char* name)
+{
+	// idiot test
+	assert(node);
+	if (numStems == MAX_STEMS)
+	{
+		DebugPrintf("  [AUDIO] Only %d stems can be written at once\n", MAX_STEMS);
+		return false;
+	}
+
+	// a node that calculated nothing has nothing to write (every stem is padded to the longest, so it would be all silence)
+	if (node->getBufferSize() <= 0)
+	{
+		DebugPrintf("  [AUDIO] The %s has no samples to write as a stem\n", name);
+		return false;
+	}
+
+	// copy the node as it is now, and stretch every stem to the longest buffer
+	Stem& stem = stems[numStems++];
+	stem.snapshot = new AudioGraphSnapshot(node);
+	stem.id = id;
+	STEM_PRINTF(stem.name, sizeof(stem.name), "%s", name);
+	stem.path[0] = '\0';
+	if (stem.snapshot->getBufferSize() > length)
+		length = stem.snapshot->getBufferSize();
+	return true;
+}
+
+void StemWriter::nameStem(const char* path, int number, const char* name, int id, char* out, int size)
+{
+	// a lone stem goes to the path chosen
+	if (number == 0)
+	{
+		STEM_PRINTF(out, size, "%s", path);
+		return;
+	}
+
+	// the extension is whatever follows the last dot of the file's own name
+	const char* extension = strrchr(path, '.');
+	const char* folder = (strrchr(path, '/') > strrchr(path, '\\') ? strrchr(path, '/') : strrchr(path, '\\'));
+	if (!extension || extension < folder)
+		extension = path + strlen(path);
+	if (id >= 0)
+		STEM_PRINTF(out, size, "%.*s - %d %s (node %d)%s", (int)(extension - path), path, number, name, id, extension);
+	else
+		STEM_PRINTF(out, size, "%.*s - %d %s%s", (int)(extension - path), path, number, name, extension);
+}
+
+bool StemWriter::write(const char* path, AudioWriter::Format format, bool dithered, const std::atomic<bool>* cancelled,
+	std::atomic<int>* progress)
+{
+	// idiot test
+	assert(numStems > 0);
+	assert(length > 0);
+
+	// the cores are shared between the stems being compressed
+	int threads = (int)std::thread::hardware_concurrency() / numStems;
+	if (threads < 1)
+		threads = 1;
+
+	// a writer per stem, each creating the file named for it (numbered from 1, unless it is the only one)
+	AudioWriter* writers[MAX_STEMS];
+	int opened = 0;
+	bool written = true;
+	for (int i = 0; i < numStems && written; i++)
+	{
+		nameStem(path, (numStems > 1 ? i + 1 : 0), stems[i].name, stems[i].id, stems[i].path, MAX_PATH_LENGTH);
+		if (FlacWriter::isFlacPath(stems[i].path))
+			writers[i] = new FlacWriter(threads);
+		else
+			writers[i] = new WaveWriter();
+		opened++;
+		written = writers[i]->open(stems[i].path, AUDIO_CHANNELS, format, dithered);
+	}
+
+	// a block of every stem at a time, so they all move along together
+	float* left = new float[BLOCK_SIZE];
+	float* right = new float[BLOCK_SIZE];
+	float* block = new float[BLOCK_SIZE * AUDIO_CHANNELS];
+	for (int offset = 0; offset < length && written && !(cancelled && cancelled->load()); offset += BLOCK_SIZE)
+	{
+		int count = (length - offset < BLOCK_SIZE ? length - offset : BLOCK_SIZE);
+		for (int i = 0; i < numStems && written; i++)
+		{
+			// interleaved (a mono node is the same on both channels)
+			stems[i].snapshot->readL(offset, count, left);
+			stems[i].snapshot->readR(offset, count, right);
+			for (int j = 0; j < count; j++)
+			{
+				block[2 * j] = left[j];
+				block[2 * j + 1] = right[j];
+			}
+			written = writers[i]->write(block, count);
+		}
+		if (progress)
+			progress->store(offset + count);
+	}
+	delete[] left;
+	delete[] right;
+	delete[] block;
+
+	// the sizes are filled in once they are closed
+	for (int i = 0; i < opened; i++)
+	{
+		written = writers[i]->close() && written;
+		delete writers[i];
+	}
+
+	// a cancelled or failed export leaves nothing behind
+	if (!written || (cancelled && cancelled->load()))
+	{
+		for (int i = 0; i < opened; i++)
+			remove(stems[i].path);
+		return false;
+	}
+	return true;
+}
+
+// macro cleanup
+#undef STEM_PRINTF
@@ -0,0 +1,85 @@
+////////////////////////////////////////////////////////////////////////////////
+//                                                                            //
+//   Stem Writer                                                              //
+//   Everett Moser                                                            //
+//   10-18-26                                                                 //
+//                                                                            //
+//   Streams the buffers of any number of nodes, each to a file of its own    //
+//                                                                            //
+////////////////////////////////////////////////////////////////////////////////
+
+#pragma once
+
+#include "Error.h"
+#include "AudioDefines.h"
+#include "AudioGraphSnapshot.h"
+#include "AudioWriter.h"
+
+#include <atomic>
+
+// every node holds the buffer it calculated, so one evaluation of the graph leaves the inside of the patch there to
+// be heard as well as its output: a stem writer copies the buffers of the nodes tapped (an oscillator before the sum it
+// goes into, say) right after that evaluation, and streams them side by side, a block of each stem at a time,
+// into files named after one path, rather than recalculating the graph once for every stem
+class StemWriter
+{
+private:
+
+	// the most nodes tapped at once
+	const static int MAX_STEMS = 16;
+
+	// frames read out of every stem and handed to its writer at a time
+	const static int BLOCK_SIZE = 4096;
+
+	// the longest path a stem is written to
+	const static int MAX_PATH_LENGTH = 1024;
+
+	// a node tapped, as it was when it was added (the snapshot is held by the writer alone), and the file it goes to
+	struct Stem
+	{
+		AudioGraphSnapshot* snapshot;
+		int id;
+		char name[64];
+		char path[MAX_PATH_LENGTH];
+	};
+	Stem stems[MAX_STEMS];
+	int numStems;
+
+	// frames written for every stem (the longest buffer tapped, the shorter ones repeat like they do when played)
+	int length;
+
+	// stem writers own their snapshots, so they are never copied
+	StemWriter(const StemWriter&);
+	StemWriter& operator=(const StemWriter&);
+
+public:
+
+	// no stems yet
+	StemWriter();
+
+	// free the snapshots
+	~StemWriter();
+
+	// tap the calculated buffers of a node, copied right away so the graph is free to change afterwards (the name and the
+	// node's id in its patch, -1 for none, go into its file's name, false if the node has no samples or there are as many
+	// stems as can be written at once)
+	bool addStem(AudioNode* node, int id, const char* name);
+
+	// the nodes tapped
+	inline int getNumStems() { return numStems; }
+
+	// frames written for every stem
+	inline int getLength() { return length; }
+
+	// the file a stem was last written to
+	inline const char* getPath(int stem) { assert(stem >= 0 && stem < numStems); return stems[stem].path; }
+
+	// the file a stem is written to: the path itself for a lone stem, otherwise the path with the stem's number, name and
+	// id before its extension ('song.wav' has its second stem, oscillator 3 of the patch, in 'song - 2 Oscillator (node 3).wav')
+	static void nameStem(const char* path, int number, const char* name, int id, char* out, int size);
+
+	// write every stem to its own file named after a path, a wave file or a FLAC one going by its extension, updating the
+	// frames written as it goes and stopping once cancelled (false if it failed or was cancelled, leaving none of the files)
+	bool write(const char* path, AudioWriter::Format format, bool dithered, const std::atomic<bool>* cancelled = NULL,
+		std::atomic<int>* progress = NULL);
+};
@@ -0,0 +1,235 @@
+#include "WaveFile.h"
+#include <string.h>
+#include <limits.h>
+
+// SSE2 decodes 16 bit samples several at a time (always there on x64, and the default for 32 bit builds)
+#if defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+#define WAVE_FILE_SSE2
+#include <emmintrin.h>
+#endif
+
+// the scale from each integer format to floats from -1 to 1
+#define WAVE_SCALE_16 (1.f / 32768.f)
+#define WAVE_SCALE_24 (1.f / 8388608.f)
+#define WAVE_SCALE_32 (1.f / 2147483648.f)
+
+// the format tags of the format chunk (an extensible file keeps the real one in its subformat)
+#define WAVE_TAG_PCM 1
+#define WAVE_TAG_FLOAT 3
+#define WAVE_TAG_EXTENSIBLE 0xFFFE
+
+// read little endian numbers
+static inline unsigned int readShort(const unsigned char* at) { return at[0] | (at[1] << 8); }
+static inline unsigned int readInt(const unsigned char* at) { return at[0] | (at[1] << 8) | (at[2] << 16) | ((unsigned int)at[3] << 24); }
+
+WaveFile::WaveFile()
+	: data(NULL), stride(0), frames(0), channels(0), sampleRate(AUDIO_SAMPLE_RATE), format(WaveWriter::PCM16), references(1)
+{
+}
+
+WaveFile::~WaveFile()
+{
+	// the mapping closes itself
+}
+
+void WaveFile::release()
+{
+	// the last one out frees the file
+	if (--references == 0)
+		delete this;
+}
+
+bool WaveFile::load(const char* path)
+{
+	// idiot test
+	assert(!data);
+
+	// map the whole file, reading nothing yet
+	if (!mapping.openRead(path))
+	{
+		DebugPrintf("  [AUDIO] Could not open %s\n", path);
+		return false;
+	}
+
+	// find the samples
+	if (!readChunks(path))
+	{
+		mapping.close();
+		data = NULL;
+		frames = 0;
+		return false;
+	}
+	return true;
+}
+
+bool WaveFile::readChunks(const char* path)
+{
+	const unsigned char* file = (const unsigned char*)mapping.getMemory();
+	size_t size = mapping.getSize();
+
+	// a riff file of wave chunks
+	if (size < 12 || memcmp(file, "RIFF", 4) != 0 || memcmp(file + 8, "WAVE", 4) != 0)
+	{
+		DebugPrintf("  [AUDIO] %s is not a wave file\n", path);
+		return false;
+	}
+
+	// walk the chunks for the format and the samples (each chunk is padded to an even size)
+	int tag = 0;
+	int bits = 0;
+	size_t dataSize = 0;
+	size_t at = 12;
+	while (at + 8 <= size && !data)
+	{
+		const unsigned char* chunk = file + at;
+		size_t length = readInt(chunk + 4);
+		size_t left = size - at - 8;
+
+		// the format, with the real one of an extensible file in the first two bytes of its subformat
+		if (memcmp(chunk, "fmt ", 4) == 0 && length >= 16 && length <= left)
+		{
+			tag = readShort(chunk + 8);
+			channels = readShort(chunk + 10);
+			sampleRate = readInt(chunk + 12);
+			stride = readShort(chunk + 20);
+			bits = readShort(chunk + 22);
+			if (tag == WAVE_TAG_EXTENSIBLE && length >= 40)
+				tag = readShort(chunk + 32);
+		}
+
+		// the samples, running to the end of the file if the size was never filled in
+		else if (memcmp(chunk, "data", 4) == 0)
+		{
+			data = chunk + 8;
+			dataSize = (length > left || length == 0 ? left : length);
+		}
+		at += 8 + length + (length & 1);
+	}
+
+	// only the formats we write ourselves, in mono or stereo
+	if (tag == WAVE_TAG_PCM && bits == 16)
+		format = WaveWriter::PCM16;
+	else if (tag == WAVE_TAG_PCM && bits == 24)
+		format = WaveWriter::PCM24;
+	else if (tag == WAVE_TAG_PCM && bits == 32)
+		format = WaveWriter::PCM32;
+	else if (tag == WAVE_TAG_FLOAT && bits == 32)
+		format = WaveWriter::FLOAT32;
+	else
+		tag = 0;
+	if (!data || tag == 0 || (channels != 1 && channels != 2) || sampleRate <= 0 || stride != channels * WaveWriter::bytesFor(format))
+	{
+		DebugPrintf("  [AUDIO] %s is not a 16, 24 or 32 bit or float wave file in mono or stereo\n", path);
+		return false;
+	}
+
+	// every whole frame (as many as a buffer can hold)
+	size_t frameCount = dataSize / stride;
+	if (frameCount > INT_MAX)
+	{
+		DebugPrintf("  [AUDIO] %s is too long, only the start of it will play\n", path);
+		frameCount = INT_MAX;
+	}
+	frames = (int)frameCount;
+	return frames > 0;
+}
+
+float WaveFile::getSample(int channel, int frame)
+{
+	// the channel's bytes of the frame
+	if (channel >= channels)
+		channel = 0;
+	int bytes = WaveWriter::bytesFor(format);
+	const unsigned char* at = data + (size_t)frame * stride + channel * bytes;
+
+	// as stored
+	if (format == WaveWriter::PCM16)
+		return (short)readShort(at) * WAVE_SCALE_16;
+	if (format == WaveWriter::PCM24)
+		return ((int)((at[0] << 8) | (at[1] << 16) | ((unsigned int)at[2] << 24)) >> 8) * WAVE_SCALE_24;
+	unsigned int value = readInt(at);
+	if (format == WaveWriter::PCM32)
+		return (int)value * WAVE_SCALE_32;
+	float sample;
+	memcpy(&sample, &value, sizeof(float));
+	return sample;
+}
+
+void WaveFile::read16(const unsigned char* frame, int channel, int count, float* out)
+{
+	int i = 0;
+
+#ifdef WAVE_FILE_SSE2
+	__m128 scale = _mm_set1_ps(WAVE_SCALE_16);
+	if (channels == 1)
+	{
+		// eight samples at a time, sign extending each half of the shorts to ints
+		for (; i + 8 <= count; i += 8)
+		{
+			__m128i packed = _mm_loadu_si128((const __m128i*)(frame + i * 2));
+			__m128i low = _mm_srai_epi32(_mm_unpacklo_epi16(packed, packed), 16);
+			__m128i high = _mm_srai_epi32(_mm_unpackhi_epi16(packed, packed), 16);
+			_mm_storeu_ps(out + i, _mm_mul_ps(_mm_cvtepi32_ps(low), scale));
+			_mm_storeu_ps(out + i + 4, _mm_mul_ps(_mm_cvtepi32_ps(high), scale));
+		}
+	}
+	else
+	{
+		// four frames at a time, each an int holding the left sample in its low half and the right in its high half
+		// (loaded from the start of the frame either way, so nothing past the last frame is ever touched)
+		for (; i + 4 <= count; i += 4)
+		{
+			__m128i packed = _mm_loadu_si128((const __m128i*)(frame + i * 4));
+			__m128i samples = (channel ? _mm_srai_epi32(packed, 16) : _mm_srai_epi32(_mm_slli_epi32(packed, 16), 16));
+			_mm_storeu_ps(out + i, _mm_mul_ps(_mm_cvtepi32_ps(samples), scale));
+		}
+	}
+#endif
+
+	// the remainder
+	for (; i < count; i++)
+		out[i] = (short)readShort(frame + (size_t)i * stride + channel * 2) * WAVE_SCALE_16;
+}
+
+void WaveFile::read(int channel, int offset, int count, float* out)
+{
+	// idiot test
+	assert(offset >= 0 && offset + count <= frames);
+	if (channel >= channels)
+		channel = 0;
+
+	// 16 bit samples are the common case, and worth decoding several at a time
+	const unsigned char* frame = data + (size_t)offset * stride;
+	if (format == WaveWriter::PCM16)
+	{
+		read16(frame, channel, count, out);
+		return;
+	}
+
+	// the rest a sample at a time
+	const unsigned char* in = frame + channel * WaveWriter::bytesFor(format);
+	for (int i = 0; i < count; i++, in += stride)
+	{
+		if (format == WaveWriter::PCM24)
+		{
+			out[i] = ((int)((in[0] << 8) | (in[1] << 16) | ((unsigned int)in[2] << 24)) >> 8) * WAVE_SCALE_24;
+		}
+		else
+		{
+			unsigned int value = readInt(in);
+			if (format == WaveWriter::PCM32)
+				out[i] = (int)value * WAVE_SCALE_32;
+			else
+				memcpy(out + i, &value, sizeof(float));
+		}
+	}
+}
+
+// macro cleanup
+#undef WAVE_FILE_SSE2
+#undef WAVE_SCALE_16
+#undef WAVE_SCALE_24
+#undef WAVE_SCALE_32
+#undef WAVE_TAG_PCM
+#undef WAVE_TAG_FLOAT
+#undef WAVE_TAG_EXTENSIBLE
@@ -0,0 +1,91 @@
+////////////////////////////////////////////////////////////////////////////////
+//                                                                            //
+//   Wave File                                                                //
+//   Everett Moser                                                            //
+//   10-18-26                                                                 //
+//                                                                            //
+//   Reads samples straight out of a memory mapped wave file                  //
+//                                                                            //
+////////////////////////////////////////////////////////////////////////////////
+
+#pragma once
+
+#include "Error.h"
+#include "AudioDefines.h"
+#include "MappedFile.h"
+#include "WaveWriter.h"
+
+#include <atomic>
+
+// loading only maps the file and reads its header, so a file of any size opens at once, and only the pages of it
+// actually played are ever read from disk (by the OS, as they are touched)
+// a file is shared by every buffer viewing it, which each hold a reference, and frees itself once the last one lets go
+class WaveFile
+{
+private:
+
+	// the whole file, mapped for reading
+	MappedFile mapping;
+
+	// the first frame, and the bytes from one frame to the next
+	const unsigned char* data;
+	int stride;
+
+	// frames, interleaved channels (one or two), the rate they were recorded at, and how each sample is stored
+	int frames;
+	int channels;
+	int sampleRate;
+	WaveWriter::Format format;
+
+	// buffers (and whoever loaded the file) holding on to it
+	std::atomic<int> references;
+
+	// read the chunks of the file, finding its format and samples (false if it isn't a wave file we can play)
+	bool readChunks(const char* path);
+
+	// decode a run of 16 bit samples of a channel, from the frame they start in
+	void read16(const unsigned char* frame, int channel, int count, float* out);
+
+	// freed by the last release, never directly
+	~WaveFile();
+
+	// files own their mapping, so they are never copied
+	WaveFile(const WaveFile&);
+	WaveFile& operator=(const WaveFile&);
+
+public:
+
+	// nothing loaded yet (always made with new, and holding one reference for whoever made it)
+	WaveFile();
+
+	// map a file from disk and read its header (false if it can't be played)
+	bool load(const char* path);
+
+	// hold on to the file
+	inline void retain() { references++; }
+
+	// let go of the file, freeing it if no one else holds it
+	void release();
+
+	// frames of audio held
+	inline int getFrames() { return frames; }
+
+	// interleaved channels per frame (one or two)
+	inline int getChannels() { return channels; }
+
+	// the rate the file was recorded at
+	inline int getSampleRate() { return sampleRate; }
+
+	// how each sample is stored
+	inline WaveWriter::Format getFormat() { return format; }
+
+	// the size of the whole file, and when it was last written (together they tell an edited file from the one loaded)
+	inline size_t getFileSize() { return mapping.getSize(); }
+	inline long long getModified() { return mapping.getModified(); }
+
+	// decode a single sample of a channel (the second channel of a mono file is the first)
+	float getSample(int channel, int frame);
+
+	// decode a run of samples of a channel as floats from -1 to 1 (no wrapping)
+	void read(int channel, int offset, int count, float* out);
+};
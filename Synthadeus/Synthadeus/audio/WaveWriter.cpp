@@ -0,0 +1,330 @@
+#include "WaveWriter.h"
+#include <math.h>
+#include <string.h>
+
+// SSE2 converts four samples at a time (always there on x64, and the default for 32 bit builds)
+#if defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+#define WAVE_WRITER_SSE2
+#include <emmintrin.h>
+#endif
+
+// the largest float below 2^31, where 32 bit samples are clipped (2147483647 itself rounds up to 2^31, which wraps)
+#define WAVE_PEAK_32 2147483520.f
+
+// the subformats of an extensible wave file (KSDATAFORMAT_SUBTYPE_PCM and _IEEE_FLOAT), the tag first
+static const unsigned char subformatTail[14] = { 0x00, 0x00, 0x00, 0x00, 0x10, 0x00, 0x80, 0x00, 0x00, 0xAA, 0x00, 0x38, 0x9B, 0x71 };
+
+// step a xorshift generator
+static inline unsigned int nextNoise(unsigned int& x)
+{
+	x ^= x << 13;
+	x ^= x >> 17;
+	x ^= x << 5;
+	return x;
+}
+
+// the top 23 bits of a random number as a float from 1 up to 2
+static inline float noiseToFloat(unsigned int x)
+{
+	unsigned int bits = (x >> 9) | 0x3F800000;
+	float value;
+	memcpy(&value, &bits, sizeof(float));
+	return value;
+}
+
+WaveWriter::WaveWriter()
+	: file(NULL), channels(AUDIO_CHANNELS), format(PCM16), framesWritten(0), headerSize(PCM_HEADER_SIZE), filling(0), filled(0),
+	  pending(-1), pendingBytes(0), diskQuit(false), diskFailed(false), dither(false)
+{
+	// the buffers are only allocated once a file is opened
+	buffers[0] = NULL;
+	buffers[1] = NULL;
+	setFormat(PCM16, false);
+}
+
+WaveWriter::~WaveWriter()
+{
+	// finish up, then free the buffers
+	close();
+	delete[] buffers[0];
+	delete[] buffers[1];
+}
+
+void WaveWriter::putLittleEndian(unsigned char* at, unsigned int value, int bytes)
+{
+	// lowest byte first
+	for (int i = 0; i < bytes; i++)
+		at[i] = (unsigned char)(value >> (8 * i));
+}
+
+void WaveWriter::setFormat(Format sampleFormat, bool dithered)
+{
+	// idiot test
+	assert(sampleFormat >= PCM16 && sampleFormat < FORMATS);
+	format = sampleFormat;
+	dither = dithered;
+
+	// the same noise every time, so a dithered render is as repeatable as any other (each lane must start nonzero)
+	noise[0] = 0x9E3779B9;
+	noise[1] = 0x85EBCA6B;
+	noise[2] = 0xC2B2AE35;
+	noise[3] = 0x27D4EB2F;
+}
+
+void WaveWriter::quantize(const float* in, int count, int bits, int* out)
+{
+	// the largest magnitude (symmetric, so -1 and 1 land the same distance from 0), and where samples are clipped
+	float scale = (float)((1u << (bits - 1)) - 1);
+	float peak = (bits < 32 ? scale : WAVE_PEAK_32);
+
+	// dither is only worth it below 32 bits (a float doesn't even hold a 32 bit step)
+	bool dithered = (dither && bits < 32);
+	int i = 0;
+
+#ifdef WAVE_WRITER_SSE2
+	// four samples at a time, dithered and clipped before converting so nothing wraps (rounding to the nearest, as lrintf does)
+	__m128 scales = _mm_set1_ps(scale);
+	__m128 highest = _mm_set1_ps(peak);
+	__m128 lowest = _mm_set1_ps(-peak);
+	__m128i state = _mm_loadu_si128((const __m128i*)noise);
+	__m128i mantissa = _mm_set1_epi32(0x3F800000);
+	for (; i + 4 <= count; i += 4)
+	{
+		__m128 samples = _mm_mul_ps(_mm_loadu_ps(in + i), scales);
+		if (dithered)
+		{
+			// the difference of two uniform numbers in [1, 2) is triangular noise of a step either way
+			__m128 uniform[2];
+			for (int j = 0; j < 2; j++)
+			{
+				state = _mm_xor_si128(state, _mm_slli_epi32(state, 13));
+				state = _mm_xor_si128(state, _mm_srli_epi32(state, 17));
+				state = _mm_xor_si128(state, _mm_slli_epi32(state, 5));
+				uniform[j] = _mm_castsi128_ps(_mm_or_si128(_mm_srli_epi32(state, 9), mantissa));
+			}
+			samples = _mm_add_ps(samples, _mm_sub_ps(uniform[0], uniform[1]));
+		}
+		samples = _mm_max_ps(_mm_min_ps(samples, highest), lowest);
+		_mm_storeu_si128((__m128i*)(out + i), _mm_cvtps_epi32(samples));
+	}
+	_mm_storeu_si128((__m128i*)noise, state);
+#endif
+
+	// the remainder, dithered from the first lane and clipped the same way (a NaN ends up at the peak either way)
+	for (; i < count; i++)
+	{
+		float sample = in[i] * scale;
+		if (dithered)
+		{
+			float first = noiseToFloat(nextNoise(noise[0]));
+			sample += first - noiseToFloat(nextNoise(noise[0]));
+		}
+		sample = (sample < peak ? sample : peak);
+		sample = (sample > -peak ? sample : -peak);
+		out[i] = (int)lrintf(sample);
+	}
+}
+
+void WaveWriter::convert(const float* in, int count, unsigned char* out)
+{
+	// floats are written as they are, whatever their range
+	if (format == FLOAT32)
+	{
+		for (int i = 0; i < count; i++)
+		{
+			unsigned int bits;
+			memcpy(&bits, in + i, sizeof(float));
+			putLittleEndian(out + i * 4, bits, 4);
+		}
+		return;
+	}
+
+	// integers are quantized a block at a time, then packed into as many bytes as the format takes
+	int bytes = bytesFor(format);
+	int quantized[CONVERT_SIZE];
+	while (count > 0)
+	{
+		int block = (count < CONVERT_SIZE ? count : CONVERT_SIZE);
+		quantize(in, block, bytes * 8, quantized);
+		for (int i = 0; i < block; i++)
+		{
+			for (int j = 0; j < bytes; j++)
+				out[j] = (unsigned char)((unsigned int)quantized[i] >> (8 * j));
+			out += bytes;
+		}
+		in += block;
+		count -= block;
+	}
+}
+
+bool WaveWriter::open(const char* path, int channelCount, Format sampleFormat, bool dithered, int sampleRate)
+{
+	// idiot test
+	assert(channelCount > 0 && sampleRate > 0);
+	close();
+	channels = channelCount;
+	setFormat(sampleFormat, dithered);
+	framesWritten = 0;
+
+	// create the file
+#ifdef _WIN32
+	fopen_s(&file, path, "wb");
+#else
+	file = fopen(path, "wb");
+#endif
+	if (!file)
+	{
+		DebugPrintf("  [AUDIO] Could not create %s\n", path);
+		return false;
+	}
+
+	// riff header, format chunk, then the data chunk (the sizes are filled in on close)
+	// 16 bit files are plain PCM for anything to read, the rest spell out their format the extensible way
+	int bytes = bytesFor(format);
+	bool extensible = (format != PCM16);
+	headerSize = (extensible ? EXTENSIBLE_HEADER_SIZE : PCM_HEADER_SIZE);
+	unsigned char header[EXTENSIBLE_HEADER_SIZE] = { 'R', 'I', 'F', 'F', 0, 0, 0, 0, 'W', 'A', 'V', 'E', 'f', 'm', 't', ' ' };
+	putLittleEndian(header + 16, (extensible ? 40 : 16), 4);
+	putLittleEndian(header + 20, (extensible ? 0xFFFE : 1), 2);
+	putLittleEndian(header + 22, channels, 2);
+	putLittleEndian(header + 24, sampleRate, 4);
+	putLittleEndian(header + 28, sampleRate * channels * bytes, 4);
+	putLittleEndian(header + 32, channels * bytes, 2);
+	putLittleEndian(header + 34, bytes * 8, 2);
+	unsigned char* data = header + 36;
+	if (extensible)
+	{
+		// every bit valid, the speakers of mono or stereo (none in particular past that), then the subformat
+		putLittleEndian(header + 36, 22, 2);
+		putLittleEndian(header + 38, bytes * 8, 2);
+		putLittleEndian(header + 40, (channels == 1 ? 0x4 : (channels == 2 ? 0x3 : 0)), 4);
+		putLittleEndian(header + 44, (format == FLOAT32 ? 3 : 1), 2);
+		memcpy(header + 46, subformatTail, sizeof(subformatTail));
+		data = header + 60;
+	}
+	memcpy(data, "data", 4);
+	putLittleEndian(data + 4, 0, 4);
+	if (fwrite(header, 1, headerSize, file) != (size_t)headerSize)
+	{
+		fclose(file);
+		file = NULL;
+		return false;
+	}
+
+	// the double buffer, and the thread writing it out
+	if (!buffers[0])
+	{
+		buffers[0] = new unsigned char[BUFFER_BYTES];
+		buffers[1] = new unsigned char[BUFFER_BYTES];
+	}
+	filling = 0;
+	filled = 0;
+	pending = -1;
+	diskQuit = false;
+	diskFailed = false;
+	diskWriter = std::thread(writeToDisk, this);
+	return true;
+}
+
+void WaveWriter::writeToDisk(WaveWriter* myself)
+{
+	std::unique_lock<std::mutex> lock(myself->diskMutex);
+	while (true)
+	{
+		// sleep until there is a half to write (or we are told to stop once everything is written)
+		while (myself->pending < 0 && !myself->diskQuit)
+			myself->diskWake.wait(lock);
+		if (myself->pending < 0)
+			return;
+
+		// write it without holding the lock, so the other half keeps filling
+		int half = myself->pending;
+		int count = myself->pendingBytes;
+		lock.unlock();
+		bool written = (fwrite(myself->buffers[half], 1, count, myself->file) == (size_t)count);
+		lock.lock();
+
+		// hand it back
+		myself->diskFailed = myself->diskFailed || !written;
+		myself->pending = -1;
+		myself->diskWake.notify_all();
+	}
+}
+
+bool WaveWriter::flush()
+{
+	// wait for the disk writer to be done with the other half, then hand it this one
+	std::unique_lock<std::mutex> lock(diskMutex);
+	while (pending >= 0)
+		diskWake.wait(lock);
+	if (diskFailed)
+		return false;
+	if (filled > 0)
+	{
+		pending = filling;
+		pendingBytes = filled;
+		diskWake.notify_all();
+		filling = 1 - filling;
+		filled = 0;
+	}
+	return true;
+}
+
+bool WaveWriter::write(const float* samples, int frames)
+{
+	// idiot test
+	if (!file || framesWritten + frames > getMaxFrames())
+		return false;
+
+	// convert straight into the half being filled, handing it over whenever it can't take another sample
+	int bytes = bytesFor(format);
+	int total = frames * channels;
+	while (total > 0)
+	{
+		int count = (BUFFER_BYTES - filled) / bytes;
+		if (count > total)
+			count = total;
+		convert(samples, count, buffers[filling] + filled);
+		filled += count * bytes;
+		samples += count;
+		total -= count;
+		if (BUFFER_BYTES - filled < bytes && !flush())
+			return false;
+	}
+	framesWritten += frames;
+	return true;
+}
+
+bool WaveWriter::close()
+{
+	// nothing open
+	if (!file)
+		return false;
+
+	// write whatever is left, and wait for the disk writer to finish
+	bool valid = flush();
+	{
+		std::lock_guard<std::mutex> lock(diskMutex);
+		diskQuit = true;
+	}
+	diskWake.notify_all();
+	diskWriter.join();
+	valid = valid && !diskFailed;
+
+	// fill in the sizes now that they are known (the data's is the last thing in the header)
+	unsigned int dataSize = (unsigned int)(framesWritten * channels * bytesFor(format));
+	unsigned char size[4];
+	putLittleEndian(size, dataSize + headerSize - 8, 4);
+	valid = valid && fseek(file, RIFF_SIZE_OFFSET, SEEK_SET) == 0 && fwrite(size, 1, 4, file) == 4;
+	putLittleEndian(size, dataSize, 4);
+	valid = valid && fseek(file, headerSize - 4, SEEK_SET) == 0 && fwrite(size, 1, 4, file) == 4;
+
+	// done
+	valid = (fclose(file) == 0 && valid);
+	file = NULL;
+	return valid;
+}
+
+// macro cleanup
+#undef WAVE_WRITER_SSE2
+#undef WAVE_PEAK_32
@@ -0,0 +1,114 @@
+////////////////////////////////////////////////////////////////////////////////
+//                                                                            //
+//   Wave Writer                                                              //
+//   Everett Moser                                                            //
+//   10-18-26                                                                 //
+//                                                                            //
+//   Streams rendered frames to a wave file as they are rendered              //
+//                                                                            //
+////////////////////////////////////////////////////////////////////////////////
+
+#pragma once
+
+#include "Error.h"
+#include "AudioDefines.h"
+#include "AudioWriter.h"
+#include <stdio.h>
+
+#include <thread>
+#include <mutex>
+#include <condition_variable>
+
+// the header is written with empty sizes when opened, and the sizes filled in once closed, so a render of any length
+// never has to be held in memory: samples are converted into one half of a double buffer while a thread of the writer's
+// own writes the other half to disk, and the memory used is the same however long the file gets
+// (16 bit is a plain PCM file, the other formats are WAVE_FORMAT_EXTENSIBLE)
+class WaveWriter : public AudioWriter
+{
+private:
+
+	// the file being written (NULL when closed)
+	FILE* file;
+
+	// interleaved channels per frame, and how each sample is written
+	int channels;
+	Format format;
+
+	// frames written so far
+	long long framesWritten;
+
+	// size of the header (with the offsets of the two sizes filled in on close)
+	const static int PCM_HEADER_SIZE = 44;
+	const static int EXTENSIBLE_HEADER_SIZE = 68;
+	const static int RIFF_SIZE_OFFSET = 4;
+	int headerSize;
+
+	// the most frames a wave file's 32 bit sizes can describe
+	inline long long getMaxFrames() { return (0xFFFFFFFFLL - headerSize) / (bytesFor(format) * channels); }
+
+	// bytes in each half of the double buffer (256 KB), and samples converted at a time on the way in
+	const static int BUFFER_BYTES = 256 * 1024;
+	const static int CONVERT_SIZE = 1024;
+
+	// the two halves, the one being filled and how much of it is
+	unsigned char* buffers[2];
+	int filling;
+	int filled;
+
+	// writes the halves handed to it (the one waiting, -1 for none, and how many bytes it holds)
+	std::thread diskWriter;
+	std::mutex diskMutex;
+	std::condition_variable diskWake;
+	int pending;
+	int pendingBytes;
+	bool diskQuit;
+	bool diskFailed;
+
+	// the disk writer's thread
+	static void writeToDisk(WaveWriter* myself);
+
+	// hand the half being filled to the disk writer, once it is done with the other (false if writing has failed)
+	bool flush();
+
+	// whether integer samples get triangular (TPDF) dither of one step before rounding, and the generator it comes from
+	// (four xorshift generators side by side, so four samples are dithered at once)
+	bool dither;
+	unsigned int noise[4];
+
+	// write a little endian number of bytes
+	static void putLittleEndian(unsigned char* at, unsigned int value, int bytes);
+
+	// writers own their file, so they are never copied
+	WaveWriter(const WaveWriter&);
+	WaveWriter& operator=(const WaveWriter&);
+
+public:
+
+	// nothing open yet
+	WaveWriter();
+
+	// close the file if it is still open, and free the buffers
+	virtual ~WaveWriter();
+
+	// choose how samples are converted, without opening a file (open chooses as well)
+	void setFormat(Format sampleFormat, bool dithered);
+
+	// create a wave file of frames at a sample rate and write its header
+	virtual bool open(const char* path, int channelCount = AUDIO_CHANNELS, Format sampleFormat = PCM16, bool dithered = false,
+		int sampleRate = AUDIO_SAMPLE_RATE);
+
+	// append interleaved frames, clipped to the format (false if the file couldn't take them)
+	virtual bool write(const float* samples, int frames);
+
+	// fill in the sizes and close the file (false if it couldn't be finished)
+	virtual bool close();
+
+	// frames written so far
+	inline virtual long long getFramesWritten() { return framesWritten; }
+
+	// convert samples to little endian samples of the format, clipping integers (NaN too) and rounding them to the nearest
+	void convert(const float* in, int count, unsigned char* out);
+
+	// scale, clip and round samples to integers of a number of bits, dithering them if asked to (whatever the format chosen)
+	void quantize(const float* in, int count, int bits, int* out);
+};
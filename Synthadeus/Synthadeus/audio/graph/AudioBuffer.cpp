@@ -0,0 +1,330 @@
+#include "AudioBuffer.h"
+#include "WaveFile.h"
+#include <string.h>
+#include <math.h>
+#include <limits.h>
+
+// SSE2 is all the decoder needs (always there on x64, and the default for 32 bit builds)
+#if defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+#define AUDIO_BUFFER_SSE2
+#include <emmintrin.h>
+#endif
+
+// largest compact sample magnitude
+#define COMPACT_PEAK 32767.f
+
+AudioBuffer::Storage* AudioBuffer::reserve(size_t bytes)
+{
+	// held by the one buffer taking it, for now
+	Storage* reserved = new Storage();
+	reserved->file = NULL;
+	reserved->references = 1;
+
+#ifdef AUDIO_SPILL_THRESHOLD
+	// large enough to spill to a temporary file
+	if (bytes >= AUDIO_SPILL_THRESHOLD)
+	{
+		reserved->file = new MappedFile();
+		if (reserved->file->createTemporary(bytes))
+		{
+			reserved->memory = (char*)reserved->file->getMemory();
+			return reserved;
+		}
+
+		// no file to be had, so the heap will have to do
+		DebugPrintf("  [AUDIO] Could not spill %u bytes to a temporary file.\n", (unsigned)bytes);
+		delete reserved->file;
+		reserved->file = NULL;
+	}
+#endif
+
+	// otherwise the heap
+	reserved->memory = new char[bytes];
+	return reserved;
+}
+
+void AudioBuffer::free(Storage* shared)
+{
+	// still read by another buffer
+	if (--shared->references > 0)
+		return;
+
+	// closing the file frees the mapping, otherwise it is heap memory
+	if (shared->file)
+		delete shared->file;
+	else
+		delete[] shared->memory;
+	delete shared;
+}
+
+void AudioBuffer::placeCompact(char* block)
+{
+	// the scales go first, keeping them aligned
+	scales = (float*)block;
+	mantissas = (short*)(block + sizeof(float) * blocksFor(size));
+}
+
+void AudioBuffer::allocate(int sampleCount)
+{
+	// keep the memory if it is already the right shape, and no copy still reads it
+	if (samples && size == sampleCount && storage->references.load() == 1)
+		return;
+
+	// otherwise start over
+	release();
+	if (sampleCount <= 0)
+		return;
+	storage = reserve(bytesFor(sampleCount));
+	samples = (float*)storage->memory;
+	size = sampleCount;
+}
+
+void AudioBuffer::release()
+{
+	// let go of whichever storage is in use, or of the file viewed
+	if (storage)
+		free(storage);
+	if (wave)
+		wave->release();
+	wave = NULL;
+	storage = NULL;
+	samples = NULL;
+	mantissas = NULL;
+	scales = NULL;
+	size = 0;
+}
+
+void AudioBuffer::view(WaveFile* waveFile, int channel, AudioPosition step)
+{
+	// hold on to the file for as long as it is viewed
+	waveFile->retain();
+	release();
+	wave = waveFile;
+	waveChannel = channel;
+	waveStep = step;
+
+	// a sample per frame, or however many it takes to play them all at the rate
+	AudioPosition length = ((AudioPosition)wave->getFrames() << 32) / step;
+	size = (length < 1 ? 1 : (length > INT_MAX ? INT_MAX : (int)length));
+}
+
+float AudioBuffer::getViewed(int i)
+{
+	// straight from the file
+	if (waveStep == AUDIO_POSITION_ONE)
+		return wave->getSample(waveChannel, i);
+
+	// or between the frames either side (the last frame of the file is simply held)
+	AudioPosition position = (AudioPosition)i * waveStep;
+	int lower = AUDIO_POSITION_SAMPLE(position);
+	int upper = (lower + 1 < wave->getFrames() ? lower + 1 : lower);
+	float sample = wave->getSample(waveChannel, lower);
+	return sample + (wave->getSample(waveChannel, upper) - sample) * AUDIO_POSITION_FRACTION(position);
+}
+
+void AudioBuffer::readInterpolated(int offset, int count, float* out)
+{
+	// read more than a frame apart, only the frames either side of each sample are decoded (the last frame is simply held)
+	int frames = wave->getFrames();
+	if (waveStep >= 2 * AUDIO_POSITION_ONE)
+	{
+		AudioPosition t = (AudioPosition)offset * waveStep;
+		for (int j = 0; j < count; j++, t += waveStep)
+		{
+			int lower = AUDIO_POSITION_SAMPLE(t);
+			float sample = wave->getSample(waveChannel, lower);
+			float next = (lower + 1 < frames ? wave->getSample(waveChannel, lower + 1) : sample);
+			out[j] = sample + (next - sample) * AUDIO_POSITION_FRACTION(t);
+		}
+		return;
+	}
+
+	// otherwise as many samples at a time as a block of frames covers
+	int maxRun = (int)(((AudioPosition)(VIEW_BLOCK_SIZE - 2) << 32) / waveStep) + 1;
+	float source[VIEW_BLOCK_SIZE + 1];
+	AudioPosition position = (AudioPosition)offset * waveStep;
+	while (count > 0)
+	{
+		int run = (count < maxRun ? count : maxRun);
+
+		// the first frame and one past the last one interpolated (the last frame of the file is simply held)
+		int first = AUDIO_POSITION_SAMPLE(position);
+		int last = AUDIO_POSITION_SAMPLE(position + waveStep * (run - 1)) + 2;
+		if (last > frames)
+		{
+			last = frames;
+			wave->read(waveChannel, first, last - first, source);
+			source[last - first] = source[last - first - 1];
+		}
+		else
+			wave->read(waveChannel, first, last - first, source);
+
+		// linear interpolation between the frames either side of each sample (each position is worked out on its own, like a note's)
+		for (int j = 0; j < run; j++)
+		{
+			AudioPosition t = position + j * waveStep;
+			int i = AUDIO_POSITION_SAMPLE(t) - first;
+			out[j] = source[i] + (source[i + 1] - source[i]) * AUDIO_POSITION_FRACTION(t);
+		}
+		position += run * waveStep;
+		out += run;
+		count -= run;
+	}
+}
+
+void AudioBuffer::decode(const short* in, float scale, int count, float* out)
+{
+	int i = 0;
+
+#ifdef AUDIO_BUFFER_SSE2
+	// eight samples at a time
+	__m128 scale4 = _mm_set1_ps(scale);
+	for (; i + 8 <= count; i += 8)
+	{
+		// sign extend each half of the shorts to ints
+		__m128i packed = _mm_loadu_si128((const __m128i*)(in + i));
+		__m128i low = _mm_srai_epi32(_mm_unpacklo_epi16(packed, packed), 16);
+		__m128i high = _mm_srai_epi32(_mm_unpackhi_epi16(packed, packed), 16);
+
+		// convert and scale them
+		_mm_storeu_ps(out + i, _mm_mul_ps(_mm_cvtepi32_ps(low), scale4));
+		_mm_storeu_ps(out + i + 4, _mm_mul_ps(_mm_cvtepi32_ps(high), scale4));
+	}
+#endif
+
+	// the remainder
+	for (; i < count; i++)
+		out[i] = in[i] * scale;
+}
+
+void AudioBuffer::read(int offset, int count, float* out)
+{
+	// idiot test
+	assert(offset >= 0 && offset + count <= size);
+
+	// full precision samples are a plain copy
+	if (samples)
+	{
+		memcpy(out, samples + offset, sizeof(float) * count);
+		return;
+	}
+
+	// a view decodes the file's own samples, interpolating between them at any rate but their own
+	if (wave)
+	{
+		if (waveStep == AUDIO_POSITION_ONE)
+			wave->read(waveChannel, offset, count, out);
+		else
+			readInterpolated(offset, count, out);
+		return;
+	}
+
+	// compact samples are decoded block by block, since a block shares a scale
+	while (count > 0)
+	{
+		int block = offset >> AUDIO_COMPACT_BLOCK_SHIFT;
+		int run = ((block + 1) << AUDIO_COMPACT_BLOCK_SHIFT) - offset;
+		if (run > count) run = count;
+
+		decode(mantissas + offset, scales[block], run, out);
+		offset += run;
+		out += run;
+		count -= run;
+	}
+}
+
+void AudioBuffer::compact()
+{
+	// nothing to do if already compact or empty
+	if (!samples)
+		return;
+
+	// allocate the compact storage
+	int blocks = blocksFor(size);
+	Storage* compactStorage = reserve(compactBytesFor(size));
+	placeCompact(compactStorage->memory);
+
+	// every block is scaled to its own peak, so quiet passages keep their precision
+	for (int block = 0; block < blocks; block++)
+	{
+		int start = block << AUDIO_COMPACT_BLOCK_SHIFT;
+		int end = start + AUDIO_COMPACT_BLOCK_SIZE;
+		if (end > size) end = size;
+
+		// find the peak
+		float peak = 0.f;
+		for (int i = start; i < end; i++)
+		{
+			if (fabsf(samples[i]) > peak)
+				peak = fabsf(samples[i]);
+		}
+
+		// round each sample to its nearest step (a silent block is all zeroes)
+		float inverse = (peak > 0.f ? COMPACT_PEAK / peak : 0.f);
+		scales[block] = peak / COMPACT_PEAK;
+		for (int i = start; i < end; i++)
+			mantissas[i] = (short)floorf(samples[i] * inverse + 0.5f);
+	}
+
+	// the full precision samples aren't needed anymore (by this buffer, at least)
+	free(storage);
+	storage = compactStorage;
+	samples = NULL;
+}
+
+void AudioBuffer::detach()
+{
+	// idiot test
+	if (!wave)
+		return;
+
+	// every sample the view reads, then the file can go
+	Storage* detachedStorage = reserve(bytesFor(size));
+	read(0, size, (float*)detachedStorage->memory);
+	wave->release();
+	wave = NULL;
+	storage = detachedStorage;
+	samples = (float*)storage->memory;
+}
+
+void AudioBuffer::copy(AudioBuffer& other)
+{
+	// idiot test
+	if (&other == this)
+		return;
+
+	// views share the file
+	if (other.wave)
+	{
+		view(other.wave, other.waveChannel, other.waveStep);
+		return;
+	}
+
+	// full precision or compact samples are shared where they are, whoever fills them next takes memory of its own
+	// (taking hold of the other's storage before letting go of this one, in case they are the same)
+	Storage* shared = other.storage;
+	if (shared)
+		shared->references++;
+	release();
+	if (!shared)
+		return;
+	storage = shared;
+	samples = other.samples;
+	mantissas = other.mantissas;
+	scales = other.scales;
+	size = other.size;
+}
+
+size_t AudioBuffer::getMemoryUsed()
+{
+	// full precision or empty
+	if (!mantissas)
+		return (samples ? bytesFor(size) : 0);
+
+	// compact
+	return compactBytesFor(size);
+}
+
+// macro cleanup
+#undef AUDIO_BUFFER_SSE2
+#undef COMPACT_PEAK
@@ -0,0 +1,136 @@
+////////////////////////////////////////////////////////////////////////////////
+//                                                                            //
+//   Audio Buffer                                                             //
+//   Everett Moser                                                            //
+//   10-18-26                                                                 //
+//                                                                            //
+//   One channel of audio samples, compact, spilled to disk or read from one  //
+//                                                                            //
+////////////////////////////////////////////////////////////////////////////////
+
+#pragma once
+
+#include "AudioDefines.h"
+#include "Error.h"
+#include "MappedFile.h"
+#include <stddef.h>
+
+#include <atomic>
+
+// compact storage keeps 16 bit samples, every block of them sharing one float scale (block floating point)
+// very large buffers are spilled to a memory mapped temporary file, which the OS pages in as they are read
+// a buffer can also view a channel of a mapped wave file, decoding its samples as they are read without holding any
+// (read at the rate it was recorded, or at any other, interpolating between the file's frames a block at a time)
+// copies share the samples of the buffer they copy, which are only written again once no other buffer holds them
+class WaveFile;
+class AudioBuffer
+{
+private:
+
+	// the memory holding the samples (on the heap, or in the file if spilled), freed once every buffer sharing it lets go
+	struct Storage
+	{
+		char* memory;
+		MappedFile* file;
+		std::atomic<int> references;
+	};
+	Storage* storage;
+
+	// full precision samples (NULL while compact)
+	float* samples;
+
+	// compact samples and the scale of each block (NULL while full precision)
+	short* mantissas;
+	float* scales;
+
+	// the wave file viewed, holding a reference to it, the channel, and the file frames each sample moves along (NULL unless viewing one)
+	WaveFile* wave;
+	int waveChannel;
+	AudioPosition waveStep;
+
+	// file frames decoded at a time when interpolating a view
+	const static int VIEW_BLOCK_SIZE = 1024;
+
+	// number of samples held
+	int size;
+
+	// number of blocks needed for a compact buffer
+	static inline int blocksFor(int sampleCount) { return (sampleCount + AUDIO_COMPACT_BLOCK_SIZE - 1) >> AUDIO_COMPACT_BLOCK_SHIFT; }
+
+	// bytes needed for the samples in each storage
+	static inline size_t bytesFor(int sampleCount) { return sizeof(float) * sampleCount; }
+	static inline size_t compactBytesFor(int sampleCount) { return sizeof(short) * sampleCount + sizeof(float) * blocksFor(sampleCount); }
+
+	// take memory for the samples, spilling it to a file if it is large enough (see AUDIO_SPILL_THRESHOLD)
+	static Storage* reserve(size_t bytes);
+
+	// let go of memory from reserve, freeing it if no other buffer shares it
+	static void free(Storage* shared);
+
+	// point the compact samples and scales into a block of memory
+	void placeCompact(char* block);
+
+	// decode samples which all share the same scale
+	static void decode(const short* in, float scale, int count, float* out);
+
+	// read a sample of the wave file viewed
+	float getViewed(int i);
+
+	// interpolate a run of samples of the wave file viewed at a rate other than its own
+	void readInterpolated(int offset, int count, float* out);
+
+	// buffers only share their memory through copy, so they are never copied by accident
+	AudioBuffer(const AudioBuffer&);
+	AudioBuffer& operator=(const AudioBuffer&);
+
+public:
+
+	// an empty buffer
+	inline AudioBuffer() : storage(NULL), samples(NULL), mantissas(NULL), scales(NULL), wave(NULL), waveChannel(0), waveStep(AUDIO_POSITION_ONE), size(0) { }
+
+	// free the samples
+	inline ~AudioBuffer() { release(); }
+
+	// make room for a number of full precision samples (contents are undefined until written, and never shared)
+	void allocate(int sampleCount);
+
+	// free the samples, leaving an empty buffer
+	void release();
+
+	// view a channel of a wave file instead of holding samples, read a number of file frames per sample (fixed point, see
+	// AudioPosition: read only, and shared with every copy of the buffer, the samples are as many as it takes to play the file through once)
+	void view(WaveFile* waveFile, int channel, AudioPosition step = AUDIO_POSITION_ONE);
+
+	// write access to a full precision sample
+	inline float& operator[](int i) { return samples[i]; }
+
+	// read a sample in any storage
+	inline float get(int i) { return (samples ? samples[i] : (mantissas ? mantissas[i] * scales[i >> AUDIO_COMPACT_BLOCK_SHIFT] : getViewed(i))); }
+
+	// copy a run of samples out as floats, decoding them if compact (no wrapping)
+	void read(int offset, int count, float* out);
+
+	// convert the samples to compact storage, freeing the full precision ones
+	void compact();
+
+	// decode a view into full precision samples of its own, letting go of the file (nothing to do unless viewing one)
+	void detach();
+
+	// make this buffer a copy of another, sharing its samples rather than copying them (as a view shares its file)
+	void copy(AudioBuffer& other);
+
+	// number of samples held
+	inline int getSize() { return size; }
+
+	// whether the samples are in compact storage
+	inline bool isCompact() { return mantissas != NULL; }
+
+	// whether the samples live in a temporary file rather than on the heap
+	inline bool isSpilled() { return storage && storage->file; }
+
+	// whether the samples are read from a wave file
+	inline bool isView() { return wave != NULL; }
+
+	// bytes held by the samples, whoever shares them (none for a view, the file's pages are the OS's to keep or drop)
+	size_t getMemoryUsed();
+};
@@ -2,10 +2,15 @@
 
 AudioConstant::AudioConstant(float val) : value(val)
 {
-	// only one value, only one buffer position
-	bufferL[0] = bufferR[0] = value;
+	// only one value, only one buffer position, same on both channels
 	bufferSize = 1;
-	setMaxPosition(1);
+	mono = true;
+	silent = (value == 0.f);
+	allocateBuffer();
+	bufferL[0] = value;
+
+	// the value is all there is to the state
+	hash = hashFloat(hashStart(), value);
 }
 
 void AudioConstant::setValue(float val)
@@ -16,8 +21,11 @@ void AudioConstant::setValue(float val)
 
 void AudioConstant::recalculate()
 {
-	// same as constructor: one value, one position
-	bufferL[0] = bufferR[0] = value;
+	// same as constructor: one value, one position, one channel
 	bufferSize = 1;
-	setMaxPosition(1);
+	mono = true;
+	silent = (value == 0.f);
+	allocateBuffer();
+	bufferL[0] = value;
+	hash = hashFloat(hashStart(), value);
 }
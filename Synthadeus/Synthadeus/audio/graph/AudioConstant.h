@@ -30,6 +30,9 @@ public:
 	// update the node's value
 	void setValue(float val);
 
+	// get the node's value
+	inline float getValue() { return value; }
+
 	// recalculate if we get a new value
 	virtual void recalculate();
 };
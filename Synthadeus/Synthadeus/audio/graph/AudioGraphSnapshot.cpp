@@ -0,0 +1,98 @@
+#include "AudioGraphSnapshot.h"
+
+// enough buffer samples for a span of the fastest note to interpolate between
+#define NOTE_SPAN_SIZE (AUDIO_SPAN_SIZE * 64)
+
+AudioGraphSnapshot::AudioGraphSnapshot(AudioNode* output)
+	: references(1)
+{
+	// take on the output's shape and state
+	bufferSize = output->getBufferSize();
+	mono = output->isMono();
+	silent = output->isSilent();
+	hash = output->getHash();
+
+	// share its buffers (in whatever storage they are kept, the node takes memory of its own before it calculates again)
+	bufferL.copy(*output->getBufferL());
+	if (!mono)
+		bufferR.copy(*output->getBufferR());
+
+	// no notes rendered yet
+	for (int i = 0; i < AUDIO_NOTE_COUNT; i++)
+		notes[i].store(NULL);
+}
+
+AudioGraphSnapshot::~AudioGraphSnapshot()
+{
+	// free the rendered notes
+	for (int i = 0; i < AUDIO_NOTE_COUNT; i++)
+	{
+		Note* note = notes[i].load();
+		if (!note)
+			continue;
+		delete[] note->left;
+		delete[] note->right;
+		delete note;
+	}
+}
+
+void AudioGraphSnapshot::setNote(int key, Note* note)
+{
+	// keep the first one in
+	Note* expected = NULL;
+	if (notes[key].compare_exchange_strong(expected, note))
+		return;
+	delete[] note->left;
+	delete[] note->right;
+	delete note;
+}
+
+AudioGraphSnapshot::Note* AudioGraphSnapshot::renderNote(AudioPosition speed, int length)
+{
+	// idiot test
+	assert(AUDIO_POSITION_SAMPLE(speed * AUDIO_SPAN_SIZE) + 2 <= NOTE_SPAN_SIZE);
+
+	// allocate the note
+	Note* note = new Note;
+	note->length = length;
+	note->left = new float[length];
+	note->right = (mono ? NULL : new float[length]);
+
+	// the buffer samples a span of the note falls between
+	float* spanL = new float[NOTE_SPAN_SIZE];
+	float* spanR = new float[NOTE_SPAN_SIZE];
+
+	// interpolate the note a span at a time
+	for (int start = 0; start < length; start += AUDIO_SPAN_SIZE)
+	{
+		int count = length - start;
+		if (count > AUDIO_SPAN_SIZE) count = AUDIO_SPAN_SIZE;
+
+		// read the buffer samples under the span (positions match playback's exactly)
+		AudioPosition position = start * speed;
+		int first = AUDIO_POSITION_SAMPLE(position);
+		int last = AUDIO_POSITION_SAMPLE(position + (count - 1) * speed) + 1;
+		readL(first, last - first + 1, spanL);
+		if (!mono)
+			readR(first, last - first + 1, spanR);
+
+		// linearly interpolate each sample
+		for (int j = 0; j < count; j++)
+		{
+			AudioPosition t = position + j * speed;
+			int lower = AUDIO_POSITION_SAMPLE(t) - first;
+			float deltaT = AUDIO_POSITION_FRACTION(t);
+			note->left[start + j] = spanL[lower] + (spanL[lower + 1] - spanL[lower]) * deltaT;
+			if (!mono)
+				note->right[start + j] = spanR[lower] + (spanR[lower + 1] - spanR[lower]) * deltaT;
+		}
+	}
+
+	// done with the spans
+	delete[] spanL;
+	delete[] spanR;
+	return note;
+}
+
+// macro cleanup
+#undef NOTE_SPAN_SIZE
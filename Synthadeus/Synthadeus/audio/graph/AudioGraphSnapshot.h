@@ -0,0 +1,75 @@
+////////////////////////////////////////////////////////////////////////////////
+//                                                                            //
+//   Audio Graph Snapshot                                                     //
+//   Everett Moser                                                            //
+//   10-18-26                                                                 //
+//                                                                            //
+//   An immutable copy of the graph's output, safe to play while editing      //
+//                                                                            //
+////////////////////////////////////////////////////////////////////////////////
+
+#pragma once
+
+#include "AudioNode.h"
+
+#include <atomic>
+
+// snapshots are built on the UI thread, read by the audio callback and never changed in between
+// (apart from notes pre-rendered from them, which are only ever added)
+// they are reference counted, so any number of parts, engines and threads can share one (a loaded patch is copied once
+// for every render playing it), and the last to let go frees it
+class AudioGraphSnapshot : public AudioNode
+{
+public:
+
+	// the start of a note rendered at its pitch (the left channel only, when mono)
+	struct Note
+	{
+		float* left;
+		float* right;
+		int length;
+	};
+
+private:
+
+	// the notes rendered so far, one slot per key
+	std::atomic<Note*> notes[AUDIO_NOTE_COUNT];
+
+	// whoever holds the snapshot (starting with whoever built it)
+	std::atomic<int> references;
+
+protected:
+
+	// free the rendered notes (only once no one holds the snapshot, see release)
+	virtual ~AudioGraphSnapshot();
+
+public:
+
+	// run time type information
+	RTTI_MACRO(AudioGraphSnapshot);
+
+	// copy the calculated buffers of the graph's output node (held once, by whoever built it)
+	AudioGraphSnapshot(AudioNode* output);
+
+	// hold the snapshot as well (safe from any thread)
+	inline AudioGraphSnapshot* acquire() { references++; return this; }
+
+	// let go of the snapshot, freeing it if no one else holds it (safe from any thread)
+	inline void release() { if (--references == 0) delete this; }
+
+	// a snapshot never changes, so there is nothing to recalculate
+	inline virtual void recalculate() { }
+
+	// interpolate the first samples of a note played at a (fixed point) speed through the buffer (safe from any thread)
+	Note* renderNote(AudioPosition speed, int length);
+
+	// memory a rendered note of some length takes
+	inline size_t bytesForNote(int length) { return sizeof(float) * length * (mono ? 1 : 2); }
+
+	// hand a rendered note over to the snapshot, which frees it (the first note set for a key is kept, a shared
+	// snapshot may have a key rendered by more than one engine, and any later one is freed right away)
+	void setNote(int key, Note* note);
+
+	// the rendered note for a key, NULL if it hasn't been rendered (yet)
+	inline Note* getNote(int key) { return notes[key].load(); }
+};
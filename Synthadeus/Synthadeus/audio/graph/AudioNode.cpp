@@ -1,4 +1,9 @@
 #include "AudioNode.h"
+#include <string.h>
+
+// 64 bit FNV-1a constants
+#define HASH_OFFSET_BASIS 14695981039346656037ULL
+#define HASH_PRIME 1099511628211ULL
 
 int AudioNode::GCD(int A, int B)
 {
@@ -12,7 +17,7 @@ int AudioNode::GCD(int A, int B)
 	}
 
 	// idiot test (just suppose the numbers are relatively prime)
-	if (min * max == 0) return 1;
+	if (min == 0 || max == 0) return 1;
 
 	// intial quotient and remainder
 	int Q = max / min;
@@ -44,8 +49,8 @@ float AudioNode::lerpValueL(float t)
 	int upperSample = (int)(t + 1) % bufferSize;
 
 	// calculate the lerp
-	float deltaB = bufferL[upperSample] - bufferL[lowerSample];
-	return bufferL[lowerSample] + deltaB * deltaT;
+	float lower = bufferL.get(lowerSample);
+	return lower + (bufferL.get(upperSample) - lower) * deltaT;
 }
 
 float AudioNode::lerpValueR(float t)
@@ -60,7 +65,69 @@ float AudioNode::lerpValueR(float t)
 	int lowerSample = (int)t % bufferSize;
 	int upperSample = (int)(t + 1) % bufferSize;
 
-	// calculate the lerp
-	float deltaB = bufferR[upperSample] - bufferR[lowerSample];
-	return bufferR[lowerSample] + deltaB * deltaT;
+	// calculate the lerp (mono nodes only hold the left channel)
+	AudioBuffer& buffer = channelR();
+	float lower = buffer.get(lowerSample);
+	return lower + (buffer.get(upperSample) - lower) * deltaT;
+}
+
+unsigned long long AudioNode::hashBytes(unsigned long long h, const void* bytes, int size)
+{
+	// xor in each byte, then multiply by the prime
+	const unsigned char* data = (const unsigned char*)bytes;
+	for (int i = 0; i < size; i++)
+	{
+		h ^= data[i];
+		h *= HASH_PRIME;
+	}
+	return h;
+}
+
+unsigned long long AudioNode::hashStart()
+{
+	// the class name keeps an oscillator from matching a multiplier with the same numbers
+	const char* name = getClassName();
+	return hashBytes(HASH_OFFSET_BASIS, name, (int)strlen(name));
+}
+
+void AudioNode::compactBuffer()
+{
+#ifdef AUDIO_COMPACT_STORAGE
+	// short buffers stay full precision, they cost next to nothing
+	if (bufferSize < AUDIO_COMPACT_THRESHOLD)
+		return;
+
+	// compact whichever channels are calculated
+	bufferL.compact();
+	if (!mono)
+		bufferR.compact();
+#endif
+}
+
+void AudioNode::readChannel(AudioBuffer& buffer, int offset, int count, float* out)
+{
+	// an empty buffer reads as silence
+	if (bufferSize == 0)
+	{
+		memset(out, 0, sizeof(float) * count);
+		return;
+	}
+
+	// copy up to the end of the buffer, then start over from the beginning
+	// (a span no longer than the buffer is split at most once, shorter buffers repeat)
+	offset %= bufferSize;
+	while (count > 0)
+	{
+		int run = bufferSize - offset;
+		if (run > count) run = count;
+
+		buffer.read(offset, run, out);
+		out += run;
+		count -= run;
+		offset = 0;
+	}
 }
+
+// macro cleanup
+#undef HASH_OFFSET_BASIS
+#undef HASH_PRIME
@@ -11,7 +11,7 @@
 #pragma once
 
 #include "CFMaths.h"
-#include "AudioPlaybackPosition.h"
+#include "AudioBuffer.h"
 #include "AudioDefines.h"
 #include "Error.h"
 #include "Object.h"
@@ -22,19 +22,66 @@
 		(nullableObject)->memberFunction : \
 		(defaultValue))
 
-class AudioNode : public AudioPlaybackPosition, public Object
+class AudioNode : public Object
 {
+	// the cache copies buffers in and out of nodes
+	friend class AudioNodeCache;
+
 protected:
 
-	// some huge buffers to hold audio data
-	float bufferL[AUDIO_BUFFER_SIZE];
-	float bufferR[AUDIO_BUFFER_SIZE];
+	// the audio data, sized to the part in use
+	AudioBuffer bufferL;
+	AudioBuffer bufferR;
 
 	// the size of the part of the buffer actaully in use
 	int bufferSize;
 
+	// when set, the right channel is identical to the left, so only the left buffer is calculated
+	bool mono;
+
+	// when set, the node outputs nothing but zeroes, so whoever reads it can skip the math
+	bool silent;
+
+	// make the node silent: a single zero sample on one channel, which costs nothing to read or repeat
+	inline void makeSilent() { bufferSize = 1; mono = true; silent = true; allocateBuffer(); bufferL[0] = 0.f; }
+
+	// the buffer holding the right channel data (the left one when the node is mono)
+	inline AudioBuffer& channelR() { return (mono ? bufferL : bufferR); }
+
+	// size the channels to the buffer size before calculating (a mono node drops its right channel)
+	inline void allocateBuffer() { bufferL.allocate(bufferSize); bufferR.allocate(mono ? 0 : bufferSize); }
+
+	// move a calculated buffer to compact storage if it is long enough to be worth it
+	void compactBuffer();
+
+	// copy samples out of a channel, wrapping around the end of the buffer
+	void readChannel(AudioBuffer& buffer, int offset, int count, float* out);
+
+	// read a span of both channels of an input (nothing is read for a missing input)
+	static inline void readInput(AudioNode* input, int pos, int count, float* outL, float* outR) { if (input) { input->readL(pos, count, outL); input->readR(pos, count, outR); } }
+
+	// hash of the node's parameters and its inputs' hashes, updated whenever the node is recalculated
+	unsigned long long hash;
+
+	// mix raw bytes into a hash (FNV-1a)
+	static unsigned long long hashBytes(unsigned long long h, const void* bytes, int size);
+
+	// mix a parameter into a hash
+	static inline unsigned long long hashFloat(unsigned long long h, float value) { return hashBytes(h, &value, sizeof(value)); }
+	static inline unsigned long long hashInt(unsigned long long h, int value) { return hashBytes(h, &value, sizeof(value)); }
+
+	// mix an input node's hash into a hash (a missing input hashes as 0)
+	static inline unsigned long long hashNode(unsigned long long h, AudioNode* node) { unsigned long long value = POTENTIAL_NULL(node, getHash(), 0ULL); return hashBytes(h, &value, sizeof(value)); }
+
+	// the hash every node state starts from, so different kinds of nodes never match
+	unsigned long long hashStart();
+
 	// this LCM calculation is done with this specific order of operations to avoid integer overflow (very common)
-	static inline int LCM(int A, int B) { int maxA = A, maxB = B; if (maxA < 1) maxA = 1; if (maxB < 1) maxB = 1; return (maxA / GCD(A, B)) * maxB; }
+	// (the product itself is 64 bit, two unrelated lengths of a few seconds each already pass 2^31)
+	static inline long long LCM(int A, int B) { int maxA = A, maxB = B; if (maxA < 1) maxA = 1; if (maxB < 1) maxB = 1; return (long long)(maxA / GCD(A, B)) * maxB; }
+
+	// a buffer length from a cumulative LCM, at least one sample and at most the longest buffer
+	static inline int clampPhase(long long phase) { return (int)(phase < 1 ? 1 : (phase < AUDIO_BUFFER_SIZE ? phase : AUDIO_BUFFER_SIZE)); }
 	
 	// via euclidian algorithm
 	static int GCD(int A, int B);
@@ -45,23 +92,35 @@ public:
 	RTTI_MACRO(AudioNode);
 
 	// construct the default, along with playback position
-	inline AudioNode() : AudioPlaybackPosition() { }
+	inline AudioNode() : bufferSize(0), mono(false), silent(false), hash(0) { }
+
+	// nodes are freed through AudioNode pointers (patches, parts, sums), so whatever a node holds goes with it
+	inline virtual ~AudioNode() { }
 
 	// get the buffer size
 	inline int getBufferSize() { return bufferSize; }
 
 	// get the left audio buffer
-	inline float* getBufferL() { return bufferL; }
+	inline AudioBuffer* getBufferL() { return &bufferL; }
 
 	// get the right audio buffer
-	inline float* getBufferR() { return bufferR; }
+	inline AudioBuffer* getBufferR() { return &channelR(); }
 
-	// get the left audio buffer value at position
+	// whether both channels hold the same signal
+	inline bool isMono() { return mono; }
+
+	// whether the node outputs nothing but zeroes
+	inline bool isSilent() { return silent; }
+
+	// the hash of the state the buffer was last calculated from
+	inline unsigned long long getHash() { return hash; }
+
+	// get the left audio buffer value at position (readL is much cheaper for runs of samples)
 	inline float getBufferValueL(int pos) 
 	{ 
 		if (bufferSize == 0) 
 			return 0; 
-		return bufferL[pos % bufferSize]; 
+		return bufferL.get(pos % bufferSize); 
 	}
 
 	// get the right audio buffer value at position
@@ -69,27 +128,7 @@ public:
 	{ 
 		if (bufferSize == 0) 
 			return 0; 
-		return bufferR[pos % bufferSize]; 
-	}
-
-	// get the next playback position value for the left audio buffer
-	inline float getBufferAtPositionL() 
-	{ 
-		if (bufferSize == 0) 
-			return 0; 
-
-		// this modulus should never happen, but included for safety
-		return bufferL[getPositionL() % bufferSize]; 
-	}
-
-	// get the next playback position value for the right audio buffer
-	inline float getBufferAtPositionR() 
-	{ 
-		if (bufferSize == 0) 
-			return 0;
-
-		// this modulus should never happen, but included for safety
-		return bufferR[getPositionR() % bufferSize]; 
+		return channelR().get(pos % bufferSize); 
 	}
 
 	// abstract recalculate pure to guarantee recalculatability
@@ -100,6 +139,13 @@ public:
 
 	// linearly interpolate the sample at time t (t in terms of samples) for the right buffer
 	float lerpValueR(float t);
+
+	// copy count samples of the left buffer starting at pos (decoding compact storage several at a time)
+	// reads hold no state, so any number of voices or threads may read a node at once
+	inline void readL(int pos, int count, float* out) { readChannel(bufferL, pos, count, out); }
+
+	// copy count samples of the right buffer starting at pos
+	inline void readR(int pos, int count, float* out) { readChannel(channelR(), pos, count, out); }
 };
 
 // interface for the UI
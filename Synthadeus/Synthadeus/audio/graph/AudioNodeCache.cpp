@@ -0,0 +1,172 @@
+#include "AudioNodeCache.h"
+#include "AudioNode.h"
+
+AudioNodeCache::Entry AudioNodeCache::entries[AudioNodeCache::MAX_ENTRIES];
+int AudioNodeCache::freeList = -1;
+int AudioNodeCache::buckets[AudioNodeCache::BUCKETS];
+int AudioNodeCache::newest = -1;
+int AudioNodeCache::oldest = -1;
+size_t AudioNodeCache::memoryUsed = 0;
+size_t AudioNodeCache::memoryBudget = AUDIO_CACHE_MEMORY_BUDGET;
+bool AudioNodeCache::initialized = false;
+
+void AudioNodeCache::initialize()
+{
+	// every bucket starts empty
+	for (int i = 0; i < BUCKETS; i++)
+		buckets[i] = -1;
+
+	// every entry starts unused
+	for (int i = 0; i < MAX_ENTRIES; i++)
+		entries[i].next = (i + 1 < MAX_ENTRIES ? i + 1 : -1);
+	freeList = 0;
+
+	// nothing remembered yet
+	newest = oldest = -1;
+	memoryUsed = 0;
+	initialized = true;
+}
+
+int AudioNodeCache::find(unsigned long long hash)
+{
+	// walk the bucket the hash falls into
+	for (int i = buckets[hash & (BUCKETS - 1)]; i != -1; i = entries[i].bucketNext)
+	{
+		if (entries[i].hash == hash)
+			return i;
+	}
+
+	// never seen
+	return -1;
+}
+
+void AudioNodeCache::unlink(int index)
+{
+	Entry& entry = entries[index];
+
+	// remove it from the least recently used list
+	if (entry.previous != -1) entries[entry.previous].next = entry.next;
+	else newest = entry.next;
+	if (entry.next != -1) entries[entry.next].previous = entry.previous;
+	else oldest = entry.previous;
+
+	// remove it from its bucket
+	int* link = &buckets[entry.hash & (BUCKETS - 1)];
+	while (*link != index)
+		link = &entries[*link].bucketNext;
+	*link = entry.bucketNext;
+}
+
+void AudioNodeCache::touch(int index)
+{
+	// already the newest
+	if (newest == index)
+		return;
+
+	// detach it from its neighbours
+	Entry& entry = entries[index];
+	if (entry.previous != -1) entries[entry.previous].next = entry.next;
+	if (entry.next != -1) entries[entry.next].previous = entry.previous;
+	else oldest = entry.previous;
+
+	// and put it at the front
+	entry.previous = -1;
+	entry.next = newest;
+	entries[newest].previous = index;
+	newest = index;
+}
+
+void AudioNodeCache::evict()
+{
+	// idiot test
+	assert(oldest != -1);
+	int index = oldest;
+	Entry& entry = entries[index];
+
+	// forget it and free its buffer
+	unlink(index);
+	memoryUsed -= entry.bytes;
+	entry.left.release();
+	entry.right.release();
+
+	// it can be reused
+	entry.next = freeList;
+	freeList = index;
+}
+
+bool AudioNodeCache::restore(AudioNode* node)
+{
+	if (!initialized) initialize();
+
+	// is this state remembered?
+	int index = find(node->getHash());
+	if (index == -1)
+		return false;
+
+	// share the remembered buffer with the node
+	Entry& entry = entries[index];
+	node->bufferSize = entry.size;
+	node->mono = entry.mono;
+	node->bufferL.copy(entry.left);
+	node->bufferR.copy(entry.right);
+
+	// it was just used
+	touch(index);
+	return true;
+}
+
+void AudioNodeCache::store(AudioNode* node)
+{
+	if (!initialized) initialize();
+
+	// buffers bigger than the whole budget are never kept, and known ones needn't be
+	size_t bytes = node->bufferL.getMemoryUsed() + node->bufferR.getMemoryUsed();
+	if (bytes > memoryBudget || find(node->getHash()) != -1)
+		return;
+
+	// make room for the new buffer
+	while (oldest != -1 && (memoryUsed + bytes > memoryBudget || freeList == -1))
+		evict();
+
+	// take an unused entry
+	int index = freeList;
+	Entry& entry = entries[index];
+	freeList = entry.next;
+
+	// share the node's buffer
+	entry.hash = node->getHash();
+	entry.size = node->bufferSize;
+	entry.mono = node->mono;
+	entry.left.copy(node->bufferL);
+	entry.right.copy(node->bufferR);
+	entry.bytes = bytes;
+	memoryUsed += bytes;
+
+	// add it to its bucket
+	entry.bucketNext = buckets[entry.hash & (BUCKETS - 1)];
+	buckets[entry.hash & (BUCKETS - 1)] = index;
+
+	// and to the front of the least recently used list
+	entry.previous = -1;
+	entry.next = newest;
+	if (newest != -1) entries[newest].previous = index;
+	else oldest = index;
+	newest = index;
+}
+
+void AudioNodeCache::setMemoryBudget(size_t bytes)
+{
+	if (!initialized) initialize();
+
+	// forget the oldest buffers until we fit
+	memoryBudget = bytes;
+	while (oldest != -1 && memoryUsed > memoryBudget)
+		evict();
+}
+
+void AudioNodeCache::clear()
+{
+	// forget everything
+	while (oldest != -1)
+		evict();
+}
@@ -0,0 +1,97 @@
+////////////////////////////////////////////////////////////////////////////////
+//                                                                            //
+//   Audio Node Cache                                                         //
+//   Everett Moser                                                            //
+//   10-18-26                                                                 //
+//                                                                            //
+//   Remembers calculated node buffers by the hash of the node's state        //
+//                                                                            //
+////////////////////////////////////////////////////////////////////////////////
+
+#pragma once
+
+#include "AudioDefines.h"
+#include "AudioBuffer.h"
+#include "Error.h"
+
+class AudioNode;
+class AudioNodeCache
+{
+private:
+
+	// maximum number of buffers remembered at once
+	const static int MAX_ENTRIES = 1024;
+
+	// number of hash buckets (a power of two so the hash can be masked)
+	const static int BUCKETS = 1024;
+
+	// a remembered buffer
+	struct Entry
+	{
+		// the hash of the node state that calculated it
+		unsigned long long hash;
+
+		// the buffer contents (shared with the node that calculated it, in whichever storage it used)
+		AudioBuffer left, right;
+		int size;
+		bool mono;
+
+		// memory held by the buffers
+		size_t bytes;
+
+		// neighbours in the least recently used list
+		int previous, next;
+
+		// next entry in the same hash bucket
+		int bucketNext;
+	};
+
+	// the entries and the unused entries list
+	static Entry entries[MAX_ENTRIES];
+	static int freeList;
+
+	// the first entry of every hash bucket
+	static int buckets[BUCKETS];
+
+	// the most and least recently used entries
+	static int newest, oldest;
+
+	// the memory used and allowed for buffers (in bytes)
+	static size_t memoryUsed;
+	static size_t memoryBudget;
+
+	// have the tables been set up yet?
+	static bool initialized;
+
+	// set up the empty tables
+	static void initialize();
+
+	// find the entry holding a hash, -1 if there is none
+	static int find(unsigned long long hash);
+
+	// move an entry to the front of the least recently used list
+	static void touch(int index);
+
+	// take an entry out of the least recently used list and its bucket
+	static void unlink(int index);
+
+	// forget the least recently used entry
+	static void evict();
+
+public:
+
+	// give the node a remembered buffer if its current state was seen before (shared, so no samples are copied)
+	static bool restore(AudioNode* node);
+
+	// remember the buffer the node just calculated
+	static void store(AudioNode* node);
+
+	// update the memory the cache may use, forgetting buffers if needed
+	static void setMemoryBudget(size_t bytes);
+
+	// the memory the cache currently uses
+	static inline size_t getMemoryUsed() { return memoryUsed; }
+
+	// forget all remembered buffers
+	static void clear();
+};
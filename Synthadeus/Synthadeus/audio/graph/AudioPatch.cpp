@@ -0,0 +1,485 @@
+#include "AudioPatch.h"
+#include "AudioConstant.h"
+#include "Oscillator.h"
+#include "SignalMultiplier.h"
+#include "SignalSummation.h"
+#include "ExponentialEnvelope.h"
+#include "AudioSample.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+// the most tokens on a line (a sum of every signal it can hold, and then some)
+#define PATCH_MAX_TOKENS 16
+
+// the names of the waveforms, in the order of Oscillator::WAVEFORM
+static const char* waveformNames[] = { "sine", "saw", "square" };
+
+// a whole token as a number (false if it isn't one)
+static bool readNumber(const char* token, float& value)
+{
+	char* end;
+	value = (float)strtod(token, &end);
+	return end != token && *end == '\0';
+}
+
+// split a line into tokens in place, up to a comment (returns how many)
+static int tokenize(char* line, char** tokens)
+{
+	int count = 0;
+	char* c = line;
+	while (*c && *c != '#' && count < PATCH_MAX_TOKENS)
+	{
+		// skip the space before the token
+		while (*c == ' ' || *c == '\t' || *c == '\r' || *c == '\n')
+			c++;
+		if (!*c || *c == '#')
+			break;
+
+		// the token runs up to the next space
+		tokens[count++] = c;
+		while (*c && *c != ' ' && *c != '\t' && *c != '\r' && *c != '\n' && *c != '#')
+			c++;
+		if (*c == '#')
+		{
+			*c = '\0';
+			break;
+		}
+		if (*c)
+			*c++ = '\0';
+	}
+	return count;
+}
+
+AudioPatch::AudioPatch()
+	: numNodes(0)
+{
+	// no part plays anything yet
+	for (int i = 0; i < AUDIO_PARTS; i++)
+	{
+		outputs[i] = NULL;
+		snapshots[i] = NULL;
+	}
+}
+
+void AudioPatch::clear()
+{
+	// the nodes only reference each other, so any order will do
+	for (int i = 0; i < numNodes; i++)
+		delete nodes[i];
+	numNodes = 0;
+	for (int i = 0; i < AUDIO_PARTS; i++)
+	{
+		outputs[i] = NULL;
+		POTENTIAL_NULL(snapshots[i], release(), (void)0);
+		snapshots[i] = NULL;
+	}
+}
+
+int AudioPatch::getNumParts()
+{
+	int count = 0;
+	for (int i = 0; i < AUDIO_PARTS; i++)
+	{
+		if (outputs[i])
+			count = i + 1;
+	}
+	return count;
+}
+
+bool AudioPatch::readInput(const char* token, AudioNode*& input)
+{
+	// none
+	input = NULL;
+	if (strcmp(token, "-") == 0)
+		return true;
+
+	// ids are the order the nodes were declared in
+	char* end;
+	long id = strtol(token, &end, 10);
+	if (end == token || *end != '\0' || id < 0 || id >= numNodes)
+		return false;
+	input = nodes[id];
+	return true;
+}
+
+AudioNode* AudioPatch::readNode(char** tokens, int count)
+{
+	const char* type = tokens[0];
+	float values[4];
+
+	// a constant value
+	if (strcmp(type, "constant") == 0 && count == 3)
+	{
+		if (!readNumber(tokens[2], values[0]))
+			return NULL;
+		return new AudioConstant(values[0]);
+	}
+
+	// an oscillator, with its modulators
+	if (strcmp(type, "oscillator") == 0 && count == 9)
+	{
+		int wave = -1;
+		for (int i = 0; i < 3; i++)
+		{
+			if (strcmp(tokens[2], waveformNames[i]) == 0)
+				wave = i;
+		}
+		AudioNode* frequencyMod;
+		AudioNode* volumeMod;
+		AudioNode* panningMod;
+		if (wave < 0 || !readNumber(tokens[3], values[0]) || !readNumber(tokens[4], values[1]) || !readNumber(tokens[5], values[2]) ||
+			!readInput(tokens[6], frequencyMod) || !readInput(tokens[7], volumeMod) || !readInput(tokens[8], panningMod))
+			return NULL;
+		return new Oscillator((Oscillator::WAVEFORM)wave, values[0], values[1], values[2], frequencyMod, volumeMod, panningMod);
+	}
+
+	// a multiplied signal
+	if (strcmp(type, "multiply") == 0 && count == 4)
+	{
+		AudioNode* input;
+		if (!readNumber(tokens[2], values[0]) || !readInput(tokens[3], input))
+			return NULL;
+		return new SignalMultiplier(values[0], input);
+	}
+
+	// a sum of signals
+	if (strcmp(type, "sum") == 0)
+	{
+		SignalSummation* sum = new SignalSummation();
+		for (int i = 2; i < count; i++)
+		{
+			AudioNode* input;
+			if (!readInput(tokens[i], input))
+			{
+				delete sum;
+				return NULL;
+			}
+			if (input)
+				sum->addChild(input);
+		}
+		return sum;
+	}
+
+	// an envelope, with its modulators
+	if (strcmp(type, "envelope") == 0 && count == 10)
+	{
+		AudioNode* mods[4];
+		for (int i = 0; i < 4; i++)
+		{
+			if (!readNumber(tokens[2 + i], values[i]) || !readInput(tokens[6 + i], mods[i]))
+				return NULL;
+		}
+		return new ExponentialEnvelope(values[0], values[1], values[2], values[3], mods[0], mods[1], mods[2], mods[3]);
+	}
+
+	// a recorded sample, its path running to the end of the line (spaces and all)
+	if (strcmp(type, "sample") == 0 && count >= 4)
+	{
+		if (!readNumber(tokens[2], values[0]))
+			return NULL;
+		for (int i = 3; i < count - 1; i++)
+			tokens[i][strlen(tokens[i])] = ' ';
+		AudioSample* sample = new AudioSample(tokens[3], values[0]);
+		if (!sample->isLoaded())
+			DebugPrintf("  [AUDIO] The sample %s will play silence\n", tokens[3]);
+		return sample;
+	}
+
+	// nothing we know
+	return NULL;
+}
+
+bool AudioPatch::load(const char* path)
+{
+	// start from nothing
+	clear();
+
+	// open the file
+	FILE* f = NULL;
+#ifdef _WIN32
+	fopen_s(&f, path, "r");
+#else
+	f = fopen(path, "r");
+#endif
+	if (!f)
+	{
+		DebugPrintf("  [AUDIO] Could not open patch %s\n", path);
+		return false;
+	}
+
+	// a node or an output on each line
+	char line[MAX_LINE];
+	char* tokens[PATCH_MAX_TOKENS];
+	int lineNumber = 0;
+	bool valid = true;
+	while (valid && fgets(line, MAX_LINE, f))
+	{
+		lineNumber++;
+		int count = tokenize(line, tokens);
+		if (count == 0)
+			continue;
+
+		// the node a part plays
+		if (strcmp(tokens[0], "output") == 0)
+		{
+			char* end;
+			long part = (count == 3 ? strtol(tokens[1], &end, 10) : -1);
+			AudioNode* output;
+			valid = (part >= 0 && part < AUDIO_PARTS && *end == '\0' && readInput(tokens[2], output));
+			if (valid)
+				outputs[part] = output;
+		}
+
+		// a node, declared with the next id
+		else
+		{
+			char* end;
+			long id = (count >= 2 ? strtol(tokens[1], &end, 10) : -1);
+			AudioNode* node = (id == numNodes && *end == '\0' && numNodes < MAX_NODES ? readNode(tokens, count) : NULL);
+			valid = (node != NULL);
+			if (valid)
+				nodes[numNodes++] = node;
+		}
+
+		// deliver errors
+		if (!valid)
+			DebugPrintf("  [AUDIO] Bad line %d in patch %s\n", lineNumber, path);
+	}
+	fclose(f);
+
+	// a patch is all or nothing
+	if (!valid)
+	{
+		clear();
+		return false;
+	}
+
+	// calculate what each part plays
+	for (int i = 0; i < AUDIO_PARTS; i++)
+		POTENTIAL_NULL(outputs[i], recalculate(), (void)0);
+
+	// and copy it once for every render to share (the parts left out all share one silence)
+	AudioConstant silence(0.f);
+	silence.recalculate();
+	AudioGraphSnapshot* silent = new AudioGraphSnapshot(&silence);
+	for (int i = 0; i < getNumParts(); i++)
+		snapshots[i] = (outputs[i] ? new AudioGraphSnapshot(outputs[i]) : silent->acquire());
+	silent->release();
+	return true;
+}
+
+void AudioPatch::writeInput(FILE* f, AudioNode* node, AudioNode** written, int numWritten)
+{
+	// none
+	if (!node)
+	{
+		fprintf(f, " -");
+		return;
+	}
+
+	// the id it was written with
+	for (int i = 0; i < numWritten; i++)
+	{
+		if (written[i] == node)
+		{
+			fprintf(f, " %d", i);
+			return;
+		}
+	}
+}
+
+int AudioPatch::getInputs(AudioNode* node, AudioNode** inputs)
+{
+	// whichever inputs each kind of node has (a missing one is NULL)
+	const char* type = node->getClassName();
+	if (strcmp(type, Oscillator::nameString()) == 0)
+	{
+		Oscillator* oscillator = (Oscillator*)node;
+		inputs[0] = oscillator->getFrequencyModulator();
+		inputs[1] = oscillator->getVolumeModulator();
+		inputs[2] = oscillator->getPanningModulator();
+		return 3;
+	}
+	if (strcmp(type, SignalMultiplier::nameString()) == 0)
+	{
+		inputs[0] = ((SignalMultiplier*)node)->getInput();
+		return 1;
+	}
+	if (strcmp(type, SignalSummation::nameString()) == 0)
+	{
+		SignalSummation* sum = (SignalSummation*)node;
+		assert(sum->getNumSignals() <= MAX_INPUTS);
+		for (int i = 0; i < sum->getNumSignals(); i++)
+			inputs[i] = sum->getSignal(i);
+		return sum->getNumSignals();
+	}
+	if (strcmp(type, ExponentialEnvelope::nameString()) == 0)
+	{
+		ExponentialEnvelope* envelope = (ExponentialEnvelope*)node;
+		inputs[0] = envelope->getLengthMod();
+		inputs[1] = envelope->getExponentMod();
+		inputs[2] = envelope->getMinimumMod();
+		inputs[3] = envelope->getMaximumMod();
+		return 4;
+	}
+	return 0;
+}
+
+void AudioPatch::numberNode(AudioNode* node, AudioNode** numbered, int& count)
+{
+	// nothing to number, or numbered already
+	if (!node || count == MAX_NODES)
+		return;
+	for (int i = 0; i < count; i++)
+	{
+		if (numbered[i] == node)
+			return;
+	}
+
+	// the inputs take their ids first, just like they are written
+	AudioNode* inputs[MAX_INPUTS];
+	int inputCount = getInputs(node, inputs);
+	for (int i = 0; i < inputCount; i++)
+		numberNode(inputs[i], numbered, count);
+	if (count < MAX_NODES)
+		numbered[count++] = node;
+}
+
+bool AudioPatch::writeNode(FILE* f, AudioNode* node, AudioNode** written, int& numWritten)
+{
+	// nothing to write, or written already
+	if (!node)
+		return true;
+	for (int i = 0; i < numWritten; i++)
+	{
+		if (written[i] == node)
+			return true;
+	}
+
+	// every kind of node writes its inputs first
+	AudioNode* inputs[MAX_INPUTS];
+	int inputCount = getInputs(node, inputs);
+	for (int i = 0; i < inputCount; i++)
+	{
+		if (!writeNode(f, inputs[i], written, numWritten))
+			return false;
+	}
+	const char* type = node->getClassName();
+	if (strcmp(type, AudioConstant::nameString()) == 0)
+	{
+		fprintf(f, "constant %d %.9g\n", numWritten, ((AudioConstant*)node)->getValue());
+	}
+	else if (strcmp(type, Oscillator::nameString()) == 0)
+	{
+		Oscillator* oscillator = (Oscillator*)node;
+		fprintf(f, "oscillator %d %s %.9g %.9g %.9g", numWritten, waveformNames[oscillator->getWaveform()],
+			oscillator->getFrequency(), oscillator->getVolume(), oscillator->getPanning());
+		writeInput(f, oscillator->getFrequencyModulator(), written, numWritten);
+		writeInput(f, oscillator->getVolumeModulator(), written, numWritten);
+		writeInput(f, oscillator->getPanningModulator(), written, numWritten);
+		fprintf(f, "\n");
+	}
+	else if (strcmp(type, SignalMultiplier::nameString()) == 0)
+	{
+		SignalMultiplier* multiplier = (SignalMultiplier*)node;
+		fprintf(f, "multiply %d %.9g", numWritten, multiplier->getValue());
+		writeInput(f, multiplier->getInput(), written, numWritten);
+		fprintf(f, "\n");
+	}
+	else if (strcmp(type, SignalSummation::nameString()) == 0)
+	{
+		SignalSummation* sum = (SignalSummation*)node;
+		fprintf(f, "sum %d", numWritten);
+		for (int i = 0; i < sum->getNumSignals(); i++)
+			writeInput(f, sum->getSignal(i), written, numWritten);
+		fprintf(f, "\n");
+	}
+	else if (strcmp(type, ExponentialEnvelope::nameString()) == 0)
+	{
+		ExponentialEnvelope* envelope = (ExponentialEnvelope*)node;
+		fprintf(f, "envelope %d %.9g %.9g %.9g %.9g", numWritten, envelope->getLength(), envelope->getExponent(),
+			envelope->getMinimumVolume(), envelope->getMaximumVolume());
+		for (int i = 0; i < inputCount; i++)
+			writeInput(f, inputs[i], written, numWritten);
+		fprintf(f, "\n");
+	}
+	else if (strcmp(type, AudioSample::nameString()) == 0)
+	{
+		AudioSample* sample = (AudioSample*)node;
+		fprintf(f, "sample %d %.9g %s\n", numWritten, sample->getSpeed(), sample->getPath());
+	}
+	else
+	{
+		DebugPrintf("  [AUDIO] Patches can't hold a %s\n", type);
+		return false;
+	}
+
+	// it has its id now
+	if (numWritten == MAX_NODES)
+	{
+		DebugPrintf("  [AUDIO] Too many nodes for a patch.\n");
+		return false;
+	}
+	written[numWritten++] = node;
+	return true;
+}
+
+bool AudioPatch::save(const char* path, AudioNode** partOutputs, int partCount)
+{
+	// open the file
+	FILE* f = NULL;
+#ifdef _WIN32
+	fopen_s(&f, path, "w");
+#else
+	f = fopen(path, "w");
+#endif
+	if (!f)
+	{
+		DebugPrintf("  [AUDIO] Could not create patch %s\n", path);
+		return false;
+	}
+
+	// every node reachable from an output, each once (nodes shared between parts too)
+	AudioNode** written = new AudioNode*[MAX_NODES];
+	int numWritten = 0;
+	bool valid = true;
+	fprintf(f, "# Synthadeus patch\n");
+	for (int i = 0; i < partCount && valid; i++)
+		valid = writeNode(f, partOutputs[i], written, numWritten);
+
+	// then what each part plays
+	for (int i = 0; i < partCount && valid; i++)
+	{
+		if (!partOutputs[i])
+			continue;
+		fprintf(f, "output %d", i);
+		writeInput(f, partOutputs[i], written, numWritten);
+		fprintf(f, "\n");
+	}
+
+	// done
+	delete[] written;
+	valid = (fclose(f) == 0 && valid);
+	return valid;
+}
+
+int AudioPatch::getSavedId(AudioNode* node, AudioNode** partOutputs, int partCount)
+{
+	// number the nodes in the order save writes them, up to the one asked for
+	AudioNode** numbered = new AudioNode*[MAX_NODES];
+	int count = 0;
+	for (int i = 0; i < partCount; i++)
+		numberNode(partOutputs[i], numbered, count);
+	int id = -1;
+	for (int i = 0; i < count && id == -1; i++)
+	{
+		if (numbered[i] == node)
+			id = i;
+	}
+	delete[] numbered;
+	return id;
+}
+
+// macro cleanup
+#undef PATCH_MAX_TOKENS
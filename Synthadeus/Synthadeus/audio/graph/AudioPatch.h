@@ -0,0 +1,105 @@
+////////////////////////////////////////////////////////////////////////////////
+//                                                                            //
+//   Audio Patch                                                              //
+//   Everett Moser                                                            //
+//   10-18-26                                                                 //
+//                                                                            //
+//   Saves the audio graph behind each part's endpoint, and loads it back     //
+//                                                                            //
+////////////////////////////////////////////////////////////////////////////////
+
+#pragma once
+
+#include "Error.h"
+#include "AudioDefines.h"
+#include "AudioNode.h"
+#include "AudioGraphSnapshot.h"
+
+// a patch is a text file, one node per line with its inputs declared before it, then the node each part plays:
+//
+//   constant <id> <value>
+//   oscillator <id> <sine|saw|square> <frequency> <volume> <panning> <frequency mod> <volume mod> <panning mod>
+//   multiply <id> <value> <input>
+//   sum <id> <input> <input> ...
+//   envelope <id> <length> <exponent> <minimum> <maximum> <length mod> <exponent mod> <minimum mod> <maximum mod>
+//   sample <id> <speed> <path to a wave file>
+//   output <part> <id>
+//
+// inputs are ids of earlier nodes, or - for none ('#' starts a comment, so a sample's path can't hold one)
+class AudioPatch
+{
+private:
+
+	// the nodes loaded, in the order they were declared (owned by the patch)
+	const static int MAX_NODES = 4096;
+	AudioNode* nodes[MAX_NODES];
+	int numNodes;
+
+	// the node each part plays (NULL for none)
+	AudioNode* outputs[AUDIO_PARTS];
+
+	// what each part plays as it was calculated on loading, silence for a part without an output (NULL past the last part)
+	AudioGraphSnapshot* snapshots[AUDIO_PARTS];
+
+	// the longest line read
+	const static int MAX_LINE = 1024;
+
+	// read a declared node's id into its node, - for none (false if it wasn't declared yet)
+	bool readInput(const char* token, AudioNode*& input);
+
+	// build a node from the tokens of its line (NULL if they don't make one)
+	AudioNode* readNode(char** tokens, int count);
+
+	// the most inputs a node has (a full sum)
+	const static int MAX_INPUTS = 8;
+
+	// a node's inputs, in the order they are written before it (returns how many, a missing input is NULL)
+	static int getInputs(AudioNode* node, AudioNode** inputs);
+
+	// give a node the next id after every one of its inputs, unless it has one already (just as writeNode does)
+	static void numberNode(AudioNode* node, AudioNode** numbered, int& count);
+
+	// write a node after every one of its inputs, unless it was written already (false for a node patches can't hold)
+	static bool writeNode(FILE* f, AudioNode* node, AudioNode** written, int& numWritten);
+
+	// the id of a node written already (- for none)
+	static void writeInput(FILE* f, AudioNode* node, AudioNode** written, int numWritten);
+
+	// patches own their nodes, so they are never copied
+	AudioPatch(const AudioPatch&);
+	AudioPatch& operator=(const AudioPatch&);
+
+public:
+
+	// an empty patch
+	AudioPatch();
+
+	// free the nodes
+	inline ~AudioPatch() { clear(); }
+
+	// read a patch from disk, building and calculating its nodes (false, leaving the patch empty, if it can't be read)
+	bool load(const char* path);
+
+	// free the nodes and let go of the snapshots, leaving an empty patch
+	void clear();
+
+	// the node a part plays (NULL for none)
+	inline AudioNode* getOutput(int part) { return outputs[part]; }
+
+	// the parts up to the last one with an output
+	int getNumParts();
+
+	// the snapshot a part plays, copied once when the patch was loaded: every render playing the patch shares it (acquire it to
+	// hold it, it is only ever read), rather than copying the patch's buffers again for each engine
+	inline AudioGraphSnapshot* getSnapshot(int part) { return snapshots[part]; }
+
+	// the nodes loaded, and the one declared with an id (NULL for none)
+	inline int getNumNodes() { return numNodes; }
+	inline AudioNode* getNode(int id) { return (id >= 0 && id < numNodes ? nodes[id] : NULL); }
+
+	// write the graphs behind a number of parts' outputs to disk (NULL outputs are left out)
+	static bool save(const char* path, AudioNode** partOutputs, int partCount);
+
+	// the id a node is given when these outputs are saved, the one it is loaded back with (-1 if it plays into none of them)
+	static int getSavedId(AudioNode* node, AudioNode** partOutputs, int partCount);
+};
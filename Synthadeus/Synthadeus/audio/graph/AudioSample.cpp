@@ -0,0 +1,107 @@
+#include "AudioSample.h"
+#include <string.h>
+
+AudioSample::AudioSample(const char* filePath, float playbackSpeed)
+	: wave(NULL)
+{
+	// nothing loaded yet
+	path[0] = '\0';
+	setSpeed(playbackSpeed);
+	if (filePath)
+		setFile(filePath);
+
+	// the initial buffer calculation, like any other node's (the file is only viewed, so it costs next to nothing)
+	recalculate();
+}
+
+AudioSample::~AudioSample()
+{
+	// buffers and snapshots still viewing the file hold references of their own
+	if (wave)
+		wave->release();
+}
+
+bool AudioSample::setFile(const char* filePath)
+{
+	// let go of the old file (buffers and snapshots viewing it hold their own references)
+	if (wave)
+		wave->release();
+	wave = NULL;
+
+	// keep the path either way, so a patch can point at a file that is missing for now
+	size_t length = strlen(filePath);
+	if (length >= MAX_PATH_LENGTH)
+		length = MAX_PATH_LENGTH - 1;
+	memcpy(path, filePath, length);
+	path[length] = '\0';
+
+	// map the new one
+	WaveFile* file = new WaveFile();
+	if (!file->load(path))
+	{
+		file->release();
+		return false;
+	}
+	wave = file;
+	return true;
+}
+
+void AudioSample::setSpeed(float playbackSpeed)
+{
+	// idiot test
+	speed = playbackSpeed;
+	if (speed < SAMPLE_MIN_SPEED)
+		speed = SAMPLE_MIN_SPEED;
+	if (speed > SAMPLE_MAX_SPEED)
+		speed = SAMPLE_MAX_SPEED;
+}
+
+double AudioSample::calcRate()
+{
+	// files recorded at another rate are read faster or slower to keep their pitch
+	return (double)speed * wave->getSampleRate() / AUDIO_SAMPLE_RATE;
+}
+
+void AudioSample::calcHash()
+{
+	// everything the buffer is calculated from (the file's size and when it was last written stand in for its contents,
+	// which would all have to be read to hash, so a file edited in place hashes differently)
+	hash = hashStart();
+	hash = hashBytes(hash, path, (int)strlen(path));
+	hash = hashFloat(hash, speed);
+	hash = hashInt(hash, POTENTIAL_NULL(wave, getFrames(), 0));
+	hash = hashInt(hash, POTENTIAL_NULL(wave, getSampleRate(), 0));
+	unsigned long long bytes = POTENTIAL_NULL(wave, getFileSize(), 0);
+	long long modified = POTENTIAL_NULL(wave, getModified(), 0);
+	hash = hashBytes(hash, &bytes, sizeof(bytes));
+	hash = hashBytes(hash, &modified, sizeof(modified));
+}
+
+void AudioSample::recalculate()
+{
+	// without a file there is only silence
+	calcHash();
+	if (!wave)
+	{
+		makeSilent();
+		return;
+	}
+
+	// the buffers are the file itself, read at whatever rate it plays at
+	mono = (wave->getChannels() == 1);
+	silent = false;
+	AudioPosition step = (AudioPosition)(calcRate() * AUDIO_POSITION_ONE + 0.5);
+	bufferL.view(wave, 0, step);
+	bufferSize = bufferL.getSize();
+	if (mono)
+		bufferR.release();
+	else
+		bufferR.view(wave, 1, step);
+
+	// a short sample played at another rate is interpolated once, rather than every time a note reads it
+	if (step != AUDIO_POSITION_ONE && bufferSize <= MAX_COPY_LENGTH)
+	{
+		bufferL.detach();
+		bufferR.detach();
+	}
+}
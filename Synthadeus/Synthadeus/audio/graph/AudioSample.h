@@ -0,0 +1,82 @@
+////////////////////////////////////////////////////////////////////////////////
+//                                                                            //
+//   Audio Sample Node                                                        //
+//   Everett Moser                                                            //
+//   10-18-26                                                                 //
+//                                                                            //
+//   Plays a recorded wave file into the graph                                //
+//                                                                            //
+////////////////////////////////////////////////////////////////////////////////
+
+#pragma once
+
+#include "AudioNode.h"
+#include "WaveFile.h"
+
+// the range of speeds a sample plays at
+#define SAMPLE_MIN_SPEED (1.f / 16.f)
+#define SAMPLE_MAX_SPEED 16.f
+
+// the file is never copied at all: the buffers view the mapped file, so loading is instant and only the parts actually
+// played are ever read (the pitch of each note comes from the part playing the graph, as it does for any other node)
+// any other speed (or rate) than the one recorded reads the file the same way, interpolating between its frames
+// a block at a time as they are read, rather than resampling a copy of the whole file into the buffers (bar a short
+// sample, which notes loop over and over: reading it from a copy is much faster, and the copy is small whatever the speed)
+class AudioSample : public AudioNode
+{
+public:
+
+	// the longest path kept
+	const static int MAX_PATH_LENGTH = 1024;
+
+	// the most samples interpolated into a copy of the file rather than read from it as they play (~1.5 s)
+	const static int MAX_COPY_LENGTH = 1 << 16;
+
+private:
+
+	// the file played (NULL for none), and where it was loaded from
+	WaveFile* wave;
+	char path[MAX_PATH_LENGTH];
+
+	// how fast the sample plays (1 plays it as recorded)
+	float speed;
+
+	// the rate the file is read at, in file frames per sample of output
+	double calcRate();
+
+	// hash the file and the speed
+	void calcHash();
+
+	// samples own their file reference, so they are never copied
+	AudioSample(const AudioSample&);
+	AudioSample& operator=(const AudioSample&);
+
+public:
+
+	// run time type information
+	RTTI_MACRO(AudioSample);
+
+	// a sample playing a file (silent until one loads)
+	AudioSample(const char* filePath = NULL, float playbackSpeed = 1.f);
+
+	// let go of the file
+	virtual ~AudioSample();
+
+	// map a new file to play (false, leaving the node silent, if it can't be played)
+	bool setFile(const char* filePath);
+
+	// set how fast the sample plays
+	void setSpeed(float playbackSpeed);
+
+	// get the path the file was loaded from (empty for none)
+	inline const char* getPath() { return path; }
+
+	// get how fast the sample plays
+	inline float getSpeed() { return speed; }
+
+	// whether a file is loaded
+	inline bool isLoaded() { return wave != NULL; }
+
+	// view the file at the speed it plays
+	virtual void recalculate();
+};
@@ -2,20 +2,25 @@
 
 int ExponentialEnvelope::calculatePhase()
 {
-	int phase = 1;
+	long long phase = 1;
 	phase = LCM(AUDIO_SAMPLE_RATE / length, POTENTIAL_NULL(lengthModulator, getBufferSize(), 1.f));
-	return min(phase, AUDIO_SAMPLE_RATE);
+	return (int)(phase < AUDIO_SAMPLE_RATE ? phase : AUDIO_SAMPLE_RATE);
 }
 
 void ExponentialEnvelope::calculateBuffer()
 {
-	POTENTIAL_NULL(lengthModulator, recalculate(), 0);
-	POTENTIAL_NULL(exponentModulator, recalculate(), 0);
-	POTENTIAL_NULL(minimumModulator, recalculate(), 0);
-	POTENTIAL_NULL(maximumModulator, recalculate(), 0);
+	POTENTIAL_NULL(lengthModulator, recalculate(), (void)0);
+	POTENTIAL_NULL(exponentModulator, recalculate(), (void)0);
+	POTENTIAL_NULL(minimumModulator, recalculate(), (void)0);
+	POTENTIAL_NULL(maximumModulator, recalculate(), (void)0);
+
+	// the state of the envelope and its modulators
+	hash = hashStart();
+	hash = hashFloat(hashFloat(hashFloat(hashFloat(hash, length), exponent), minimumVolume), maximumVolume);
+	hash = hashNode(hashNode(hashNode(hashNode(hash, lengthModulator), exponentModulator), minimumModulator), maximumModulator);
 
 	bufferSize = calculatePhase();
-	setMaxPosition(bufferSize);
+	allocateBuffer();
 
 	for (int i = 0; i < bufferSize; i++)
 	{
@@ -81,8 +86,6 @@ ExponentialEnvelope::ExponentialEnvelope(float len, float exp, float minVol, flo
 	lengthModulator(lenMod), exponentModulator(expMod), minimumModulator(minMod), maximumModulator(maxMod)
 {
 	calculateBuffer();
-	moveToStart();
-	setMaxPosition(bufferSize);
 }
 
 void ExponentialEnvelope::recalculate()
@@ -5,12 +5,6 @@ Oscillator::Oscillator(WAVEFORM wave, float freq, float vol, float pan, AudioNod
 {
 	// fill out the node buffer
 	calcBuffer();
-
-	// reset play point
-	moveToStart();
-
-	// set max play point to loop back from the start
-	setMaxPosition(getBufferSize());
 }
 
 int Oscillator::calculatePhase()
@@ -24,7 +18,7 @@ int Oscillator::calculatePhase()
 	// the LCM is a major optimization in terms of space requirements
 	// it reduces the space by a factor of 10-10000x depending on the input nodes
 	// also reduces subsequend calculations
-	int phase = LCM(LCM(freqMod, volMod), LCM(panMod, sampleMod));
+	int phase = clampPhase(LCM(clampPhase(LCM(freqMod, volMod)), clampPhase(LCM(panMod, sampleMod))));
 
 	// kids, keep on your harmonics and avoid relatively prime numbers
 	return phase;
@@ -36,97 +30,131 @@ void Oscillator::recalculate()
 	calcBuffer();
 }
 
-float Oscillator::calcPanL(int sample)
+float Oscillator::calcPanL(float modulation)
 {
 	// the panning value is centered at 'pannng' and fluctates with panning mod.
 	// left panning = (1 + panning value) / 2 (i.e. a bigger value pans it to the left)
-	return (1 + POTENTIAL_NULL(panningMod, getBufferValueL(sample) * (1 - fabsf(panning)) + panning, panning)) * 0.5f;
+	return (1 + (panningMod ? modulation * (1 - fabsf(panning)) + panning : panning)) * 0.5f;
 }
 
-float Oscillator::calcPanR(int sample)
+float Oscillator::calcPanR(float modulation)
 {
 	// the panning value is centered at 'pannng' and fluctates with panning mod.
 	// left panning = (1 - panning value) / 2 (i.e. a smaller value pans it to the right)
-	return (1 - POTENTIAL_NULL(panningMod, getBufferValueR(sample) * (1 - fabsf(panning)) + panning, panning)) * 0.5f;
-}
-
-float Oscillator::calcVolumeL(int sample)
-{
-	// volume is the current volume adjusted by the volume modulator by that percent
-	return POTENTIAL_NULL(volumeMod, getBufferValueL(sample) * 0.5 + 0.5 * volume, volume);
+	return (1 - (panningMod ? modulation * (1 - fabsf(panning)) + panning : panning)) * 0.5f;
 }
 
-float Oscillator::calcVolumeR(int sample)
+float Oscillator::calcVolume(float modulation)
 {
 	// volume is the current volume adjusted by the volume modulator by that percent
-	return POTENTIAL_NULL(volumeMod, getBufferValueR(sample) * 0.5 + 0.5 * volume, volume);
+	return (volumeMod ? modulation * 0.5 + 0.5 * volume : volume);
 }
 
-float Oscillator::calcFrequencyL(int sample)
+float Oscillator::calcFrequency(float modulation)
 {
 	// frequency is calculated based upon the base and modulation can make it 0x to 2x the amount
-	return frequency + frequency * POTENTIAL_NULL(frequencyMod, getBufferValueL(sample), 0.f);
-}
-
-float Oscillator::calcFrequencyR(int sample)
-{
-	// frequency is calculated based upon the base and modulation can make it 0x to 2x the amount
-	return frequency + frequency * POTENTIAL_NULL(frequencyMod, getBufferValueR(sample), 0.f);
+	return frequency + frequency * (frequencyMod ? modulation : 0.f);
 }
 
 void Oscillator::calcBuffer()
 {
 	// recalc the potential inputs
-	POTENTIAL_NULL(frequencyMod, recalculate(), 0);
-	POTENTIAL_NULL(volumeMod, recalculate(), 0);
-	POTENTIAL_NULL(panningMod, recalculate(), 0);
+	POTENTIAL_NULL(frequencyMod, recalculate(), (void)0);
+	POTENTIAL_NULL(volumeMod, recalculate(), (void)0);
+	POTENTIAL_NULL(panningMod, recalculate(), (void)0);
+
+	// nothing to calculate if this exact state was calculated before
+	calcHash();
+
+	// without any volume there is only silence
+	silent = (volume == 0.f && POTENTIAL_NULL(volumeMod, isSilent(), true));
+	if (silent)
+	{
+		makeSilent();
+		return;
+	}
+	if (AudioNodeCache::restore(this))
+		return;
 
 	// flesh out the new audio buffers
 	bufferSize = calculatePhase();
 
-	// reset loop point
-	setMaxPosition(bufferSize);
+	// modulators which differ per channel give each channel its own wave
+	bool stereoWave = !POTENTIAL_NULL(frequencyMod, isMono(), true) || !POTENTIAL_NULL(volumeMod, isMono(), true);
+
+	// without those or any panning both channels are identical, so only the left is calculated
+	mono = !stereoWave && panningMod == NULL && panning == 0.f;
+	allocateBuffer();
 
 	// frequency is really just how fast theta changes
-	float thetaL = 0.f;
-	float thetaR = 0.f;
+	// (theta is kept as a 32 bit fraction of a turn, which wraps around exactly by itself)
+	unsigned int phaseL = 0;
+	unsigned int phaseR = 0;
 
-	// calculate each sample
-	for (int i = 0; i < bufferSize; i++)
+	// the modulators' values for a span of samples
+	float frequencyL[AUDIO_SPAN_SIZE], frequencyR[AUDIO_SPAN_SIZE];
+	float volumeL[AUDIO_SPAN_SIZE], volumeR[AUDIO_SPAN_SIZE];
+	float panningL[AUDIO_SPAN_SIZE], panningR[AUDIO_SPAN_SIZE];
+
+	// calculate the samples a span at a time
+	for (int start = 0; start < bufferSize; start += AUDIO_SPAN_SIZE)
 	{
-		// A = Vol * sin( 2*PI*Freq )
-		float panL = calcPanL(i);
-		float panR = calcPanR(i);
+		int count = bufferSize - start;
+		if (count > AUDIO_SPAN_SIZE) count = AUDIO_SPAN_SIZE;
 
-		// volume with respect to panning
-		float pannedVolumeL = calcVolumeL(i) * panL;
-		float pannedVolumeR = calcVolumeR(i) * panR;
+		// read the modulators once for the whole span
+		readInput(frequencyMod, start, count, frequencyL, frequencyR);
+		readInput(volumeMod, start, count, volumeL, volumeR);
+		readInput(panningMod, start, count, panningL, panningR);
 
-		// calculate the function and adjust by volume and panning
-		if (waveform == SINE)
-		{
-			bufferL[i] = fsinf(thetaL) * pannedVolumeL;
-			bufferR[i] = fsinf(thetaR) * pannedVolumeR;
-		}
-		else if (waveform == SAW)
+		// calculate each sample
+		for (int j = 0; j < count; j++)
 		{
-			bufferL[i] = sawf(thetaL) * pannedVolumeL;
-			bufferR[i] = sawf(thetaR) * pannedVolumeR;
-		}
-		else if (waveform == SQUARE)
-		{
-			bufferL[i] = sqrf(thetaL) * pannedVolumeL;
-			bufferR[i] = sqrf(thetaR) * pannedVolumeR;
+			int i = start + j;
+			float thetaL = phaseL * PHASE_TO_THETA;
+			float thetaR = phaseR * PHASE_TO_THETA;
+
+			// A = Vol * sin( 2*PI*Freq )
+			if (stereoWave)
+			{
+				// calculate the function and adjust by volume and panning
+				bufferL[i] = calcWave(thetaL) * calcVolume(volumeL[j]) * calcPanL(panningL[j]);
+				bufferR[i] = calcWave(thetaR) * calcVolume(volumeR[j]) * calcPanR(panningR[j]);
+			}
+			else
+			{
+				// one wave for both channels, only split up at the panning stage
+				float sample = calcWave(thetaL) * calcVolume(volumeL[j]);
+				bufferL[i] = sample * calcPanL(panningL[j]);
+				if (!mono)
+					bufferR[i] = sample * calcPanR(panningR[j]);
+			}
+
+			// update theta (the phase keeps itself in rotation)
+			phaseL += calcPhaseStep(calcFrequency(frequencyL[j]));
+
+			// the right theta only differs for a stereo wave
+			if (stereoWave)
+				phaseR += calcPhaseStep(calcFrequency(frequencyR[j]));
 		}
+	}
 
-		// update theta (keep it in rotation)
-		thetaL += 2 * PI * calcFrequencyL(i) / AUDIO_SAMPLE_RATE;
-		thetaR += 2 * PI * calcFrequencyR(i) / AUDIO_SAMPLE_RATE;
+	// remember the result in case we come back to this state
+	compactBuffer();
+	AudioNodeCache::store(this);
+}
 
-		// cap it with some accuracy (more than the CFMATH method)
-		while (thetaL > 2 * PI) thetaL -= 2 * PI;
-		while (thetaR > 2 * PI) thetaR -= 2 * PI;
-	}
+void Oscillator::calcHash()
+{
+	// everything the buffer is calculated from
+	hash = hashStart();
+	hash = hashInt(hash, waveform);
+	hash = hashFloat(hash, frequency);
+	hash = hashFloat(hash, volume);
+	hash = hashFloat(hash, panning);
+	hash = hashNode(hash, frequencyMod);
+	hash = hashNode(hash, volumeMod);
+	hash = hashNode(hash, panningMod);
 }
 
 void Oscillator::setFrequencyModulator(AudioNode* freqMod)
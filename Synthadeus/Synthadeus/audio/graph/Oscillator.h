@@ -11,6 +11,11 @@
 #pragma once
 
 #include "AudioNode.h"
+#include "AudioNodeCache.h"
+
+// a whole turn of phase is 2^32
+#define PHASE_PER_HERTZ (4294967296.0 / AUDIO_SAMPLE_RATE)
+#define PHASE_TO_THETA (2.f * PI / 4294967296.f)
 
 class Oscillator : public AudioNode
 {
@@ -43,23 +48,23 @@ private:
 	// calculate the buffer contents
 	void calcBuffer();
 
+	// hash the parameters and modulators
+	void calcHash();
+
 	// calculate the left panning based on constant and modulated values
-	float calcPanL(int sample);
+	float calcPanL(float modulation);
 
 	// calculate the right panning based on constant and modulated values
-	float calcPanR(int sample);
+	float calcPanR(float modulation);
 
-	// calculate the left volume based on constant and modulated values
-	float calcVolumeL(int sample);
+	// calculate the volume based on constant and modulated values
+	float calcVolume(float modulation);
 
-	// calculate the right volume based on constant and modulated values
-	float calcVolumeR(int sample);
+	// calculate the frequency based on constant and modulated values
+	float calcFrequency(float modulation);
 
-	// calculate the left frequency based on constant and modulated values
-	float calcFrequencyL(int sample);
-
-	// calculate the right frequency based on constant and modulated values
-	float calcFrequencyR(int sample);
+	// a phase step per sample for a frequency (negative frequencies step backwards, wrapping the same way)
+	inline unsigned int calcPhaseStep(float freq) { return (unsigned int)(long long)(freq * PHASE_PER_HERTZ); }
 
 	// saw generator function
 	inline float sawf(float theta) { return (-1.f / 3.14159f) * theta + 1.f; }
@@ -67,6 +72,16 @@ private:
 	// square generator function
 	inline float sqrf(float theta) { return 1.f - 2.f * (theta > 3.14159f ? 1.f : 0.f); }
 
+	// evaluate the current waveform at theta
+	inline float calcWave(float theta)
+	{
+		if (waveform == SAW)
+			return sawf(theta);
+		if (waveform == SQUARE)
+			return sqrf(theta);
+		return fsinf(theta);
+	}
+
 public:
 
 	// construct an oscillator, possibly specifying a certain number of the parameters
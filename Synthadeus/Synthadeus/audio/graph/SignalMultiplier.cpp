@@ -2,19 +2,50 @@
 
 void SignalMultiplier::calculateBuffer()
 {
-	// buffer size is the same as the input
-	bufferSize = POTENTIAL_NULL(input, getBufferSize(), 0);
-	POTENTIAL_NULL(input, recalculate(), 0);
+	// buffer size is the same as the input (as it is now, after it recalculates), no longer than the longest buffer
+	POTENTIAL_NULL(input, recalculate(), (void)0);
+	bufferSize = (input ? clampPhase(input->getBufferSize()) : 0);
 
-	setMaxPosition(bufferSize);
+	// nothing to calculate if this exact state was calculated before
+	hash = hashNode(hashFloat(hashStart(), value), input);
 
-	// if there is input, multiply the sample into this node's buffer
-	for (int i = 0; i < bufferSize; i++)
+	// nothing (or nothing but silence) multiplied is silence
+	silent = (input == NULL || input->isSilent() || value == 0.f);
+	if (silent)
 	{
-		assert(bufferSize > 0);
-		bufferL[i] = input->getBufferValueL(i) * value;
-		bufferR[i] = input->getBufferValueR(i) * value;
+		makeSilent();
+		return;
 	}
+	if (AudioNodeCache::restore(this))
+		return;
+
+	// a mono input stays mono, so only one channel needs multiplying
+	mono = POTENTIAL_NULL(input, isMono(), true);
+	allocateBuffer();
+
+	// if there is input, multiply the samples into this node's buffer a span at a time
+	float spanL[AUDIO_SPAN_SIZE];
+	float spanR[AUDIO_SPAN_SIZE];
+	for (int start = 0; start < bufferSize; start += AUDIO_SPAN_SIZE)
+	{
+		int count = bufferSize - start;
+		if (count > AUDIO_SPAN_SIZE) count = AUDIO_SPAN_SIZE;
+
+		input->readL(start, count, spanL);
+		for (int i = 0; i < count; i++)
+			bufferL[start + i] = spanL[i] * value;
+
+		if (mono)
+			continue;
+
+		input->readR(start, count, spanR);
+		for (int i = 0; i < count; i++)
+			bufferR[start + i] = spanR[i] * value;
+	}
+
+	// remember the result in case we come back to this state
+	compactBuffer();
+	AudioNodeCache::store(this);
 }
 
 SignalMultiplier::SignalMultiplier(float signalValue, AudioNode * inputNode)
@@ -25,8 +56,6 @@ SignalMultiplier::SignalMultiplier(float signalValue, AudioNode * inputNode)
 
 	// initial buffer calculation
 	calculateBuffer();
-
-	setMaxPosition(bufferSize);
 }
 
 void SignalMultiplier::setInput(AudioNode * inputNode)
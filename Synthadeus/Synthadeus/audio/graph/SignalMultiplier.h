@@ -11,6 +11,7 @@
 #pragma once
 
 #include "AudioNode.h"
+#include "AudioNodeCache.h"
 
 class SignalMultiplier : public AudioNode
 {
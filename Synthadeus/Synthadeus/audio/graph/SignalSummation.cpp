@@ -14,12 +14,12 @@ int SignalSummation::calculatePhase()
 	if (numSignals == 0) return 0;
 	int phase = 1;
 
-	// figure out cumulative LCM
+	// figure out cumulative LCM (clamped as it goes, once it passes the longest buffer it stays there)
 	for (int i = 0; i < numSignals; i++)
-		phase = LCM(phase, signals[i]->getBufferSize());
+		phase = clampPhase(LCM(phase, signals[i]->getBufferSize()));
 
 	// return the minimum buffer size needed
-	return min(phase, AUDIO_BUFFER_SIZE);
+	return phase;
 }
 
 void SignalSummation::addChild(AudioNode* signal)
@@ -89,27 +89,77 @@ void SignalSummation::calculateBuffer()
 	for (int j = 0; j < numSignals; j++)
 		signals[j]->recalculate();
 
+	// nothing to calculate if this exact state was calculated before
+	hash = hashInt(hashStart(), numSignals);
+	for (int j = 0; j < numSignals; j++)
+		hash = hashNode(hash, signals[j]);
+
+	// the sum of silent signals (or none at all) is silence
+	silent = true;
+	for (int j = 0; j < numSignals; j++)
+		silent = silent && signals[j]->isSilent();
+	if (silent)
+	{
+		makeSilent();
+		return;
+	}
+	if (AudioNodeCache::restore(this))
+		return;
+
 	// calculate how many samples needed to calculate
 	bufferSize = calculatePhase();
 
-	// calculate the samples
-	for (int i = 0; i < bufferSize; i++)
+	// the sum is only stereo if one of the signals is
+	mono = true;
+	for (int j = 0; j < numSignals; j++)
+		mono = mono && signals[j]->isMono();
+	allocateBuffer();
+
+	// calculate the samples a span at a time
+	float span[AUDIO_SPAN_SIZE];
+	float sum[AUDIO_SPAN_SIZE];
+	for (int start = 0; start < bufferSize; start += AUDIO_SPAN_SIZE)
 	{
-		// default to 0.f
-		bufferL[i] = 0.f;
-		bufferR[i] = 0.f;
+		int count = bufferSize - start;
+		if (count > AUDIO_SPAN_SIZE) count = AUDIO_SPAN_SIZE;
 
-		// add in all the signal values
+		// add in all the signal values, then divide through by the number of signals
+		for (int i = 0; i < count; i++)
+			sum[i] = 0.f;
 		for (int j = 0; j < numSignals; j++)
 		{
-			bufferL[i] += signals[j]->getBufferValueL(i);
-			bufferR[i] += signals[j]->getBufferValueR(i);
+			// silent signals add nothing
+			if (signals[j]->isSilent())
+				continue;
+			signals[j]->readL(start, count, span);
+			for (int i = 0; i < count; i++)
+				sum[i] += span[i];
 		}
+		for (int i = 0; i < count; i++)
+			bufferL[start + i] = sum[i] / (float)numSignals;
+
+		// mono sums are done here
+		if (mono)
+			continue;
 
-		// divide through by the number of signals
-		bufferL[i] /= (float)numSignals;
-		bufferR[i] /= (float)numSignals;
+		// same for the right channel
+		for (int i = 0; i < count; i++)
+			sum[i] = 0.f;
+		for (int j = 0; j < numSignals; j++)
+		{
+			if (signals[j]->isSilent())
+				continue;
+			signals[j]->readR(start, count, span);
+			for (int i = 0; i < count; i++)
+				sum[i] += span[i];
+		}
+		for (int i = 0; i < count; i++)
+			bufferR[start + i] = sum[i] / (float)numSignals;
 	}
+
+	// remember the result in case we come back to this state
+	compactBuffer();
+	AudioNodeCache::store(this);
 }
 
 void SignalSummation::recalculate()
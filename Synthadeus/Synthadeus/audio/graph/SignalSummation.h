@@ -11,6 +11,7 @@
 #pragma once
 
 #include "AudioNode.h"
+#include "AudioNodeCache.h"
 
 class SignalSummation : public AudioNode
 {
@@ -54,6 +55,9 @@ public:
 	// get the signal at the specified index in the summation
 	AudioNode* getSignal(int signalIndex);
 
+	// get the number of signals summed
+	inline int getNumSignals() { return numSignals; }
+
 	// recalculate the buffers with the summed signals
 	virtual void recalculate();
 };
\ No newline at end of file
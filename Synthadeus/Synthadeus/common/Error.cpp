@@ -1,4 +1,8 @@
 #include "Error.h"
+#include <stdarg.h>
+#include <string.h>
+#include <time.h>
+#include <mutex>
 
 // these [Error.h/cpp] are by far the most messy files (thanks to CPP commands)
 // probably the worst place to grade for neatness Dr. Nash :(
@@ -15,15 +19,23 @@
 #define DEBUG_FNAME_SIZE 64
 
 // a special assert to avoid infinite recursion (AKA a standard assert)
+#ifdef _WIN32
 #define NO_MSG_assert(expression) (void)(                                                       \
             (!!(expression)) ||                                                              \
             (_wassert(_CRT_WIDE(#expression), _CRT_WIDE(__FILE__), (unsigned)(__LINE__)), 0) \
         )
+#else
+#define NO_MSG_assert(expression) (void)((!!(expression)) || (abort(), 0))
+#endif
 
-// if we are building from VS, output to its output console
+// if we are building from VS, output to its output console (elsewhere, to standard error)
 #if defined(DEBUG) || defined(_DEBUG) // turn VS logging features
 
+#ifdef _WIN32
 #define __DebugPrintToDebuggerArea__(str) OutputDebugString(str)
+#else
+#define __DebugPrintToDebuggerArea__(str) fputs(str, stderr)
+#endif
 
 #else // turn off full debugging features
 
@@ -31,13 +43,17 @@
 
 #endif // Debug logging functions
 
+// the audio threads and offline renders print too, so one message goes out at a time
+static std::mutex debugMutex;
+
 void DebugLogging::initDebugLogger()
 {
 	// open the log file if debug logging is enabled
 #ifndef DEBUG_NO_LOG
 	// determine the filename
-	if (_strcmpi(debugFileName, "") == 0)
+	if (debugFileName[0] == '\0')
 	{
+#ifdef _WIN32
 		// make the log file "DEBUG_LOG_[date].log"
 		SYSTEMTIME systemTime;
 		GetSystemTime(&systemTime);
@@ -47,15 +63,27 @@ void DebugLogging::initDebugLogger()
 #else
 		sprintf_s(debugFileName, DEBUG_BUFFER_SIZE, "DEBUG_LOG_(%d-%d-%d_%d-%d-%d).log",
 			systemTime.wMonth, systemTime.wDay, systemTime.wYear, systemTime.wHour, systemTime.wSecond, systemTime.wSecond);
+#endif
+#else
+		// the same name, from the C library's clock
+		time_t now = time(NULL);
+		struct tm* systemTime = gmtime(&now);
+		snprintf(debugFileName, sizeof(debugFileName), "DEBUG_LOG_(%d-%d-%d_%d-%d-%d).log",
+			systemTime->tm_mon + 1, systemTime->tm_mday, systemTime->tm_year + 1900, systemTime->tm_hour, systemTime->tm_min, systemTime->tm_sec);
 #endif
 	}
 
 	// open the log
+#ifdef _WIN32
 #if defined(DEBUG) || defined(_DEBUG)
 	NO_MSG_assert(fopen_s(&log, debugFileName, "a") == 0);
 #else
 	fopen_s(&log, debugFileName, "a");
 #endif
+#else
+	log = fopen(debugFileName, "a");
+	NO_MSG_assert(log != NULL);
+#endif
 #endif
 
 	// establish the file is opened and module is initialized
@@ -66,6 +94,7 @@ void DebugLogging::dbgPrintf(const char* format, ...)
 {
 #ifndef DEBUG_NO_LOG
 	// initiate the log (if not already done so)
+	std::lock_guard<std::mutex> lock(debugMutex);
 	if (!isInitialized) initDebugLogger();
 
 	// debug log text buffer
@@ -75,10 +104,14 @@ void DebugLogging::dbgPrintf(const char* format, ...)
 	// construct the output string
 	va_list args;
 	va_start(args, format);
+#ifdef _WIN32
 #if defined(DEBUG) || defined(_DEBUG)
 	NO_MSG_assert(vsprintf_s(debugBuffer, format, args) >= 0);
 #else
 	vsprintf_s(debugBuffer, format, args);
+#endif
+#else
+	NO_MSG_assert(vsnprintf(debugBuffer, DEBUG_BUFFER_SIZE, format, args) >= 0);
 #endif
 	va_end(args);
 
@@ -103,6 +136,8 @@ void DebugLogging::finishDebugLogger()
 	isInitialized = false;
 }
 
+#ifdef _WIN32
+
 void DebugLogging::dbgAssertWindowsError(const char* functionName)
 {
 	// determine the last error code
@@ -132,6 +167,8 @@ void DebugLogging::dbgAssertWindowsHRESULT(const char* functionName, HRESULT hre
 	}
 }
 
+#endif
+
 // macro cleanup 
 #undef DEBUG_FILE_NAME
 #undef DEBUG_BUFFER_SIZE
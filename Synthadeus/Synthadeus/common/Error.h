@@ -14,6 +14,10 @@
 // probably the worst place to grade for neatness Dr. Nash :(
 
 #include <stdio.h>
+#include <stdlib.h>
+
+// everything but the windows error helpers also builds elsewhere (for the headless renderer)
+#ifdef _WIN32
 
 // windows is fat, so we go to the gym before we release it
 #if !defined(DEBUG) && !defined(_DEBUG)
@@ -22,6 +26,8 @@
 
 #include <Windows.h>
 
+#endif
+
 // define a switch to enable the log file
 #ifndef DEBUG_NO_LOG
 #define DebugPrintf DebugLogging::dbgPrintf
@@ -30,8 +36,10 @@
 #endif
 
 // shortcuts to find errors reported by the windows API
+#ifdef _WIN32
 #define AssertWindowsError() DebugLogging::dbgAssertWindowsError(__func__)
 #define AssertWindowsHRESULT(hresult) DebugLogging::dbgAssertWindowsHRESULT(__func__, hresult)
+#endif
 
 // Assert function 
 #if defined(DEBUG) || defined(_DEBUG) // turn on assert breaks
@@ -39,12 +47,22 @@
 // refed
 #include <assert.h>
 #undef assert
+#ifdef _WIN32
 #define assert(expression) \
 	if (!(expression)) \
 	{ \
 		DebugPrintf("Failed assertion: " #expression "\n"); \
 		_wassert(_CRT_WIDE(#expression), _CRT_WIDE(__FILE__), (unsigned)(__LINE__)); \
 	}
+#else
+#define assert(expression) \
+	if (!(expression)) \
+	{ \
+		DebugPrintf("Failed assertion: " #expression "\n"); \
+		fprintf(stderr, "Failed assertion: %s, file %s, line %d\n", #expression, __FILE__, __LINE__); \
+		abort(); \
+	}
+#endif
 
 #else // turn off assert breaks
 
@@ -80,9 +98,11 @@ namespace DebugLogging
 	// auto log-creating debug printing function
 	void dbgPrintf(const char* format, ...);
 
+#ifdef _WIN32
 	// windows error assertions
 	void dbgAssertWindowsError(const char* functionName);
 	void dbgAssertWindowsHRESULT(const char* functionName, HRESULT hresult);
+#endif
 }
 
 // macro cleanup
@@ -1,8 +1,12 @@
 #include "Object.h"
+#include <mutex>
 
 unsigned short Object::nHeapObjects = 0;
 Object* Object::heapObject[USHRT_MAX];
 
+// objects are created on more than one thread (snapshots by every offline render), so the list is locked
+static std::mutex heapObjectMutex;
+
 #if defined(DEBUG) || defined(_DEBUG)
 
 // insert and remove only modify the list if we are in debug mode
@@ -58,6 +62,7 @@ void* Object::operator new(size_t size)
 		assert(!"Failed to allocate memory.");
 
 	// add the object reference
+	std::lock_guard<std::mutex> lock(heapObjectMutex);
 	insert((Object *)ptr);
 	return ptr;
 }
@@ -70,6 +75,7 @@ void* Object::operator new[](size_t size)
 		assert(!"Failed to allocate memory.");
 
 	// add the object reference
+	std::lock_guard<std::mutex> lock(heapObjectMutex);
 	insert((Object *)ptr);
 	return ptr;
 }
@@ -77,7 +83,10 @@ void* Object::operator new[](size_t size)
 void Object::operator delete(void* ptr)
 {
 	// remove the reference
-	remove((Object *)ptr);
+	{
+		std::lock_guard<std::mutex> lock(heapObjectMutex);
+		remove((Object *)ptr);
+	}
 
 	// free the memory
 	free(ptr);
@@ -86,7 +95,10 @@ void Object::operator delete(void* ptr)
 void Object::operator delete[](void* ptr)
 {
 	// remove the reference
-	remove((Object *)ptr);
+	{
+		std::lock_guard<std::mutex> lock(heapObjectMutex);
+		remove((Object *)ptr);
+	}
 
 	// free the memory
 	free(ptr);
@@ -0,0 +1,235 @@
+#include "RenderBatch.h"
+#include "MidiFile.h"
+#include "OfflineRender.h"
+#include "FlacWriter.h"
+
+#include <stdio.h>
+#include <string.h>
+#include <thread>
+#include <chrono>
+
+// the most workers run at once
+#define BATCH_MAX_WORKERS 256
+
+// is a character the space between paths?
+static inline bool isSpace(char c) { return c == ' ' || c == '\t' || c == '\r'; }
+
+RenderBatch::RenderBatch()
+	: jobs(NULL), numJobs(0), text(NULL), patches(NULL), numPatches(0), nextJob(0), tail(0.f), voiceThreads(0),
+	  format(WaveWriter::PCM16), dither(false), outputRate(AUDIO_SAMPLE_RATE)
+{
+}
+
+RenderBatch::~RenderBatch()
+{
+	// the patches, then what pointed into the manifest
+	for (int i = 0; i < numPatches; i++)
+		delete patches[i];
+	delete[] patches;
+	delete[] jobs;
+	delete[] text;
+}
+
+bool RenderBatch::load(const char* path)
+{
+	// read the whole manifest
+	FILE* f = NULL;
+#ifdef _WIN32
+	fopen_s(&f, path, "rb");
+#else
+	f = fopen(path, "rb");
+#endif
+	if (!f)
+	{
+		fprintf(stderr, "Could not open the manifest %s\n", path);
+		return false;
+	}
+	fseek(f, 0, SEEK_END);
+	long length = ftell(f);
+	fseek(f, 0, SEEK_SET);
+	text = new char[length + 1];
+	bool read = (length >= 0 && fread(text, 1, length, f) == (size_t)length);
+	fclose(f);
+	if (!read)
+	{
+		fprintf(stderr, "Could not read the manifest %s\n", path);
+		return false;
+	}
+	text[length] = '\0';
+
+	// at most a job per line
+	int lines = 1;
+	for (long i = 0; i < length; i++)
+		lines += (text[i] == '\n');
+	jobs = new Job[lines];
+	patches = new AudioPatch*[lines];
+
+	// split each line into its three paths in place
+	char* line = text;
+	for (int l = 1; line; l++)
+	{
+		char* end = strchr(line, '\n');
+		if (end)
+			*end = '\0';
+		char* comment = strchr(line, '#');
+		if (comment)
+			*comment = '\0';
+
+		char* tokens[3];
+		int count = 0;
+		char* c = line;
+		while (*c)
+		{
+			while (isSpace(*c))
+				*c++ = '\0';
+			if (!*c)
+				break;
+			if (count == 3)
+			{
+				count++;
+				break;
+			}
+			tokens[count++] = c;
+			while (*c && !isSpace(*c))
+				c++;
+		}
+		line = (end ? end + 1 : NULL);
+
+		// blank lines are skipped, anything but three paths is reported
+		if (count == 0)
+			continue;
+		if (count != 3)
+		{
+			fprintf(stderr, "Line %d of %s isn't <patch> <midi file> <wave file>\n", l, path);
+			continue;
+		}
+		Job& job = jobs[numJobs++];
+		job.patchPath = tokens[0];
+		job.midiPath = tokens[1];
+		job.wavePath = tokens[2];
+		job.patch = -1;
+		job.succeeded = false;
+		job.secondsRendered = 0.0;
+		job.secondsTaken = 0.0;
+	}
+
+	// load each patch the first time a job plays it (patches are calculated here, on one thread, since the node cache isn't shared safely)
+	for (int i = 0; i < numJobs; i++)
+	{
+		for (int j = 0; j < i && jobs[i].patch < 0; j++)
+		{
+			if (strcmp(jobs[i].patchPath, jobs[j].patchPath) == 0)
+				jobs[i].patch = jobs[j].patch;
+		}
+		if (jobs[i].patch >= 0)
+			continue;
+		AudioPatch* patch = new AudioPatch();
+		if (!patch->load(jobs[i].patchPath) || patch->getNumParts() == 0)
+		{
+			fprintf(stderr, "Could not load a patch with any outputs from %s\n", jobs[i].patchPath);
+			delete patch;
+			patch = NULL;
+		}
+		jobs[i].patch = numPatches;
+		patches[numPatches++] = patch;
+	}
+	return true;
+}
+
+void RenderBatch::renderJob(Job& job)
+{
+	// the patch, shared with every other job playing it
+	AudioPatch* patch = patches[job.patch];
+	if (!patch)
+		return;
+
+	// the song, loaded by whichever worker takes the job
+	MidiFile* file = new MidiFile();
+	if (!file->load(job.midiPath))
+	{
+		fprintf(stderr, "Could not load %s\n", job.midiPath);
+		delete file;
+		return;
+	}
+
+	// an engine of its own, playing the patch's snapshots (copied once, when it was loaded, for every job to share)
+	AudioGraphSnapshot* graphs[AUDIO_PARTS];
+	int partCount = patch->getNumParts();
+	for (int i = 0; i < partCount; i++)
+		graphs[i] = patch->getSnapshot(i);
+	OfflineRender* render = new OfflineRender(graphs, partCount, voiceThreads);
+	render->setFormat(format, dither);
+	render->setOutputRate(outputRate);
+	job.succeeded = render->render(file, job.wavePath, tail);
+	job.secondsRendered = render->getSecondsRendered();
+	job.secondsTaken = render->getSecondsTaken();
+	delete render;
+}
+
+void RenderBatch::work(RenderBatch* myself)
+{
+	// take the jobs one at a time, in the order of the manifest
+	for (int i = myself->nextJob++; i < myself->numJobs; i = myself->nextJob++)
+	{
+		Job& job = myself->jobs[i];
+		myself->renderJob(job);
+		if (job.succeeded)
+			printf("  [%d/%d] %s: %.2f s in %.3f s (%.1fx real time)\n", i + 1, myself->numJobs, job.wavePath,
+				job.secondsRendered, job.secondsTaken, (job.secondsTaken > 0.0 ? job.secondsRendered / job.secondsTaken : 0.0));
+		else
+			printf("  [%d/%d] %s: failed\n", i + 1, myself->numJobs, job.wavePath);
+	}
+}
+
+bool RenderBatch::hasFlacJobs()
+{
+	for (int i = 0; i < numJobs; i++)
+	{
+		if (FlacWriter::isFlacPath(jobs[i].wavePath))
+			return true;
+	}
+	return false;
+}
+
+bool RenderBatch::run(int workers, float tailSeconds, int voiceThreadsPerJob)
+{
+	// idiot test
+	if (workers < 1)
+		workers = 1;
+	if (workers > BATCH_MAX_WORKERS)
+		workers = BATCH_MAX_WORKERS;
+	if (workers > numJobs && numJobs > 0)
+		workers = numJobs;
+	tail = tailSeconds;
+	voiceThreads = voiceThreadsPerJob;
+	nextJob.store(0);
+
+	// the workers take jobs until there are none left
+	printf("Rendering %d jobs (%d patches) on %d workers\n", numJobs, numPatches, workers);
+	std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+	std::thread* threads = new std::thread[workers];
+	for (int i = 0; i < workers; i++)
+		threads[i] = std::thread(work, this);
+	for (int i = 0; i < workers; i++)
+		threads[i].join();
+	delete[] threads;
+	double elapsed = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+
+	// the whole batch
+	int failed = 0;
+	double rendered = 0.0;
+	double taken = 0.0;
+	for (int i = 0; i < numJobs; i++)
+	{
+		failed += !jobs[i].succeeded;
+		rendered += jobs[i].secondsRendered;
+		taken += jobs[i].secondsTaken;
+	}
+	printf("Rendered %d of %d jobs, %.2f s of audio in %.3f s (%.1fx real time, %.1f jobs a second, %.1fx real time per worker)\n",
+		numJobs - failed, numJobs, rendered, elapsed, (elapsed > 0.0 ? rendered / elapsed : 0.0),
+		(elapsed > 0.0 ? (numJobs - failed) / elapsed : 0.0), (taken > 0.0 ? rendered / taken : 0.0));
+	return failed == 0;
+}
+
+// macro cleanup
+#undef BATCH_MAX_WORKERS
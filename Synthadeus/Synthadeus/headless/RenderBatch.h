@@ -0,0 +1,96 @@
+////////////////////////////////////////////////////////////////////////////////
+//                                                                            //
+//   Render Batch                                                             //
+//   Everett Moser                                                            //
+//   10-18-26                                                                 //
+//                                                                            //
+//   Renders a manifest of patch, midi file and wave file jobs side by side   //
+//                                                                            //
+////////////////////////////////////////////////////////////////////////////////
+
+#pragma once
+
+#include "Error.h"
+#include "AudioDefines.h"
+#include "AudioPatch.h"
+#include "WaveWriter.h"
+
+#include <atomic>
+
+// a manifest has a job per line: <patch.syn> <song.mid> <out.wav> ('#' starts a comment)
+// each patch is loaded, calculated and snapshotted once up front, then every worker plays its snapshots with an engine of its own
+class RenderBatch
+{
+private:
+
+	// a line of the manifest, and how its render went
+	struct Job
+	{
+		const char* patchPath;
+		const char* midiPath;
+		const char* wavePath;
+		int patch;
+		bool succeeded;
+		double secondsRendered;
+		double secondsTaken;
+	};
+
+	// the jobs, in the order of the manifest
+	Job* jobs;
+	int numJobs;
+
+	// the manifest's text, which the jobs' paths point into
+	char* text;
+
+	// each distinct patch, loaded once and shared by every job playing it (NULL if it couldn't be loaded)
+	AudioPatch** patches;
+	int numPatches;
+
+	// the next job a worker takes on
+	std::atomic<int> nextJob;
+
+	// seconds rendered after each file, and threads helping each engine mix
+	float tail;
+	int voiceThreads;
+
+	// the samples every job writes, and their rate
+	WaveWriter::Format format;
+	bool dither;
+	int outputRate;
+
+	// a worker's thread, rendering jobs until there are none left
+	static void work(RenderBatch* myself);
+
+	// render a job with an engine of its own
+	void renderJob(Job& job);
+
+	// batches own their patches, so they are never copied
+	RenderBatch(const RenderBatch&);
+	RenderBatch& operator=(const RenderBatch&);
+
+public:
+
+	// an empty batch
+	RenderBatch();
+
+	// free the jobs and patches
+	~RenderBatch();
+
+	// read a manifest and load every patch it plays (false if the manifest can't be read)
+	bool load(const char* path);
+
+	// choose the format every job writes, and whether integer samples are dithered (before running)
+	inline void setFormat(WaveWriter::Format sampleFormat, bool dithered) { format = sampleFormat; dither = dithered; }
+
+	// choose the sample rate every job writes (before running)
+	inline void setOutputRate(int sampleRate) { outputRate = sampleRate; }
+
+	// render every job across a number of workers, reporting each and then the whole (false if any job failed)
+	bool run(int workers, float tailSeconds, int voiceThreadsPerJob);
+
+	// the number of jobs
+	inline int getNumJobs() { return numJobs; }
+
+	// whether any job writes a FLAC file (which only takes 16 or 24 bit samples)
+	bool hasFlacJobs();
+};
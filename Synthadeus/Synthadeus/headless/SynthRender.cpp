@@ -0,0 +1,440 @@
+////////////////////////////////////////////////////////////////////////////////
+//                                                                            //
+//   Synthadeus Offline Renderer                                              //
+//   Everett Moser                                                            //
+//   10-18-26                                                                 //
+//                                                                            //
+//   Renders a saved patch playing a midi file to a wave file, headless       //
+//                                                                            //
+////////////////////////////////////////////////////////////////////////////////
+
+#include "Error.h"
+#include "AudioDefines.h"
+#include "AudioPatch.h"
+#include "MidiFile.h"
+#include "OfflineRender.h"
+#include "RenderBatch.h"
+#include "WaveWriter.h"
+#include "FlacWriter.h"
+#include "StemWriter.h"
+#include "Resampler.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <math.h>
+#include <thread>
+#include <chrono>
+
+// seconds rendered after the last event, for whatever is still ringing
+#define RENDER_DEFAULT_TAIL 1.f
+
+// seconds of audio converted by each pass of the benchmark, and the passes timed
+#define BENCHMARK_SECONDS 10
+#define BENCHMARK_PASSES 5
+
+// seconds of audio written to each kind of file by the benchmark, and what they are called while it runs
+#define BENCHMARK_WRITE_SECONDS 60
+#define BENCHMARK_WAVE_PATH "synthrender_benchmark.wav"
+#define BENCHMARK_FLAC_PATH "synthrender_benchmark.flac"
+
+// the most nodes written as stems at once
+#define RENDER_MAX_STEMS 16
+
+// the formats by the names they are chosen with, in the order of WaveWriter::Format
+static const char* formatNames[] = { "16", "24", "32", "float" };
+
+// the conversions between common rates timed by the benchmark, from and to
+static const int benchmarkRates[][2] = { { 96000, 44100 }, { 96000, 48000 }, { 88200, 44100 }, { 48000, 44100 }, { 44100, 48000 } };
+
+static void printUsage()
+{
+	fprintf(stderr, "usage: synthrender <patch.syn> <song.mid> <out.wav|out.flac> [-tail seconds] [-threads voice threads] [-split threads]\n");
+	fprintf(stderr, "       synthrender -batch <manifest> [-jobs workers] [-tail seconds] [-threads voice threads]\n");
+	fprintf(stderr, "       (either takes [-format 16|24|32|float] [-dither] [-rate hz] as well)\n");
+	fprintf(stderr, "       synthrender -stems <patch.syn> <out.wav|out.flac> <node id> [node id ...] [-format 16|24|32|float] [-dither]\n");
+	fprintf(stderr, "       synthrender -benchmark\n");
+}
+
+// time converting to every format, to show it keeps well ahead of any render
+static int benchmarkConversion()
+{
+	// a loud sweep, clipping now and then, so every path of the conversion is taken
+	int count = BENCHMARK_SECONDS * AUDIO_SAMPLE_RATE * AUDIO_CHANNELS;
+	float* samples = new float[count];
+	unsigned char* converted = new unsigned char[count * 4];
+	for (int i = 0; i < count; i++)
+		samples[i] = 1.2f * sinf(0.0001f * (float)i * (float)(i % 4096));
+
+	// every format, plain and dithered (only integers below 32 bits are ever dithered)
+	printf("Converting %d s of audio %d times (%d samples a pass)\n", BENCHMARK_SECONDS, BENCHMARK_PASSES, count);
+	WaveWriter* writer = new WaveWriter();
+	for (int i = 0; i < WaveWriter::FORMATS; i++)
+	{
+		for (int dithered = 0; dithered < (i < WaveWriter::PCM32 ? 2 : 1); dithered++)
+		{
+			// the fastest pass, since anything slower was something else getting in the way
+			writer->setFormat((WaveWriter::Format)i, dithered != 0);
+			double fastest = 0.0;
+			for (int pass = 0; pass < BENCHMARK_PASSES; pass++)
+			{
+				std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+				writer->convert(samples, count, converted);
+				double elapsed = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+				if (pass == 0 || elapsed < fastest)
+					fastest = elapsed;
+			}
+			double rate = (fastest > 0.0 ? count / fastest : 0.0);
+			printf("  %-5s %-9s %8.1f M samples/s, %8.1f MB/s, %7.0fx real time\n", formatNames[i], (dithered ? "dithered" : ""),
+				rate / 1e6, rate * WaveWriter::bytesFor((WaveWriter::Format)i) / 1e6, rate / (AUDIO_SAMPLE_RATE * AUDIO_CHANNELS));
+		}
+	}
+	delete writer;
+	delete[] converted;
+	delete[] samples;
+	return 0;
+}
+
+// time resampling between common rates, to show a render at a high rate costs little more than rendering it
+static int benchmarkResampling()
+{
+	printf("Resampling %d s of stereo audio %d times\n", BENCHMARK_SECONDS, BENCHMARK_PASSES);
+	for (int i = 0; i < (int)(sizeof(benchmarkRates) / sizeof(benchmarkRates[0])); i++)
+	{
+		// a sweep at the rate converted from, fed a frame at a time as a render would
+		int inputRate = benchmarkRates[i][0];
+		int outputRate = benchmarkRates[i][1];
+		int frames = BENCHMARK_SECONDS * inputRate;
+		float* samples = new float[frames * AUDIO_CHANNELS];
+		for (int j = 0; j < frames * AUDIO_CHANNELS; j++)
+			samples[j] = 0.5f * sinf(0.0001f * (float)j * (float)(j % 4096));
+		Resampler* resampler = new Resampler();
+		if (!resampler->setRates(inputRate, outputRate, AUDIO_CHANNELS))
+		{
+			delete resampler;
+			delete[] samples;
+			return 1;
+		}
+		float* resampled = new float[resampler->getMaxOutput(AUDIO_FRAME_SIZE) * AUDIO_CHANNELS];
+
+		// the fastest pass, since anything slower was something else getting in the way
+		double fastest = 0.0;
+		for (int pass = 0; pass < BENCHMARK_PASSES; pass++)
+		{
+			resampler->setRates(inputRate, outputRate, AUDIO_CHANNELS);
+			std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+			for (int j = 0; j + AUDIO_FRAME_SIZE <= frames; j += AUDIO_FRAME_SIZE)
+				resampler->process(samples + j * AUDIO_CHANNELS, AUDIO_FRAME_SIZE, resampled);
+			double elapsed = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+			if (pass == 0 || elapsed < fastest)
+				fastest = elapsed;
+		}
+		printf("  %6d Hz to %6d Hz, %3d taps %7.0fx real time\n", inputRate, outputRate, resampler->getTaps(),
+			(fastest > 0.0 ? BENCHMARK_SECONDS / fastest : 0.0));
+		delete[] resampled;
+		delete resampler;
+		delete[] samples;
+	}
+	return 0;
+}
+
+// the size of a file on disk (0 if it isn't there)
+static long long fileSize(const char* path)
+{
+	FILE* f = fopen(path, "rb");
+	if (!f)
+		return 0;
+	fseek(f, 0, SEEK_END);
+	long long size = ftell(f);
+	fclose(f);
+	return size;
+}
+
+// time writing the same audio to a wave file and a FLAC file, to show what compressing costs and saves
+static int benchmarkWriting()
+{
+	// a minute of decaying notes, harmonics and all, something like a render (noise would not compress, silence would too well)
+	int frames = BENCHMARK_WRITE_SECONDS * AUDIO_SAMPLE_RATE;
+	float* samples = new float[(size_t)frames * AUDIO_CHANNELS];
+	for (int i = 0; i < frames; i++)
+	{
+		int note = i / (AUDIO_SAMPLE_RATE / 2);
+		float time = (float)(i % (AUDIO_SAMPLE_RATE / 2)) / AUDIO_SAMPLE_RATE;
+		float frequency = 110.f * powf(2.f, (float)((note * 5) % 24) / 12.f);
+		float value = 0.f;
+		for (int harmonic = 1; harmonic <= 6; harmonic++)
+			value += sinf(6.2831853f * frequency * harmonic * time) / harmonic;
+		value *= 0.3f * expf(-3.f * time);
+		samples[i * AUDIO_CHANNELS] = value;
+		samples[i * AUDIO_CHANNELS + 1] = 0.8f * value;
+	}
+
+	// the same frames through each, a frame at a time as a render would, counting the file being finished
+	printf("Writing %d s of 16 bit stereo to each kind of file\n", BENCHMARK_WRITE_SECONDS);
+	const char* paths[2] = { BENCHMARK_WAVE_PATH, BENCHMARK_FLAC_PATH };
+	long long sizes[2];
+	for (int i = 0; i < 2; i++)
+	{
+		AudioWriter* writer = (i == 0 ? (AudioWriter*)new WaveWriter() : (AudioWriter*)new FlacWriter());
+		std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+		bool written = writer->open(paths[i], AUDIO_CHANNELS, AudioWriter::PCM16, false);
+		for (int j = 0; written && j + AUDIO_FRAME_SIZE <= frames; j += AUDIO_FRAME_SIZE)
+			written = writer->write(samples + j * AUDIO_CHANNELS, AUDIO_FRAME_SIZE);
+		written = writer->close() && written;
+		double elapsed = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+		delete writer;
+		sizes[i] = fileSize(paths[i]);
+		remove(paths[i]);
+		if (!written)
+		{
+			fprintf(stderr, "Could not write %s\n", paths[i]);
+			delete[] samples;
+			return 1;
+		}
+		printf("  %-4s %8.1f MB %7.0fx real time, %5.1f%% of the wave file\n", (i == 0 ? "wav" : "flac"), sizes[i] / 1e6,
+			(elapsed > 0.0 ? BENCHMARK_WRITE_SECONDS / elapsed : 0.0), 100.0 * sizes[i] / sizes[0]);
+	}
+	delete[] samples;
+	return 0;
+}
+
+// FLAC only holds integers, and this encoder only 16 and 24 bit ones (false, saying so, for any other format)
+static bool checkFlacFormat(int format)
+{
+	if (format == WaveWriter::PCM16 || format == WaveWriter::PCM24)
+		return true;
+	fprintf(stderr, "FLAC files are written with 16 or 24 bit samples only.\n");
+	return false;
+}
+
+// render a manifest of jobs side by side
+static int renderBatch(const char* manifestPath, int workers, float tail, int threads, WaveWriter::Format format, bool dither, int rate)
+{
+	RenderBatch* batch = new RenderBatch();
+	batch->setFormat(format, dither);
+	batch->setOutputRate(rate);
+	bool succeeded = batch->load(manifestPath);
+
+	// a format the FLAC files can't take fails the batch once up front, rather than every FLAC job as it opens
+	if (succeeded && batch->hasFlacJobs())
+		succeeded = checkFlacFormat(format);
+	succeeded = succeeded && batch->run(workers, tail, threads);
+	delete batch;
+	return (succeeded ? 0 : 1);
+}
+
+// render a single patch playing a single file
+static int renderOne(const char* patchPath, const char* midiPath, const char* wavePath, float tail, int threads, int split,
+	WaveWriter::Format format, bool dither, int rate)
+{
+	// the graphs, calculated as they were saved
+	AudioPatch* patch = new AudioPatch();
+	if (!patch->load(patchPath) || patch->getNumParts() == 0)
+	{
+		fprintf(stderr, "Could not load a patch with any outputs from %s\n", patchPath);
+		delete patch;
+		return 1;
+	}
+
+	// the song
+	MidiFile* file = new MidiFile();
+	if (!file->load(midiPath))
+	{
+		fprintf(stderr, "Could not load %s\n", midiPath);
+		delete file;
+		delete patch;
+		return 1;
+	}
+
+	// a part per output, in the order of their channels (parts left out of the patch play silence)
+	AudioGraphSnapshot* graphs[AUDIO_PARTS];
+	int partCount = patch->getNumParts();
+	for (int i = 0; i < partCount; i++)
+		graphs[i] = patch->getSnapshot(i);
+
+	// render it (every engine, the chunked render's too, shares the patch's snapshots)
+	printf("Rendering %s with %s (%d parts, %d events)\n", midiPath, patchPath, partCount, file->getNumEvents());
+	OfflineRender* render = new OfflineRender(graphs, partCount, threads);
+	render->setFormat(format, dither);
+	render->setOutputRate(rate);
+	bool written = (split > 1 ? render->renderChunked(file, wavePath, tail, split) : render->render(file, wavePath, tail));
+	double seconds = render->getSecondsRendered();
+	double elapsed = render->getSecondsTaken();
+	double factor = render->getRealTimeFactor();
+	delete render;
+	delete patch;
+	if (!written)
+	{
+		fprintf(stderr, "Could not write %s\n", wavePath);
+		return 1;
+	}
+
+	// how much faster than real time it went
+	printf("Rendered %.2f s of audio in %.3f s (%.1fx real time)\n", seconds, elapsed, factor);
+	return 0;
+}
+
+// write the calculated buffers of nodes of a patch (ids count from 0 in the order they were declared), each to a file
+// of its own named after one path, all from the one evaluation of the graph loading the patch takes
+static int renderStems(const char* patchPath, const char* stemPath, int* ids, int count, WaveWriter::Format format, bool dither)
+{
+	// the graphs, calculated as they were saved
+	std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+	AudioPatch* patch = new AudioPatch();
+	if (!patch->load(patchPath))
+	{
+		fprintf(stderr, "Could not load a patch from %s\n", patchPath);
+		delete patch;
+		return 1;
+	}
+	double calculated = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+
+	// tap each node asked for
+	StemWriter* stems = new StemWriter();
+	for (int i = 0; i < count; i++)
+	{
+		AudioNode* node = patch->getNode(ids[i]);
+		if (!node)
+		{
+			fprintf(stderr, "%s has no node %d (it has %d)\n", patchPath, ids[i], patch->getNumNodes());
+			delete stems;
+			delete patch;
+			return 1;
+		}
+		if (!stems->addStem(node, ids[i], node->getClassName()))
+		{
+			fprintf(stderr, "Node %d of %s has no samples to write\n", ids[i], patchPath);
+			delete stems;
+			delete patch;
+			return 1;
+		}
+	}
+
+	// then stream them all out side by side
+	start = std::chrono::steady_clock::now();
+	bool written = stems->write(stemPath, format, dither);
+	double elapsed = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+	if (!written)
+	{
+		fprintf(stderr, "Could not write the stems of %s\n", stemPath);
+		delete stems;
+		delete patch;
+		return 1;
+	}
+	for (int i = 0; i < count; i++)
+		printf("  %s\n", stems->getPath(i));
+	printf("Calculated %d nodes in %.3f s, wrote %d stem%s of %.2f s in %.3f s\n", patch->getNumNodes(), calculated, count,
+		(count == 1 ? "" : "s"), (double)stems->getLength() / AUDIO_SAMPLE_RATE, elapsed);
+	delete stems;
+	delete patch;
+	return 0;
+}
+
+int main(int argc, char** argv)
+{
+	// nothing but the conversions
+	if (argc == 2 && strcmp(argv[1], "-benchmark") == 0)
+		return (benchmarkConversion() != 0 || benchmarkResampling() != 0 || benchmarkWriting() != 0 ? 1 : 0);
+
+	// the files (or the manifest, or the patch, the path and the nodes of the stems), then the options
+	bool batch = (argc >= 3 && strcmp(argv[1], "-batch") == 0);
+	bool stems = (argc >= 2 && strcmp(argv[1], "-stems") == 0);
+	int first = (batch ? 3 : 4);
+	int ids[RENDER_MAX_STEMS];
+	int numIds = 0;
+	while (stems && first < argc && argv[first][0] != '-' && numIds < RENDER_MAX_STEMS)
+		ids[numIds++] = atoi(argv[first++]);
+	if (argc < first || (stems && numIds == 0))
+	{
+		printUsage();
+		return 1;
+	}
+	float tail = RENDER_DEFAULT_TAIL;
+	int threads = AUDIO_VOICE_THREADS;
+	int workers = (int)std::thread::hardware_concurrency();
+	int split = 1;
+	int format = WaveWriter::PCM16;
+	bool dither = false;
+	int rate = AUDIO_SAMPLE_RATE;
+	for (int i = first; i < argc; i++)
+	{
+		if (strcmp(argv[i], "-tail") == 0 && i + 1 < argc)
+			tail = (float)atof(argv[++i]);
+		else if (strcmp(argv[i], "-threads") == 0 && i + 1 < argc)
+			threads = atoi(argv[++i]);
+		else if (batch && strcmp(argv[i], "-jobs") == 0 && i + 1 < argc)
+			workers = atoi(argv[++i]);
+		else if (!batch && !stems && strcmp(argv[i], "-split") == 0 && i + 1 < argc)
+			split = atoi(argv[++i]);
+		else if (strcmp(argv[i], "-format") == 0 && i + 1 < argc)
+		{
+			// the format going by that name (none, for a name we don't know)
+			format = -1;
+			for (int j = 0; j < WaveWriter::FORMATS; j++)
+			{
+				if (strcmp(argv[i + 1], formatNames[j]) == 0)
+					format = j;
+			}
+			i++;
+			if (format < 0)
+			{
+				printUsage();
+				return 1;
+			}
+		}
+		else if (strcmp(argv[i], "-dither") == 0)
+			dither = true;
+		else if (strcmp(argv[i], "-rate") == 0 && i + 1 < argc)
+			rate = atoi(argv[++i]);
+		else
+		{
+			printUsage();
+			return 1;
+		}
+	}
+	if (threads < 0 || threads > AudioEngine::MAX_VOICE_THREADS)
+	{
+		fprintf(stderr, "Between 0 and %d voice threads help each render.\n", AudioEngine::MAX_VOICE_THREADS);
+		return 1;
+	}
+
+	// a FLAC file has to take the format (a batch checks its jobs once it has read them)
+	if (!batch && FlacWriter::isFlacPath(argv[3]) && !checkFlacFormat(format))
+		return 1;
+
+	// stems are the buffers as they were calculated, at the rate they were calculated at
+	if (stems && rate != AUDIO_SAMPLE_RATE)
+	{
+		fprintf(stderr, "Stems are written at the %d Hz the graph is calculated at.\n", AUDIO_SAMPLE_RATE);
+		return 1;
+	}
+
+	// the rate rendered at has to convert to the one written
+	if (rate != AUDIO_SAMPLE_RATE)
+	{
+		Resampler* resampler = new Resampler();
+		bool convertible = resampler->setRates(AUDIO_SAMPLE_RATE, rate, AUDIO_CHANNELS);
+		delete resampler;
+		if (!convertible)
+		{
+			fprintf(stderr, "Can't resample the %d Hz rendered to %d Hz.\n", AUDIO_SAMPLE_RATE, rate);
+			return 1;
+		}
+	}
+
+	// every job, the stems, or just the one
+	if (stems)
+		return renderStems(argv[2], argv[3], ids, numIds, (WaveWriter::Format)format, dither);
+	if (batch)
+		return renderBatch(argv[2], workers, tail, threads, (WaveWriter::Format)format, dither, rate);
+	return renderOne(argv[1], argv[2], argv[3], tail, threads, split, (WaveWriter::Format)format, dither, rate);
+}
+
+// macro cleanup
+#undef RENDER_DEFAULT_TAIL
+#undef BENCHMARK_SECONDS
+#undef BENCHMARK_PASSES
+#undef BENCHMARK_WRITE_SECONDS
+#undef BENCHMARK_WAVE_PATH
+#undef BENCHMARK_FLAC_PATH
+#undef RENDER_MAX_STEMS
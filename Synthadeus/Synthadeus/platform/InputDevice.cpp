@@ -24,27 +24,97 @@ InputDevice::InputDevice()
 	vController.center.debounce();
 	vController.quit.debounce();
 	vController.waveExport.debounce();
+	vController.midiLearn.debounce();
+	vController.midiPlay.debounce();
+	vController.patchSave.debounce();
+	vController.stemTap.debounce();
+	vController.lookahead.debounce();
 
-	// initialize the piano critical section
-	InitializeCriticalSection(&vPiano.pianoCriticalSection);
+	// set up the piano of every channel
+	for (int c = 0; c < CHANNELS; c++)
+	{
+		// initialize the piano critical section
+		Piano* piano = getPiano(c);
+		InitializeCriticalSection(&piano->pianoCriticalSection);
 
-	// modifying the piano requires thread safety from midi thread
-	EnterCriticalSection(&vPiano.pianoCriticalSection);
+		// modifying the piano requires thread safety from midi thread
+		EnterCriticalSection(&piano->pianoCriticalSection);
+		resetPiano(piano);
+		publishKeys(piano);
+
+		// done with the piano for now
+		LeaveCriticalSection(&piano->pianoCriticalSection);
+	}
+}
 
+void InputDevice::resetPiano(Piano* piano)
+{
 	// no keys pressed
-	vPiano.numKeysPressed = 0;
+	piano->numKeysPressed = 0;
 	for (int i = 0; i < Piano::OCTAVES; i++)
 	{
 		for (int j = 0; j < Piano::KEYS; j++)
 		{
 			// debounce everything
-			vPiano.keys[i][j].debounce();
+			piano->keys[i][j].debounce();
+		}
+	}
+
+	// every key at full velocity
+	for (int i = 0; i < Piano::TOTAL_KEYS; i++)
+		piano->velocities[i] = 1.f;
+}
+
+void InputDevice::stackKeys(Piano* piano)
+{
+	// determine keypresses for the piano (makes DPS easier later) and keep track of the keystack
+	piano->numKeysPressed = 0;
+	for (int i = 0; i < Piano::OCTAVES; i++)
+	{
+		for (int j = 0; j < Piano::KEYS; j++)
+		{
+			if (piano->keys[i][j].check())
+				piano->keyStack[piano->numKeysPressed++] = MidiInterface::getKeyValue(i, j);
+		}
+	}
+}
+
+
+void InputDevice::updateVelocities(Piano* piano, MidiInterface* midi, int channel)
+{
+	// keys held over midi play at their velocity, the computer keyboard at full velocity
+	for (int i = 0; i < Piano::OCTAVES; i++)
+	{
+		for (int j = 0; j < Piano::KEYS; j++)
+		{
+			if (midi->check(channel, i, j))
+				piano->velocities[MidiInterface::getKeyValue(i, j)] = midi->getVelocity(channel, i, j) / 127.f;
+			else
+				piano->velocities[MidiInterface::getKeyValue(i, j)] = 1.f;
 		}
 	}
-	// done with the piano for now
-	LeaveCriticalSection(&vPiano.pianoCriticalSection);
 }
 
+void InputDevice::publishKeys(Piano* piano)
+{
+	// gather a bit for every key held, and the velocity it plays at
+	unsigned long long held[Piano::HELD_WORDS] = { 0 };
+	for (int i = 0; i < Piano::OCTAVES; i++)
+	{
+		for (int j = 0; j < Piano::KEYS; j++)
+		{
+			if (!piano->keys[i][j].check())
+				continue;
+			int key = MidiInterface::getKeyValue(i, j);
+			piano->heldVelocities[key].store(piano->velocities[key], std::memory_order_relaxed);
+			held[key / 64] |= 1ULL << (key % 64);
+		}
+	}
+
+	// then the keys themselves, which carry the velocities along to whoever reads them
+	for (int w = 0; w < Piano::HELD_WORDS; w++)
+		piano->heldKeys[w].store(held[w], std::memory_order_release);
+}
 
 void InputDevice::update(MidiInterface* midi)
 {
@@ -67,6 +137,21 @@ void InputDevice::update(MidiInterface* midi)
 	// waveExport is the F5 key
 	vController.waveExport.update((GetAsyncKeyState(VK_F5) ? true : false));
 
+	// midiLearn is the F6 key
+	vController.midiLearn.update((GetAsyncKeyState(VK_F6) ? true : false));
+
+	// midiPlay is the F7 key
+	vController.midiPlay.update((GetAsyncKeyState(VK_F7) ? true : false));
+
+	// patchSave is the F8 key
+	vController.patchSave.update((GetAsyncKeyState(VK_F8) ? true : false));
+
+	// stemTap is the F9 key
+	vController.stemTap.update((GetAsyncKeyState(VK_F9) ? true : false));
+
+	// lookahead is the F4 key
+	vController.lookahead.update((GetAsyncKeyState(VK_F4) ? true : false));
+
 	// idiot test
 	assert(midi != NULL);
 	EnterCriticalSection(&vPiano.pianoCriticalSection);
@@ -131,17 +216,29 @@ void InputDevice::update(MidiInterface* midi)
 		}
 	}
 
-	// determine keypresses for the piano (makes DPS easier later) and keep track of the keystack
-	vPiano.numKeysPressed = 0;
-	for (int i = 0; i < Piano::OCTAVES; i++)
+	// keep track of the keystack and how hard each key was hit
+	stackKeys(&vPiano);
+	updateVelocities(&vPiano, midi, 0);
+	publishKeys(&vPiano);
+	LeaveCriticalSection(&vPiano.pianoCriticalSection);
+
+	// the other channels are only played over midi
+	for (int c = 1; c < CHANNELS; c++)
 	{
-		for (int j = 0; j < Piano::KEYS; j++)
+		Piano* piano = getPiano(c);
+		EnterCriticalSection(&piano->pianoCriticalSection);
+		for (int i = 0; i < Piano::OCTAVES; i++)
 		{
-			if (vPiano.keys[i][j].check())
-				vPiano.keyStack[vPiano.numKeysPressed++] = MidiInterface::getKeyValue(i, j);
+			for (int j = 0; j < Piano::KEYS; j++)
+			{
+				piano->keys[i][j].update(midi->check(c, i, j));
+			}
 		}
+		stackKeys(piano);
+		updateVelocities(piano, midi, c);
+		publishKeys(piano);
+		LeaveCriticalSection(&piano->pianoCriticalSection);
 	}
-	LeaveCriticalSection(&vPiano.pianoCriticalSection);
 
 	// visual look at the virtual keyboard
 	if (vPiano.getNumKeysPressed() > 0)
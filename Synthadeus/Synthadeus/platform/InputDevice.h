@@ -15,6 +15,8 @@
 #include "Vector2D.h"
 #include "ButtonBase.h"
 
+#include <atomic>
+
 class MidiInterface;
 class InputDevice : public Object
 {
@@ -81,17 +83,41 @@ public:
 		// get a key that is currenly pressed
 		inline int getKey(int index) { assert(index >= 0 && index <= numKeysPressed); return keyStack[index]; }
 
+		// how hard a key was pressed (0 to 1, the computer keyboard always plays at full velocity)
+		inline float getVelocity(int key) { assert(key >= 0 && key < TOTAL_KEYS); return velocities[key]; }
+
 		// total number of keys on this magnificent keyboard
 		const static int TOTAL_KEYS = 12 * OCTAVES + KEYS;
 
+		// the keys held as last published, a bit per key in words of 64 (read by the audio callback without the lock)
+		const static int HELD_WORDS = (TOTAL_KEYS + 63) / 64;
+		inline unsigned long long getHeldKeys(int word) { assert(word >= 0 && word < HELD_WORDS); return heldKeys[word].load(std::memory_order_acquire); }
+
+		// the velocity a held key was published with (read after the held keys, without the lock)
+		inline float getHeldVelocity(int key) { assert(key >= 0 && key < TOTAL_KEYS); return heldVelocities[key].load(std::memory_order_relaxed); }
+
 	private:
 
 		// a stack of keys which are currently being pressed
 		int numKeysPressed;
 		int keyStack[TOTAL_KEYS];
+
+		// the velocity of every key
+		float velocities[TOTAL_KEYS];
+
+		// the keys and velocities published to the audio callback (velocities first, then the keys release them)
+		std::atomic<unsigned long long> heldKeys[HELD_WORDS];
+		std::atomic<float> heldVelocities[TOTAL_KEYS];
 		
 	} vPiano;
 
+	// a piano for every other midi channel (vPiano is the first, the only one the computer keyboard plays)
+	const static int CHANNELS = 16;
+	Piano vChannels[CHANNELS - 1];
+
+	// the piano played from a midi channel (0 to 15)
+	inline Piano* getPiano(int channel) { assert(channel >= 0 && channel < CHANNELS); return (channel == 0 ? &vPiano : &vChannels[channel - 1]); }
+
 
 	// keeps track of the non-piano keyboard commands
 	struct Controller
@@ -108,6 +134,21 @@ public:
 		// export key
 		ButtonBase waveExport;
 
+		// midi learn key
+		ButtonBase midiLearn;
+
+		// midi file key
+		ButtonBase midiPlay;
+
+		// patch save key
+		ButtonBase patchSave;
+
+		// stem tap key
+		ButtonBase stemTap;
+
+		// lookahead key
+		ButtonBase lookahead;
+
 	} vController;
 
 	// set up the initial device
@@ -115,5 +156,19 @@ public:
 
 	// update the device
 	void update(MidiInterface* midi);
+
+private:
+
+	// debounce every key of a piano (it must be locked)
+	void resetPiano(Piano* piano);
+
+	// rebuild a piano's stack of pressed keys from the keys themselves (it must be locked)
+	void stackKeys(Piano* piano);
+
+	// take the velocity of every key held on a midi channel, full velocity for the rest (it must be locked)
+	void updateVelocities(Piano* piano, MidiInterface* midi, int channel);
+
+	// publish the held keys and their velocities for the audio callback, which reads them without the lock (it must be locked)
+	void publishKeys(Piano* piano);
 };
 
@@ -0,0 +1,201 @@
+#include "MappedFile.h"
+
+#ifndef _WIN32
+#include <stdlib.h>
+#include <unistd.h>
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#endif
+
+MappedFile::MappedFile()
+	: memory(NULL), size(0), modified(0)
+{
+	// no file yet
+#ifdef _WIN32
+	file = NULL;
+	mapping = NULL;
+#else
+	file = -1;
+#endif
+}
+
+#ifdef _WIN32
+
+bool MappedFile::createTemporary(size_t bytes)
+{
+	// start from nothing
+	close();
+
+	// find a unique name in the temp directory
+	char directory[MAX_PATH];
+	char path[MAX_PATH];
+	if (!GetTempPathA(MAX_PATH, directory) || !GetTempFileNameA(directory, "syn", 0, path))
+		return false;
+
+	// the system deletes the file once it is closed, and is told it will be read sequentially
+	file = CreateFileA(path, GENERIC_READ | GENERIC_WRITE, 0, NULL, CREATE_ALWAYS,
+		FILE_ATTRIBUTE_TEMPORARY | FILE_FLAG_DELETE_ON_CLOSE | FILE_FLAG_SEQUENTIAL_SCAN, NULL);
+	if (file == INVALID_HANDLE_VALUE)
+	{
+		file = NULL;
+		return false;
+	}
+
+	// map the whole file (creating the mapping sizes the file)
+	mapping = CreateFileMappingA(file, NULL, PAGE_READWRITE, (DWORD)((unsigned long long)bytes >> 32), (DWORD)bytes, NULL);
+	if (mapping != NULL)
+		memory = MapViewOfFile(mapping, FILE_MAP_ALL_ACCESS, 0, 0, bytes);
+
+	// deliver errors
+	if (memory == NULL)
+	{
+		close();
+		return false;
+	}
+
+	// success
+	size = bytes;
+	return true;
+}
+
+bool MappedFile::openRead(const char* path)
+{
+	// start from nothing
+	close();
+
+	// open the file, letting others read it too
+	file = CreateFileA(path, GENERIC_READ, FILE_SHARE_READ, NULL, OPEN_EXISTING, FILE_ATTRIBUTE_NORMAL, NULL);
+	if (file == INVALID_HANDLE_VALUE)
+	{
+		file = NULL;
+		return false;
+	}
+
+	// map the whole file (an empty one can't be mapped)
+	LARGE_INTEGER bytes;
+	if (GetFileSizeEx(file, &bytes) && bytes.QuadPart > 0 && (unsigned long long)bytes.QuadPart <= (size_t)-1)
+	{
+		mapping = CreateFileMappingA(file, NULL, PAGE_READONLY, 0, 0, NULL);
+		if (mapping != NULL)
+			memory = MapViewOfFile(mapping, FILE_MAP_READ, 0, 0, 0);
+	}
+
+	// deliver errors
+	if (memory == NULL)
+	{
+		close();
+		return false;
+	}
+
+	// success
+	size = (size_t)bytes.QuadPart;
+	FILETIME written;
+	if (GetFileTime(file, NULL, NULL, &written))
+		modified = ((long long)written.dwHighDateTime << 32) | written.dwLowDateTime;
+	return true;
+}
+
+void MappedFile::close()
+{
+	// unmap, then close the mapping and the file (which deletes it if temporary)
+	if (memory) UnmapViewOfFile(memory);
+	if (mapping) CloseHandle(mapping);
+	if (file) CloseHandle(file);
+	memory = NULL;
+	mapping = NULL;
+	file = NULL;
+	size = 0;
+	modified = 0;
+}
+
+#else
+
+bool MappedFile::createTemporary(size_t bytes)
+{
+	// start from nothing
+	close();
+
+	// create a unique file in the temp directory
+	const char* directory = getenv("TMPDIR");
+	char path[1024];
+	snprintf(path, sizeof(path), "%s/synthadeus-XXXXXX", (directory ? directory : "/tmp"));
+	file = mkstemp(path);
+	if (file == -1)
+		return false;
+
+	// unlink it right away, so it disappears once closed
+	unlink(path);
+
+	// size and map the file
+	if (ftruncate(file, (off_t)bytes) == 0)
+	{
+		memory = mmap(NULL, bytes, PROT_READ | PROT_WRITE, MAP_SHARED, file, 0);
+		if (memory == MAP_FAILED)
+			memory = NULL;
+	}
+
+	// deliver errors
+	if (memory == NULL)
+	{
+		close();
+		return false;
+	}
+
+	// it is read front to back, so the kernel may read ahead and drop pages behind
+	madvise(memory, bytes, MADV_SEQUENTIAL);
+
+	// success
+	size = bytes;
+	return true;
+}
+
+bool MappedFile::openRead(const char* path)
+{
+	// start from nothing
+	close();
+
+	// open the file
+	file = open(path, O_RDONLY);
+	if (file == -1)
+		return false;
+
+	// map the whole file (an empty one can't be mapped)
+	struct stat status;
+	if (fstat(file, &status) == 0 && status.st_size > 0)
+	{
+		memory = mmap(NULL, (size_t)status.st_size, PROT_READ, MAP_SHARED, file, 0);
+		if (memory == MAP_FAILED)
+			memory = NULL;
+	}
+
+	// deliver errors
+	if (memory == NULL)
+	{
+		close();
+		return false;
+	}
+
+	// success
+	size = (size_t)status.st_size;
+	modified = (long long)status.st_mtime * 1000000000LL;
+#if defined(__APPLE__)
+	modified += status.st_mtimespec.tv_nsec;
+#elif defined(__linux__)
+	modified += status.st_mtim.tv_nsec;
+#endif
+	return true;
+}
+
+void MappedFile::close()
+{
+	// unmap and close the file (which deletes it if temporary)
+	if (memory) munmap(memory, size);
+	if (file != -1) ::close(file);
+	memory = NULL;
+	file = -1;
+	size = 0;
+	modified = 0;
+}
+
+#endif
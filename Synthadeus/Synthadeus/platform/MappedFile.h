@@ -0,0 +1,64 @@
+////////////////////////////////////////////////////////////////////////////////
+//                                                                            //
+//   Memory Mapped File                                                       //
+//   Everett Moser                                                            //
+//   10-18-26                                                                 //
+//                                                                            //
+//   Files mapped into memory, so the OS pages data to and from disk          //
+//                                                                            //
+////////////////////////////////////////////////////////////////////////////////
+
+#pragma once
+
+#include "Error.h"
+#include <stddef.h>
+
+class MappedFile
+{
+private:
+
+	// the mapped memory and its size
+	void* memory;
+	size_t size;
+
+	// when the file was last written, in the operating system's own units (0 for a temporary file)
+	long long modified;
+
+	// the operating system's handles for the file
+#ifdef _WIN32
+	HANDLE file;
+	HANDLE mapping;
+#else
+	int file;
+#endif
+
+	// mappings own their file, so they are never copied
+	MappedFile(const MappedFile&);
+	MappedFile& operator=(const MappedFile&);
+
+public:
+
+	// nothing mapped yet
+	MappedFile();
+
+	// unmap (deleting the file if it is temporary)
+	inline ~MappedFile() { close(); }
+
+	// create a temporary file of a given size, mapped for reading and writing front to back (deleted once closed)
+	bool createTemporary(size_t bytes);
+
+	// map an existing file for reading only (nothing is read until it is touched, then only the pages touched)
+	bool openRead(const char* path);
+
+	// unmap the memory and let go of the file
+	void close();
+
+	// the mapped memory (NULL when nothing is mapped)
+	inline void* getMemory() { return memory; }
+
+	// the size of the mapping
+	inline size_t getSize() { return size; }
+
+	// when the file mapped was last written (only ever compared with another time of the same file)
+	inline long long getModified() { return modified; }
+};
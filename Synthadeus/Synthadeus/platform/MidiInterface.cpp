@@ -4,6 +4,14 @@
 // flag masks to determine 
 #define MIDI_OFF_NOTE   0x80
 #define MIDI_ON_NOTE    0x90
+#define MIDI_CONTROL    0xB0
+
+// messages read from the stream each millisecond at most
+#define MIDI_READ_BATCH 64
+
+// the status byte holds the command in the high nibble and the channel in the low one
+#define MIDI_COMMAND(status) ((status) & 0xF0)
+#define MIDI_CHANNEL(status) ((status) & 0x0F)
 
 MidiInterface::MidiInterface()
 {
@@ -13,11 +21,26 @@ MidiInterface::MidiInterface()
 	msgFilter = 0;
 
 	// toggle all notes off
-	for (int i = 0; i < InputDevice::Piano::OCTAVES; i++)
+	for (int c = 0; c < InputDevice::CHANNELS; c++)
+	{
+		for (int i = 0; i < InputDevice::Piano::OCTAVES; i++)
+		{
+			for (int j = 0; j < InputDevice::Piano::KEYS; j++)
+			{
+				notes[c][i][j] = false;
+				velocities[c][i][j] = 127;
+			}
+		}
+	}
+
+	// no controllers mapped or moved yet
+	numControllerMappings = 0;
+	lastController.store(-1);
+	for (int c = 0; c < InputDevice::CHANNELS; c++)
 	{
-		for (int j = 0; j < InputDevice::Piano::KEYS; j++)
+		for (int i = 0; i < CONTROLLERS; i++)
 		{
-			notes[i][j] = false;
+			controllerMap[c][i].store(-1);
 		}
 	}
 }
@@ -105,16 +128,16 @@ void MidiInterface::ptMidiCallback(PtTimestamp timestamp, void* data)
 	// if not fully initialized, then nothing to do
 	if (!((MidiInterface*)data)->isInitialized()) return;
 
-	// create a new midi event
-	PmEvent event;
-	ZeroMemory(&event, sizeof(PmEvent));
+	// create new midi events
+	PmEvent events[MIDI_READ_BATCH];
+	ZeroMemory(events, sizeof(events));
 
 	// get the stream from the data
 	PmStream* midiInStream = (((MidiInterface*)data)->midiIn);
 
-	// read in 'count' messages
+	// read in 'count' messages (everything since the last millisecond, a sweeping controller sends plenty)
 	int count;
-	count = Pm_Read(midiInStream, &event, 1);
+	count = Pm_Read(midiInStream, events, MIDI_READ_BATCH);
 
 	// a negative count means there was an error
 	if (count < 0)
@@ -124,36 +147,95 @@ void MidiInterface::ptMidiCallback(PtTimestamp timestamp, void* data)
 		DebugPrintf("  [MIDI] ERROR: %s\n", Pm_GetErrorText(err));
 		assert(!"  [MIDI] An error has occurred. See the logs.");
 	}
-	else if (count > 0)
+
+	// handle the messages in the order they arrived
+	for (int i = 0; i < count; i++)
+		((MidiInterface*)data)->handleMessage(events[i].message);
+}
+
+void MidiInterface::handleMessage(PmMessage msg)
+{
+	// translate the message into a command, a channel, a note value and a velocity
+	int status = Pm_MessageStatus(msg), note = Pm_MessageData1(msg), velocity = Pm_MessageData2(msg);
+	int command = MIDI_COMMAND(status), channel = MIDI_CHANNEL(status);
+
+	// a key on the midi controller was pressed (a note on without velocity is how many controllers release keys)
+	if (command == MIDI_ON_NOTE && velocity > 0)
 	{
-		// get the message
-		PmMessage msg = event.message;
+		// toggle the key state boolean to true, remembering how hard it was hit
+		DebugPrintf("  [MIDI] toggle on %d (channel %d, velocity %d) \n", note, channel + 1, velocity);
+		velocities[channel][getOctaveValue(note)][getNoteValue(note)] = (unsigned char)velocity;
+		notes[channel][getOctaveValue(note)][getNoteValue(note)] = true;
+	}
 
-		// translate the message into a command and a note value
-		int command = Pm_MessageStatus(msg), note = Pm_MessageData1(msg);
+	//a key on the midi controller was released
+	else if (command == MIDI_OFF_NOTE || command == MIDI_ON_NOTE)
+	{
+		// toggle the key state boolean to false
+		DebugPrintf("  [MIDI] toggle off %d (channel %d) \n", note, channel + 1);
+		notes[channel][getOctaveValue(note)][getNoteValue(note)] = false;
+	}
 
-		// a key on the midi controller was pressed
-		if (command == MIDI_ON_NOTE)
-		{
-			// toggle the key state boolean to true
-			DebugPrintf("  [MIDI] toggle on %d \n", note);
-			((MidiInterface*)data)->notes[getOctaveValue(note)][getNoteValue(note)] = true;
-		}
+	// a knob or slider on the midi controller was moved
+	else if (command == MIDI_CONTROL)
+	{
+		// remember it for learning
+		int controller = note, value = velocity;
+		lastController.store(channel * CONTROLLERS + controller);
 
-		//a key on the midi controller was released
-		else if (command == MIDI_OFF_NOTE)
+		// move whatever it is mapped to (one lookup, no locks)
+		int mapping = controllerMap[channel][controller].load(std::memory_order_acquire);
+		if (mapping >= 0)
 		{
-			// toggle the key state boolean to false
-			DebugPrintf("  [MIDI] toggle off %d \n", note);
-			((MidiInterface*)data)->notes[getOctaveValue(note)][getNoteValue(note)] = false;
+			ControllerMapping& target = controllerMappings[mapping];
+			controllerChanges.push(target.part, target.parameter, target.minimum + (target.maximum - target.minimum) * value / 127.f);
 		}
 	}
 }
 
-bool MidiInterface::check(int octave, int note)
+bool MidiInterface::check(int channel, int octave, int note)
 {
 	// check the key state if it's a valid key
+	assert(channel >= 0 && channel < InputDevice::CHANNELS);
+	assert(note >= 0 && note <= InputDevice::Piano::KEYS);
+	assert(octave >= 0 && octave <= InputDevice::Piano::OCTAVES);
+	return notes[channel][octave][note];
+}
+
+unsigned char MidiInterface::getVelocity(int channel, int octave, int note)
+{
+	// check the key velocity if it's a valid key
+	assert(channel >= 0 && channel < InputDevice::CHANNELS);
 	assert(note >= 0 && note <= InputDevice::Piano::KEYS);
 	assert(octave >= 0 && octave <= InputDevice::Piano::OCTAVES);
-	return notes[octave][note];
+	return velocities[channel][octave][note];
+}
+
+bool MidiInterface::mapController(int channel, int controller, int part, int parameter, float minimum, float maximum)
+{
+	// idiot test
+	assert(channel >= 0 && channel < InputDevice::CHANNELS);
+	assert(controller >= 0 && controller < CONTROLLERS);
+	if (numControllerMappings == MAX_CONTROLLER_MAPPINGS)
+		return false;
+
+	// fill out the mapping before the midi thread can see it
+	ControllerMapping& mapping = controllerMappings[numControllerMappings];
+	mapping.part = part;
+	mapping.parameter = parameter;
+	mapping.minimum = minimum;
+	mapping.maximum = maximum;
+	controllerMap[channel][controller].store(numControllerMappings++, std::memory_order_release);
+
+	// success!
+	DebugPrintf("  [MIDI] Mapped controller %d (channel %d) to parameter %d of part %d\n", controller, channel + 1, parameter, part);
+	return true;
 }
+
+// macro cleanup
+#undef MIDI_OFF_NOTE
+#undef MIDI_ON_NOTE
+#undef MIDI_CONTROL
+#undef MIDI_READ_BATCH
+#undef MIDI_COMMAND
+#undef MIDI_CHANNEL
@@ -9,6 +9,7 @@
 ////////////////////////////////////////////////////////////////////////////////
 
 #include "InputDevice.h"
+#include "AudioParameterQueue.h"
 
 #include "PortMidi.h"
 #include "PortTime.h"
@@ -18,8 +19,15 @@
 
 #pragma once
 
+#include <atomic>
+
 class MidiInterface
 {
+public:
+
+	// controllers on each channel
+	const static int CONTROLLERS = 128;
+
 private:
 
 	// the status of whether or not we are fully initialized
@@ -31,8 +39,37 @@ private:
 	// default message filter should be 0
 	int msgFilter;
 
-	// current pressed status of the midi keys
-	bool notes[InputDevice::Piano::OCTAVES][InputDevice::Piano::KEYS];
+	// current pressed status of the midi keys on every channel
+	bool notes[InputDevice::CHANNELS][InputDevice::Piano::OCTAVES][InputDevice::Piano::KEYS];
+
+	// the velocity each key last went down with (1 to 127)
+	unsigned char velocities[InputDevice::CHANNELS][InputDevice::Piano::OCTAVES][InputDevice::Piano::KEYS];
+
+	// a controller moving a parameter of a part across a range
+	struct ControllerMapping
+	{
+		int part;
+		int parameter;
+		float minimum;
+		float maximum;
+	};
+
+	// learned mappings (never changed once the midi thread can see them, learning a controller again adds a new one)
+	const static int MAX_CONTROLLER_MAPPINGS = 256;
+	ControllerMapping controllerMappings[MAX_CONTROLLER_MAPPINGS];
+	int numControllerMappings;
+
+	// the mapping of every controller on every channel (-1 for none), looked up as each message arrives
+	std::atomic<int> controllerMap[InputDevice::CHANNELS][CONTROLLERS];
+
+	// the last controller moved (channel * CONTROLLERS + controller, -1 for none), for learning
+	std::atomic<int> lastController;
+
+	// mapped controller moves on their way to the audio thread (only the midi thread pushes)
+	AudioParameterQueue controllerChanges;
+
+	// act on a message from the controller (midi thread only)
+	void handleMessage(PmMessage msg);
 
 public:
 
@@ -51,8 +88,23 @@ public:
 	// callback function for when they keys are pressed
 	static void ptMidiCallback(PtTimestamp timestamp, void* data);
 
-	// returns the state of the current midi note
-	bool check(int octave, int note);
+	// returns the state of the current midi note on the first channel
+	inline bool check(int octave, int note) { return check(0, octave, note); };
+
+	// returns the state of the current midi note on a channel (0 to 15)
+	bool check(int channel, int octave, int note);
+
+	// the velocity a note on a channel last went down with (1 to 127)
+	unsigned char getVelocity(int channel, int octave, int note);
+
+	// map a controller on a channel to a parameter of a part, scaling its 0 to 127 across a range (UI thread only)
+	bool mapController(int channel, int controller, int part, int parameter, float minimum, float maximum);
+
+	// the last controller moved since asking before (channel * CONTROLLERS + controller, -1 for none)
+	inline int takeLastController() { return lastController.exchange(-1); };
+
+	// the mapped controller moves, for the audio thread to take in (see AudioPlayback::setControllerChanges)
+	inline AudioParameterQueue* getControllerChanges() { return &controllerChanges; };
 
 	// determine the C, CS, D, ..., A, AS, B value of a note
 	inline static int getNoteValue(int key) { return key % 12; };
@@ -0,0 +1,58 @@
+#include "ThreadPark.h"
+
+#if defined(__SSE2__) || defined(_M_X64) || defined(_M_IX86)
+#include <emmintrin.h>
+#define THREAD_PARK_PAUSE _mm_pause()
+#else
+#define THREAD_PARK_PAUSE
+#endif
+
+#ifdef _WIN32
+// WaitOnAddress lives here (Windows 8 and up)
+#pragma comment(lib, "Synchronization.lib")
+#else
+#include <unistd.h>
+#include <sys/syscall.h>
+#include <linux/futex.h>
+#endif
+
+// the OS waits on the counter's memory itself
+static_assert(sizeof(std::atomic<unsigned int>) == sizeof(unsigned int), "Error, the counter must be a plain word. ");
+
+void ThreadPark::relax()
+{
+	THREAD_PARK_PAUSE;
+}
+
+void ThreadPark::wait(std::atomic<unsigned int>& value, unsigned int expected, int spins)
+{
+	// spin first, the value usually changes soon
+	for (int i = 0; i < spins; i++)
+	{
+		if (value.load(std::memory_order_acquire) != expected)
+			return;
+		relax();
+	}
+
+	// then sleep on it (waking up spuriously now and then, hence the loop)
+	while (value.load(std::memory_order_acquire) == expected)
+	{
+#ifdef _WIN32
+		WaitOnAddress((volatile VOID*)&value, &expected, sizeof(expected), INFINITE);
+#else
+		syscall(SYS_futex, (unsigned int*)&value, FUTEX_WAIT_PRIVATE, expected, NULL, NULL, 0);
+#endif
+	}
+}
+
+void ThreadPark::wakeAll(std::atomic<unsigned int>& value)
+{
+#ifdef _WIN32
+	WakeByAddressAll((PVOID)&value);
+#else
+	syscall(SYS_futex, (unsigned int*)&value, FUTEX_WAKE_PRIVATE, 0x7FFFFFFF, NULL, NULL, 0);
+#endif
+}
+
+// macro cleanup
+#undef THREAD_PARK_PAUSE
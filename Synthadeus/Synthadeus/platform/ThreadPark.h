@@ -0,0 +1,28 @@
+////////////////////////////////////////////////////////////////////////////////
+//                                                                            //
+//   Thread Parking                                                           //
+//   Everett Moser                                                            //
+//   10-18-26                                                                 //
+//                                                                            //
+//   Spin then sleep on a value until another thread changes it (futexes)     //
+//                                                                            //
+////////////////////////////////////////////////////////////////////////////////
+
+#pragma once
+
+#include "Error.h"
+#include <atomic>
+
+// threads wait on an atomic counter without a mutex, the waker only bumps the counter and wakes them
+// waiting spins a while first, so a thread woken again within microseconds never has to enter the kernel
+namespace ThreadPark
+{
+	// let the other hyperthread have the core for a moment while spinning
+	void relax();
+
+	// spin a number of times, then sleep, until the value is no longer the one expected
+	void wait(std::atomic<unsigned int>& value, unsigned int expected, int spins);
+
+	// wake every thread sleeping on the value (after changing it)
+	void wakeAll(std::atomic<unsigned int>& value);
+}
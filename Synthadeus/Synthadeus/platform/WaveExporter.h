@@ -12,105 +12,88 @@
 
 #include "Error.h"
 #include "AudioDefines.h"
+#include "StemWriter.h"
 
 #include <Windows.h>
 #include <stdio.h>
 
-// little endian shifts
-#define SHIFT0(a) ((a) >> 24)
-#define SHIFT1(a) ((a) >> 16)
-#define SHIFT2(a) ((a) >> 8)
-#define SHIFT3(a) (a)
+#include <atomic>
+#include <thread>
 
-// wave exporting as per specification of a Microsoft Waveform File (.wav)
+// wave exporting as per specification of a Microsoft Waveform File (.wav), or compressed losslessly as a FLAC file (.flac),
+// streamed through a writer a block at a time, so exporting a buffer of any length takes the same memory
+// the export works from a snapshot of the output taken up front, on a thread of its own, so the graph can be edited
+// and played while it runs (the UI thread only polls its progress, and can cancel it)
+// instead of the output, any set of nodes tapped in the graph can be snapshotted from the same evaluation and
+// exported in one pass as stems, each to its own file named after the one chosen
 
 class WaveExporter
 {
 private:
-	// some useful masks to help load in some little endian numbers
-	const static unsigned int   MASK32_3 = 0x000000FF;
-	const static unsigned int   MASK32_2 = 0x0000FF00;
-	const static unsigned int   MASK32_1 = 0x00FF0000;
-	const static unsigned int   MASK32_0 = 0xFF000000;
-
-	// same masks but for shorts (2-byte) values
-	const static unsigned short MASK16_1 = 0x00FF;
-	const static unsigned short MASK16_0 = 0xFF00;
-
-	// size of the header
-	//   RIFF(4) + RIFF_SIZE(4) + WAVE(4) + FMT(4) + FMT_SIZE(4) + FMT_CODE(2) + CHANNELS(2)
-	// + RATE(4) + AVG(4) + ALIGN(2) + BITS(2) + DATA(4) + SIZE(4)
-	const static short waveSize = 44;
-
-	// info offsets [sizeof (Previous) + offet(previous)]
-	const static int RIFF_OFFSET		= 0;
-	const static int RIFF_SIZE_OFFSET	= 4 + RIFF_OFFSET;
-	const static int WAVE_TYPE_OFFSET	= 4 + RIFF_SIZE_OFFSET;
-	const static int FORMAT_OFFSET		= 4 + WAVE_TYPE_OFFSET;
-	const static int FORMAT_SIZE_OFFSET = 4 + FORMAT_OFFSET;
-	const static int FORMAT_CODE_OFFSET = 4 + FORMAT_SIZE_OFFSET;
-	const static int CHANNELS_OFFSET	= 2 + FORMAT_CODE_OFFSET;
-	const static int SAMPLE_RATE_OFFSET = 2 + CHANNELS_OFFSET;
-	const static int AVERAGE_BBP_OFFSET = 4 + SAMPLE_RATE_OFFSET;
-	const static int ALIGNMENT_OFFSET	= 4 + AVERAGE_BBP_OFFSET;
-	const static int BIT_DEPTH_OFFSET	= 2 + ALIGNMENT_OFFSET;
-	const static int WAVE_ID_OFFSET		= 2 + BIT_DEPTH_OFFSET;
-	const static int WAVE_SIZE_OFFSET	= 4 + WAVE_ID_OFFSET;
-	static_assert(WAVE_SIZE_OFFSET + 4 == waveSize, "Error, wave size incorrect. ");
-
-	// wav header information
-	const static char RIFF[4];
-	const static char WAVE[4];
-	const static char  FMT[4];
-
-	// hold the non-constant information
-	const static char DATA[4];
-	short fmtCode;
-	short channels;
-	int sampleRate;
-	int avgBps;
-	short align;
-	short bits;
-	char rawHeaderData[waveSize];
-
-	// sample conversion
-	bool prepared;
+	// the nodes as they were when the export was asked for, and the files they stream to
+	StemWriter stems;
+
+	// number of samples to export (of every node)
 	int nSamples;
-	void* rawAudioData;
 
-	// calculations
-	inline int calcByteTotal() { return sizeof(short) * channels * nSamples * 1000; }
-	inline int calcRiffSize() { return calcByteTotal() - 8 + waveSize; }
-	inline int calcAlign() { return (channels * bits) / 8; }
-	inline int calcAvgBps() { return sampleRate * align; }
+	// the file chosen (the one the stems are named after, when there are several), its format, and whether it is a FLAC file rather than a wave file
+	const static int MAX_PATH_LENGTH = 1024;
+	char path[MAX_PATH_LENGTH];
+	AudioWriter::Format format;
+	bool dither;
+	bool compressed;
+
+	// the thread writing the file, the samples it has written so far, and whether it is done
+	std::thread exportThread;
+	std::atomic<int> samplesExported;
+	std::atomic<bool> finished;
+
+	// set by the UI thread to stop the export early, which deletes the partial file
+	std::atomic<bool> cancelled;
 
-	// success flag
+	// success flag (only read once finished)
 	bool successful;
 
-	// audio channel pointers
-	float* channel1, *channel2;
+	// the export thread
+	static void exportFile(WaveExporter* myself);
+
+	// stream every sample of every node into the file chosen, or the files named after it (false if it failed or was cancelled)
+	bool writeWaveFile();
+
+	// exporters own their thread and snapshot, so they are never copied
+	WaveExporter(const WaveExporter&);
+	WaveExporter& operator=(const WaveExporter&);
 
 public:
 
-	// 2-channel export
-	WaveExporter(int numAudioSamples, float* audioSamplesL, float* audioSamplesR);
+	// export the calculated buffers of a number of nodes, an output or the stems tapped from one evaluation of the graph
+	// (copied right away, so the graph is free to change afterwards, ids are the ones a saved patch gives the nodes, -1 for none)
+	WaveExporter(AudioNode** nodes, int count = 1, const int* ids = NULL);
 
-	// 1-channel export
-	WaveExporter(int numAudioSamples, float* audioSamples);
+	// cancel the export if it is still running, and free the snapshot
+	~WaveExporter();
 
-	// whether the export was successful
-	inline bool wasSuccessful() { return successful; }
+	// save file dialog prompt, then start exporting in the background (false if the user didn't pick a file)
+	bool saveWaveFile();
 
-	// whether the export preparation was successful
-	inline bool isPrepared() { return prepared; }
+	// stop the export as soon as it can, deleting the partial file
+	inline void cancel() { cancelled.store(true); }
 
-	// prepare the wave header and wave data for export
-	void prepareExport();
+	// whether the export has stopped, one way or another
+	inline bool isFinished() { return finished.load(); }
 
-	// save file dialog prompt and export
-	void saveWaveFile();
+	// whether the export was cancelled
+	inline bool wasCancelled() { return cancelled.load(); }
 
-	// free the memory we used along the way
-	void unprepareExport();
-};
+	// whether the export finished writing the whole file (once finished)
+	inline bool wasSuccessful() { return finished.load() && successful; }
+
+	// how far along the export is, from 0 to 1
+	inline float getProgress() { return (nSamples > 0 ? (float)samplesExported.load() / nSamples : 1.f); }
 
+	// the file being exported to (the one the stems are named after, when there are several)
+	inline const char* getPath() { return path; }
+
+	// the number of nodes being exported, each to a file of its own (fewer than given if any had no samples)
+	inline int getNumStems() { return stems.getNumStems(); }
+};
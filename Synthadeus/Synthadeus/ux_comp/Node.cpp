@@ -23,6 +23,7 @@ Node::Node(Point nodeOrigin, Point nodeSize, unsigned int nodeFgColor, unsigned
 	relativeMouseX = 0.f;
 	relativeMouseY = 0.f;
 	removeable = isRemoveable;
+	tapped = false;
 }
 //sets the size a node 
 void Node::setSize(Point nodeOrigin, Point nodeSize)
@@ -106,6 +107,6 @@ void Node::update()
 //get render list for this certain node
 Renderable* Node::getRenderList()
 {
-	Renderable* rect = new RoundedRectangle(origin, size, fgColor, bgColor, 5.f, 5.f);
+	Renderable* rect = new RoundedRectangle(origin, size, (tapped ? COLOR_YELLOW : fgColor), bgColor, 5.f, 5.f);
 	return rect;
 }
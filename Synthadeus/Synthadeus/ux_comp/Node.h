@@ -36,6 +36,9 @@ private:
 	// if false, the node cannot be deleted by right clicking
 	bool removeable;
 
+	// tapped nodes are exported as stems (outlined in yellow)
+	bool tapped;
+
 public:
 
 	// run time type information
@@ -50,6 +53,12 @@ public:
 	// update the color scheme
 	void setColorScheme(unsigned int nodeFgColor, unsigned int nodeBgColor);
 
+	// tap the node for a stem export, or untap it
+	inline void toggleTapped() { tapped = !tapped; }
+
+	// whether the node is tapped for a stem export
+	inline bool isTapped() { return tapped; }
+
 	// handle the mouse events to allow for dragging
 	virtual void mouseEventHandler(Synthadeus* app, InputDevice::Mouse* vMouse);
 